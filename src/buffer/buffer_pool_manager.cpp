@@ -1,40 +1,137 @@
 #include "buffer/buffer_pool_manager.h"
+#include <algorithm>
 #include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <new>
 namespace cmudb
 {
 
 /*
  * BufferPoolManager Constructor
- * WARNING: Do Not Edit This Function
+ * The frames of up to max_pool_size pages are reserved as one arena (backed
+ * by huge pages if asked), split into shards of consecutive frames, each
+ * bound to a NUMA node if numa_local. Only pool_size frames are in use, the
+ * others are retired until Resize. Unless given, the number of shards
+ * follows the pool size.
  */
 BufferPoolManager::BufferPoolManager(size_t pool_size,
-                                     const std::string &db_file)
-    : pool_size_(pool_size), disk_manager_{db_file}
+                                     const std::string &db_file,
+                                     bool direct_io, size_t num_shards,
+                                     ReplacerType replacer_type,
+                                     size_t max_pool_size,
+                                     HugePages huge_pages, bool numa_local)
+    : BufferPoolManager(pool_size, std::vector<std::string>{db_file},
+                        direct_io, num_shards, replacer_type, max_pool_size,
+                        huge_pages, numa_local)
 {
-  // a consecutive memory space for buffer pool
-  pages_ = new Page[pool_size_];
-  page_table_ = new ExtendibleHash<page_id_t, Page *>(100);
-  replacer_ = new LRUReplacer<Page *>;
-  free_list_ = new std::list<Page *>;
+}
+
+BufferPoolManager::BufferPoolManager(size_t pool_size,
+                                     const std::vector<std::string> &db_files,
+                                     bool direct_io, size_t num_shards,
+                                     ReplacerType replacer_type,
+                                     size_t max_pool_size,
+                                     HugePages huge_pages, bool numa_local)
+    : pool_size_(pool_size),
+      max_pool_size_(std::max(pool_size, max_pool_size)),
+      huge_pages_(huge_pages), disk_manager_{db_files, direct_io},
+      num_shards_(num_shards)
+{
+  if (num_shards_ == 0)
+    num_shards_ = std::min<size_t>(BUFFER_POOL_SHARDS,
+                                   pool_size / MIN_SHARD_FRAMES);
+  num_shards_ = std::max<size_t>(1, std::min(num_shards_, pool_size));
 
-  // put all the pages into free list
-  for (size_t i = 0; i < pool_size_; ++i)
+  // a consecutive memory space for buffer pool, the frames beyond pool_size
+  // are not touched, so they take no memory until the pool grows
+  std::vector<size_t> shard_offsets;
+  frames_size_ = 0;
+  for (size_t i = 0; i < num_shards_; ++i)
   {
-    free_list_->push_back(&pages_[i]);
+    if (numa_local)
+      frames_size_ = (frames_size_ + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE *
+                     HUGE_PAGE_SIZE;
+    shard_offsets.push_back(frames_size_);
+    frames_size_ += ShardFrames(max_pool_size_, i) * PAGE_SIZE;
+  }
+  frames_ = MapFrames(frames_size_, huge_pages_);
+  // the page metadata is hopped through as randomly as the frames
+  HugePages metadata_pages = huge_pages_;
+  pages_ = reinterpret_cast<Page *>(
+      MapFrames(max_pool_size_ * sizeof(Page), metadata_pages));
+  for (size_t i = 0; i < max_pool_size_; ++i)
+    new (&pages_[i]) Page();
+  const std::vector<int> &numa_nodes = GetNumaNodes();
+  shards_ = new Shard[num_shards_];
+  // each shard gets a consecutive range of frames, sized for the largest pool
+  size_t first_frame = 0;
+  for (size_t i = 0; i < num_shards_; ++i)
+  {
+    Page *first_page = &pages_[first_frame];
+    size_t max_frames = ShardFrames(max_pool_size_, i);
+    size_t num_frames = ShardFrames(pool_size, i);
+    char *shard_frames = frames_ + shard_offsets[i];
+    for (size_t j = 0; j < max_frames; ++j)
+      first_page[j].data_ = shard_frames + j * PAGE_SIZE;
+    // before the frames are touched, so their pages land on the node
+    if (numa_local && numa_nodes.size() > 1)
+      BindToNumaNode(shard_frames, max_frames * PAGE_SIZE,
+                     numa_nodes[i % numa_nodes.size()]);
+
+    shards_[i].num_frames = num_frames;
+    shards_[i].max_frames = max_frames;
+    shards_[i].frames = first_page;
+    shards_[i].page_table = new PageTable(first_page, max_frames);
+    if (replacer_type == ReplacerType::CLOCK)
+      shards_[i].replacer = new ClockReplacer<Page *>(first_page, max_frames);
+    else if (replacer_type == ReplacerType::CLOCK_PRO)
+      shards_[i].replacer =
+          new ClockProReplacer<Page *>(first_page, max_frames);
+    else if (replacer_type == ReplacerType::TWO_QUEUE)
+      shards_[i].replacer =
+          new TwoQueueReplacer<Page *>(first_page, max_frames);
+    else
+      shards_[i].replacer = new LRUReplacer<Page *>;
+    // put the pages in use into free list, retire the others (the lowest
+    // frames come back first)
+    shards_[i].free_list = new std::list<Page *>;
+    for (size_t j = 0; j < num_frames; ++j)
+    {
+      first_page[j].ResetMemory();
+      shards_[i].free_list->push_back(&first_page[j]);
+    }
+    shards_[i].retired = new std::vector<Page *>;
+    for (size_t j = max_frames; j > num_frames; --j)
+      shards_[i].retired->push_back(&first_page[j - 1]);
+    first_frame += max_frames;
   }
 }
 
 /*
- * BufferPoolManager Deconstructor
- * WARNING: Do Not Edit This Function
+ * BufferPoolManager Destructor
+ * Stops the background writer and waits for prefetches in flight, then
+ * writes every page back before the arena is unmapped.
  */
 BufferPoolManager::~BufferPoolManager()
 {
+  StopBackgroundWriter();
+  // prefetches in flight read into the frames
+  disk_manager_.WaitForAsyncIO();
   FlushAllPages();
-  delete[] pages_;
-  delete page_table_;
-  delete replacer_;
-  delete free_list_;
+  for (size_t i = 0; i < max_pool_size_; ++i)
+    pages_[i].~Page();
+  UnmapFrames(reinterpret_cast<char *>(pages_), max_pool_size_ * sizeof(Page));
+  UnmapFrames(frames_, frames_size_);
+  for (size_t i = 0; i < num_shards_; ++i)
+  {
+    delete shards_[i].page_table;
+    delete shards_[i].replacer;
+    delete shards_[i].free_list;
+    delete shards_[i].retired;
+  }
+  delete[] shards_;
 }
 
 /**
@@ -46,107 +143,669 @@ BufferPoolManager::~BufferPoolManager()
  * 3. Delete the entry for the old page from the hash table and insert an entry
  * for the new page.
  * 4. Update page metadata, read page content from disk file and return page
- * pointer
+ * pointer (nullptr if the page fails its checksum)
+ * A hit takes no latch. Otherwise only the shard of page_id is latched, and
+ * not during the disk I/O. If the page is already being read, wait for that
+ * read instead of issuing another.
  */
-Page *BufferPoolManager::FetchPage(page_id_t page_id)
+Page *BufferPoolManager::FetchPage(page_id_t page_id,
+                                   BufferAccessStrategy *strategy)
 {
-  std::unique_lock<std::mutex> lock(latch_);
-
-  bool is_empty = false;
+  Shard &shard = GetShard(page_id);
   Page *tmp_page = nullptr;
-
-  if (page_table_->Find(page_id, tmp_page))
+  if (shard.page_table->Find(page_id, tmp_page) &&
+      TryPin(shard, tmp_page, page_id))
   {
-    replacer_->Erase(tmp_page);
-    tmp_page->pin_count_++;
+    tmp_page->num_hits_.fetch_add(1, std::memory_order_relaxed);
     return tmp_page;
   }
-  // find replacement entry
-  if (free_list_->size())
+
+  std::unique_lock<std::mutex> lock(shard.latch);
+  while (true)
   {
-    tmp_page = free_list_->back();
-    free_list_->pop_back();
-    is_empty = true;
+    tmp_page = FindPage(shard, lock, page_id);
+    if (tmp_page != nullptr)
+    {
+      // not exclusive: that only happens under the latch, or with
+      // io_pending_ set
+      tmp_page->pin_count_.fetch_add(1, std::memory_order_acquire);
+      tmp_page->num_hits_.fetch_add(1, std::memory_order_relaxed);
+      return tmp_page;
+    }
+    // find replacement entry
+    tmp_page = FindFrame(shard, lock, page_id, strategy);
+    if (tmp_page != nullptr)
+      break;
+    // the frames being prefetched are unpinned once read
+    if (shard.prefetches_in_flight == 0)
+      return nullptr;
+    shard.io_cv.wait(lock);
   }
-  else if (!(replacer_->Victim(tmp_page)))
+  shard.num_misses++;
+
+  lock.unlock();
+  bool read_ok = disk_manager_.ReadPage(page_id, tmp_page->GetData());
+  lock.lock();
+  tmp_page->io_pending_ = false;
+  shard.io_cv.notify_all();
+  if (!read_ok)
   {
+    // corrupted page, never hand it out
+    shard.page_table->Remove(page_id);
+    tmp_page->page_id_ = INVALID_PAGE_ID;
+    ReleaseFrame(tmp_page, 1);
+    shard.free_list->push_back(tmp_page);
     return nullptr;
   }
+  ReleaseFrame(tmp_page, 0);
+  return tmp_page;
+}
 
-  if (!is_empty)
+/*
+ * Look up a page without pinning or latching it, for an optimistic read. The
+ * version is read first: a claim of the frame that the checks below miss
+ * bumps it, and so fails the validation of the read.
+ */
+Page *BufferPoolManager::PeekPage(page_id_t page_id, uint32_t &version)
+{
+  Shard &shard = GetShard(page_id);
+  Page *tmp_page = nullptr;
+  if (!shard.page_table->Find(page_id, tmp_page) ||
+      !tmp_page->rwlatch_.ReadVersion(version))
+    return nullptr;
+  int pin_count = tmp_page->pin_count_.load(std::memory_order_acquire);
+  if ((pin_count & Page::PIN_EXCLUSIVE) != 0 ||
+      tmp_page->GetPageId() != page_id)
+    return nullptr;
+  return tmp_page;
+}
+
+/*
+ * Start reading a page into the buffer pool without waiting for it (read
+ * ahead), it is left unpinned once read. A FetchPage of the page meanwhile
+ * waits for this read. Nothing is done if the page is already in the pool,
+ * is not allocated, or every frame of its shard is pinned. At most a quarter
+ * of the frames of a shard are prefetched at a time, so that prefetches do
+ * not take every frame.
+ */
+void BufferPoolManager::PrefetchPage(page_id_t page_id,
+                                     BufferAccessStrategy *strategy)
+{
+  if (page_id == INVALID_PAGE_ID || !disk_manager_.IsPageAllocated(page_id))
+    return;
+  Shard &shard = GetShard(page_id);
+  std::unique_lock<std::mutex> lock(shard.latch);
+  Page *tmp_page = nullptr;
+  if (shard.page_table->Find(page_id, tmp_page) ||
+      shard.prefetches_in_flight >= std::max<size_t>(1, shard.num_frames / 4))
+    return;
+  tmp_page = FindFrame(shard, lock, page_id, strategy);
+  if (tmp_page == nullptr)
+    return;
+  shard.prefetches_in_flight++;
+  // the completion takes the latch
+  lock.unlock();
+  disk_manager_.ReadPageAsync(
+      page_id, tmp_page->GetData(),
+      [this, &shard, tmp_page, page_id](bool read_ok) {
+        std::lock_guard<std::mutex> lock(shard.latch);
+        tmp_page->io_pending_ = false;
+        shard.prefetches_in_flight--;
+        if (!read_ok)
+        {
+          shard.page_table->Remove(page_id);
+          tmp_page->page_id_ = INVALID_PAGE_ID;
+          ReleaseFrame(tmp_page, 1);
+          shard.free_list->push_back(tmp_page);
+        }
+        else
+        {
+          ReleaseFrame(tmp_page, 0);
+          Unpin(shard, tmp_page);
+        }
+        shard.io_cv.notify_all();
+      });
+}
+
+uint64_t BufferPoolManager::GetNumHits()
+{
+  // counted per frame, so readers of different pages share no counter
+  uint64_t num_hits = 0;
+  for (size_t i = 0; i < max_pool_size_; ++i)
+    num_hits += pages_[i].num_hits_.load(std::memory_order_relaxed);
+  return num_hits;
+}
+
+uint64_t BufferPoolManager::GetNumMisses()
+{
+  uint64_t num_misses = 0;
+  for (size_t i = 0; i < num_shards_; ++i)
   {
-    if (tmp_page->is_dirty_)
-      FlushPage(tmp_page->GetPageId());
-    page_table_->Remove(tmp_page->GetPageId());
+    std::lock_guard<std::mutex> lock(shards_[i].latch);
+    num_misses += shards_[i].num_misses;
   }
+  return num_misses;
+}
 
-  tmp_page->page_id_ = page_id;
-  tmp_page->pin_count_ = 1;
-  disk_manager_.ReadPage(tmp_page->GetPageId(), tmp_page->GetData());
-  page_table_->Insert(page_id, tmp_page);
+uint64_t BufferPoolManager::GetNumDirtyEvictions()
+{
+  uint64_t num_dirty_evictions = 0;
+  for (size_t i = 0; i < num_shards_; ++i)
+  {
+    std::lock_guard<std::mutex> lock(shards_[i].latch);
+    num_dirty_evictions += shards_[i].num_dirty_evictions;
+  }
+  return num_dirty_evictions;
+}
 
-  return tmp_page;
+/*
+ * Private helper to look up a page of a shard, caller must hold the shard
+ * latch: if the page is under I/O, wait until it is done and look again
+ * return nullptr if the page is not in the buffer pool
+ */
+Page *BufferPoolManager::FindPage(Shard &shard,
+                                  std::unique_lock<std::mutex> &lock,
+                                  page_id_t page_id)
+{
+  Page *tmp_page = nullptr;
+  while (shard.page_table->Find(page_id, tmp_page))
+  {
+    if (!tmp_page->io_pending_)
+      return tmp_page;
+    shard.io_cv.wait(lock);
+  }
+  return nullptr;
 }
 
 /*
- * Implementation of unpin page
- * if pin_count>0, decrement it and if it becomes zero, put it back to replacer
- * if pin_count<=0 before this call, return false.
- * is_dirty: set the dirty flag of this page
+ * Private helper to find the frame for a page coming into a shard, caller
+ * must hold the shard latch: from the free list first, otherwise the victim
+ * of the replacer, written back if dirty and removed from the page table
+ * The frame is returned pinned once, PIN_EXCLUSIVE, mapped to page_id and
+ * io_pending_; the caller clears both once its content is there. The latch
+ * is released while the victim is written back.
+ * Victims pinned by a latch free hit meanwhile, or no longer mapped (left in
+ * the replacer by an unpin racing with their reassignment), are skipped.
+ * With a strategy, the next frame of its ring for the shard is reused if
+ * possible, and the frame found takes that place in the ring.
+ * A victim still being written by the background writer is waited for, and
+ * having to write back a dirty victim wakes the background writer up.
+ * return nullptr if every frame of the shard is pinned
  */
-bool BufferPoolManager::UnpinPage(page_id_t page_id, bool is_dirty)
+Page *BufferPoolManager::FindFrame(Shard &shard,
+                                   std::unique_lock<std::mutex> &lock,
+                                   page_id_t page_id,
+                                   BufferAccessStrategy *strategy)
 {
-  std::lock_guard<std::mutex> lock(latch_);
   Page *tmp_page = nullptr;
-  if (page_table_->Find(page_id, tmp_page))
+  bool is_victim = false;
+  BufferAccessStrategy::Ring *ring =
+      strategy != nullptr ? &GetRing(strategy, page_id) : nullptr;
+  if (ring != nullptr && (tmp_page = TakeRingFrame(shard, *ring)) != nullptr)
+    is_victim = true;
+  else if (shard.free_list->size())
   {
-    if (tmp_page->pin_count_ > 0)
+    tmp_page = shard.free_list->back();
+    shard.free_list->pop_back();
+    // a lookup that read a stale page table entry may hold a pin briefly
+    while (!ClaimFrame(tmp_page, 1))
+      std::this_thread::yield();
+  }
+  else
+  {
+    do
     {
-      tmp_page->pin_count_--;
-      if (tmp_page->GetPinCount() == 0)
-      {
-        replacer_->Insert(tmp_page);
-      }
-      tmp_page->is_dirty_ |= is_dirty;
-      return true;
-    }
-    else
+      if (!shard.replacer->Victim(tmp_page))
+        return nullptr;
+    } while (!IsMapped(shard, tmp_page) || !ClaimFrame(tmp_page, 1));
+    is_victim = true;
+  }
+
+  // the frame is claimed, now make it wait for the read
+  tmp_page->io_pending_ = true;
+  shard.page_table->Insert(page_id, tmp_page);
+  if (is_victim)
+  {
+    while (tmp_page->writing_)
+      shard.io_cv.wait(lock);
+    if (tmp_page->is_dirty_)
     {
-      return false;
+      shard.num_dirty_evictions++;
+      bg_cv_.notify_one();
+      WriteBack(shard, lock, tmp_page);
     }
+    shard.page_table->Remove(tmp_page->GetPageId());
+  }
+  tmp_page->is_dirty_ = false;
+  tmp_page->page_id_ = page_id;
+  if (ring != nullptr)
+  {
+    ring->slots[ring->current].frame = tmp_page;
+    ring->slots[ring->current].page_id = page_id;
+  }
+  return tmp_page;
+}
+
+/*
+ * Private helper to get the ring of a strategy for the shard of page_id,
+ * the strategy's ring_size frames are shared among the shards on first use
+ */
+BufferAccessStrategy::Ring &
+BufferPoolManager::GetRing(BufferAccessStrategy *strategy, page_id_t page_id)
+{
+  if (strategy->rings_.size() != num_shards_)
+  {
+    size_t size = (strategy->ring_size_ + num_shards_ - 1) / num_shards_;
+    strategy->rings_.assign(num_shards_, BufferAccessStrategy::Ring(size));
   }
+  return strategy->rings_[static_cast<size_t>(page_id) % num_shards_];
+}
+
+/*
+ * Private helper to move a ring to its next slot and take the frame there
+ * out of the replacer, caller must hold the latch of the ring's shard
+ * return nullptr if the slot is empty, or its frame no longer holds the page
+ * loaded into it, or that page is pinned
+ * The frame returned is claimed like a victim of FindFrame.
+ */
+Page *BufferPoolManager::TakeRingFrame(Shard &shard,
+                                       BufferAccessStrategy::Ring &ring)
+{
+  ring.current = (ring.current + 1) % ring.slots.size();
+  BufferAccessStrategy::RingSlot &slot = ring.slots[ring.current];
+  if (slot.frame == nullptr || slot.frame->GetPageId() != slot.page_id)
+    return nullptr;
+  // a frame out of the replacer is pinned or under I/O, one in it may have
+  // been pinned since
+  if (!shard.replacer->Erase(slot.frame) || !ClaimFrame(slot.frame, 1))
+    return nullptr;
+  return slot.frame;
+}
+
+/*
+ * Private helper to pin a frame found in the page table without the shard
+ * latch, it must not be exclusive and still hold page_id once pinned
+ * return false (and drop the pin) otherwise
+ */
+bool BufferPoolManager::TryPin(Shard &shard, Page *page, page_id_t page_id)
+{
+  int pin_count = page->pin_count_.fetch_add(1, std::memory_order_acquire);
+  if ((pin_count & Page::PIN_EXCLUSIVE) == 0 && page->GetPageId() == page_id)
+    return true;
+  Unpin(shard, page);
   return false;
 }
 
+/*
+ * Private helper to drop a pin, the last one puts the frame back into the
+ * replacer (a frame still in it counts as referenced again). No latch is
+ * needed: a frame that is reassigned or freed meanwhile may end up in the
+ * replacer by mistake, FindFrame skips those.
+ */
+void BufferPoolManager::Unpin(Shard &shard, Page *page)
+{
+  if (page->pin_count_.fetch_sub(1, std::memory_order_release) == 1)
+    shard.replacer->Insert(page);
+}
+
+/*
+ * Private helper to tell whether a frame holds a page of the page table,
+ * caller must hold the shard latch
+ */
+bool BufferPoolManager::IsMapped(Shard &shard, Page *page)
+{
+  Page *tmp_page = nullptr;
+  return page->GetPageId() != INVALID_PAGE_ID &&
+         shard.page_table->Find(page->GetPageId(), tmp_page) &&
+         tmp_page == page;
+}
+
+/*
+ * Private helper to write a page back with the shard latch released, caller
+ * must hold the latch and make sure the frame cannot be reused meanwhile
+ * (pinned or io_pending_)
+ */
+void BufferPoolManager::WriteBack(Shard &shard,
+                                  std::unique_lock<std::mutex> &lock,
+                                  Page *page)
+{
+  page_id_t page_id = page->GetPageId();
+  page->is_dirty_ = false;
+  shard.writes_in_flight++;
+  lock.unlock();
+  disk_manager_.WritePage(page_id, page->GetData());
+  lock.lock();
+  shard.writes_in_flight--;
+  shard.io_cv.notify_all();
+}
+
+/*
+ * Implementation of unpin page
+ * if pin_count>0, decrement it and if it becomes zero, put it back to replacer
+ * if pin_count<=0 before this call, return false.
+ * is_dirty: set the dirty flag of this page
+ * No latch is taken, the caller's pin keeps the frame on its page.
+ */
+bool BufferPoolManager::UnpinPage(page_id_t page_id, bool is_dirty)
+{
+  Shard &shard = GetShard(page_id);
+  Page *tmp_page = nullptr;
+  if (!shard.page_table->Find(page_id, tmp_page) ||
+      tmp_page->GetPageId() != page_id || tmp_page->GetPinCount() <= 0)
+    return false;
+  // set before the pin is dropped, a write back starts after that
+  if (is_dirty)
+    tmp_page->is_dirty_.store(true, std::memory_order_relaxed);
+  Unpin(shard, tmp_page);
+  return true;
+}
+
 /*
  * Used to flush a particular page of the buffer pool to disk. Should call the
  * write_page method of the disk manager
  * if page is not found in page table, return false
  * NOTE: make sure page_id != INVALID_PAGE_ID
+ * The page may be pinned by others, it is copied under its read latch so the
+ * write gets one consistent image: the caller must not hold its write latch.
  */
 bool BufferPoolManager::FlushPage(page_id_t page_id)
 {
   if (page_id == INVALID_PAGE_ID)
     return false;
 
+  Shard &shard = GetShard(page_id);
+  std::unique_lock<std::mutex> lock(shard.latch);
   Page *tmp_page = nullptr;
-  if (page_table_->Find(page_id, tmp_page))
+  // an older copy of the page being written must not land after this write
+  while ((tmp_page = FindPage(shard, lock, page_id)) != nullptr &&
+         tmp_page->writing_)
+    shard.io_cv.wait(lock);
+  if (tmp_page == nullptr)
+    return false;
+
+  // pinned for the write, so it cannot be evicted while the latch is released,
+  // and writing_ so no newer copy is written meanwhile
+  tmp_page->pin_count_.fetch_add(1, std::memory_order_acquire);
+  tmp_page->writing_ = true;
+  shard.writes_in_flight++;
+  lock.unlock();
+  char *copy = AllocateAlignedPages(1);
+  tmp_page->RLatch();
+  tmp_page->is_dirty_ = false;
+  memcpy(copy, tmp_page->GetData(), PAGE_SIZE);
+  tmp_page->RUnlatch();
+  disk_manager_.WritePage(page_id, copy);
+  free(copy);
+  lock.lock();
+  tmp_page->writing_ = false;
+  shard.writes_in_flight--;
+  shard.io_cv.notify_all();
+  Unpin(shard, tmp_page);
+  return true;
+}
+
+/*
+ * Private helper to write the unpinned pages (only the dirty ones if asked),
+ * IO_QUEUE_DEPTH pages per asynchronous batch so they are in flight together
+ * instead of one page at a time. Each page is copied out by CopyForWrite, so
+ * a pin taken while it is written cannot change what is written. A shard is
+ * only latched while its pages are copied, once the writes issued before
+ * (e.g. by the background writer) are done.
+ */
+void BufferPoolManager::WriteBackPages(bool dirty_only)
+{
+  char *copies = AllocateAlignedPages(IO_QUEUE_DEPTH);
+  std::vector<PageWrite> batch;
+  std::vector<Page *> pages;
+  for (size_t i = 0; i < num_shards_; ++i)
   {
-    tmp_page->is_dirty_ = false;
-    disk_manager_.WritePage(tmp_page->GetPageId(), tmp_page->GetData());
-    return true;
+    Shard &shard = shards_[i];
+    size_t j = 0;
+    while (j < shard.max_frames)
+    {
+      {
+        // the batch holds no page of this shard here
+        std::unique_lock<std::mutex> lock(shard.latch);
+        shard.io_cv.wait(lock,
+                         [&shard] { return shard.writes_in_flight == 0; });
+        for (; j < shard.max_frames && pages.size() < IO_QUEUE_DEPTH; ++j)
+        {
+          Page *page = &shard.frames[j];
+          char *copy = copies + pages.size() * PAGE_SIZE;
+          // frames on the free list may still carry the id of a deleted page
+          if (IsMapped(shard, page) &&
+              CopyForWrite(shard, page, copy, dirty_only))
+          {
+            batch.push_back({page->GetPageId(), copy});
+            pages.push_back(page);
+          }
+        }
+      }
+      if (pages.size() == IO_QUEUE_DEPTH)
+      {
+        WriteCopies(batch, pages);
+        batch.clear();
+        pages.clear();
+      }
+    }
+  }
+  WriteCopies(batch, pages);
+  free(copies);
+}
+
+/*
+ * Private helper to copy a dirty page (any page unless dirty_only) out for
+ * the background writer, a checkpoint or a flush and mark it clean, caller
+ * must hold the shard latch. Only an
+ * unpinned page is taken, and kept PIN_EXCLUSIVE while it is copied (nobody
+ * is modifying it, and nobody can pin it to start to), so the copy is
+ * consistent without the page latch.
+ * The page is then writing_ and counted as a write in flight until
+ * WriteCopies is done with it.
+ * return false if the page is pinned, clean or already being written
+ */
+bool BufferPoolManager::CopyForWrite(Shard &shard, Page *page, char *copy,
+                                     bool dirty_only)
+{
+  if ((dirty_only && !page->is_dirty_) || page->writing_ ||
+      !ClaimFrame(page, 0))
+    return false;
+  memcpy(copy, page->GetData(), PAGE_SIZE);
+  page->is_dirty_ = false;
+  page->writing_ = true;
+  shard.writes_in_flight++;
+  ReleaseFrame(page, 0);
+  return true;
+}
+
+/*
+ * Private helper to write the page copies taken by CopyForWrite as one
+ * asynchronous batch and wait for it, no latch is held meanwhile
+ */
+void BufferPoolManager::WriteCopies(std::vector<PageWrite> &batch,
+                                    std::vector<Page *> &pages)
+{
+  if (batch.empty())
+    return;
+  std::promise<void> written;
+  std::future<void> written_future = written.get_future();
+  disk_manager_.WritePagesAsync(batch,
+                                [&written](bool) { written.set_value(); });
+  written_future.wait();
+
+  // frames being written are not reused, their page id is stable
+  for (Page *page : pages)
+  {
+    Shard &shard = GetShard(page->GetPageId());
+    std::lock_guard<std::mutex> lock(shard.latch);
+    page->writing_ = false;
+    shard.writes_in_flight--;
+    shard.io_cv.notify_all();
+  }
+}
+
+/*
+ * Private helper for the background writer: write the dirty pages among the
+ * next lookahead victims of each shard's replacer, so the coming misses find
+ * clean frames. A shard is latched only while its pages are copied out. The
+ * pages of all shards go in one batch, where the disk manager merges the
+ * adjacent ones (consecutive page ids are in different shards).
+ */
+void BufferPoolManager::CleanVictims(size_t lookahead)
+{
+  if (lookahead == 0)
+    return;
+  char *copies = AllocateAlignedPages(lookahead * num_shards_);
+  std::vector<PageWrite> batch;
+  std::vector<Page *> pages;
+  std::vector<Page *> victims;
+  for (size_t i = 0; i < num_shards_; ++i)
+  {
+    Shard &shard = shards_[i];
+    std::lock_guard<std::mutex> lock(shard.latch);
+    victims.clear();
+    shard.replacer->PeekVictims(victims, lookahead);
+    for (Page *page : victims)
+    {
+      char *copy = copies + pages.size() * PAGE_SIZE;
+      if (CopyForWrite(shard, page, copy))
+      {
+        batch.push_back({page->GetPageId(), copy});
+        pages.push_back(page);
+      }
+    }
+  }
+  WriteCopies(batch, pages);
+  free(copies);
+}
+
+/*
+ * Fuzzy checkpoint: the unpinned dirty pages found are written in page id
+ * order, IO_QUEUE_DEPTH pages per batch. Readers are not held up: a shard is
+ * latched only to list its dirty pages and to copy a page out, and a page
+ * that was pinned, evicted or written meanwhile is skipped. Pages dirtied
+ * after they were listed, and pinned pages, are left for the next
+ * checkpoint.
+ */
+void BufferPoolManager::Checkpoint()
+{
+  // dirty pages as of now, by page id
+  std::vector<std::pair<page_id_t, Page *>> dirty_pages;
+  for (size_t i = 0; i < num_shards_; ++i)
+  {
+    Shard &shard = shards_[i];
+    std::lock_guard<std::mutex> lock(shard.latch);
+    for (size_t j = 0; j < shard.max_frames; ++j)
+    {
+      Page *page = &shard.frames[j];
+      Page *tmp_page = nullptr;
+      // frames on the free list may still carry the id of a deleted page
+      if (page->is_dirty_ && page->GetPinCount() == 0 &&
+          page->GetPageId() != INVALID_PAGE_ID &&
+          shard.page_table->Find(page->GetPageId(), tmp_page) &&
+          tmp_page == page)
+        dirty_pages.emplace_back(page->GetPageId(), page);
+    }
+  }
+  std::sort(dirty_pages.begin(), dirty_pages.end());
+
+  char *copies = AllocateAlignedPages(IO_QUEUE_DEPTH);
+  for (size_t start = 0; start < dirty_pages.size(); start += IO_QUEUE_DEPTH)
+  {
+    size_t end = std::min(dirty_pages.size(), start + IO_QUEUE_DEPTH);
+    std::vector<PageWrite> batch;
+    std::vector<Page *> pages;
+    for (size_t i = start; i < end; ++i)
+    {
+      page_id_t page_id = dirty_pages[i].first;
+      Page *page = dirty_pages[i].second;
+      Shard &shard = GetShard(page_id);
+      std::lock_guard<std::mutex> lock(shard.latch);
+      Page *tmp_page = nullptr;
+      char *copy = copies + pages.size() * PAGE_SIZE;
+      if (shard.page_table->Find(page_id, tmp_page) && tmp_page == page &&
+          CopyForWrite(shard, page, copy))
+      {
+        batch.push_back({page_id, copy});
+        pages.push_back(page);
+      }
+    }
+    WriteCopies(batch, pages);
+  }
+  free(copies);
+  disk_manager_.Sync();
+}
+
+void BufferPoolManager::StartBackgroundWriter(
+    std::chrono::milliseconds interval, size_t lookahead,
+    std::chrono::milliseconds checkpoint_interval)
+{
+  if (bg_writer_.joinable())
+    return;
+  bg_interval_ = interval;
+  bg_lookahead_ = lookahead;
+  checkpoint_interval_ = checkpoint_interval;
+  bg_shutdown_ = false;
+  bg_writer_ = std::thread(&BufferPoolManager::BackgroundWriterLoop, this);
+}
+
+void BufferPoolManager::StopBackgroundWriter()
+{
+  {
+    std::lock_guard<std::mutex> lock(bg_latch_);
+    bg_shutdown_ = true;
+  }
+  bg_cv_.notify_all();
+  if (bg_writer_.joinable())
+    bg_writer_.join();
+}
+
+/*
+ * Background writer thread: clean the next victims every bg_interval_, or
+ * sooner when a miss had to write back a dirty victim, and take a checkpoint
+ * every checkpoint_interval_
+ */
+void BufferPoolManager::BackgroundWriterLoop()
+{
+  auto last_checkpoint = std::chrono::steady_clock::now();
+  std::unique_lock<std::mutex> lock(bg_latch_);
+  while (!bg_shutdown_)
+  {
+    bg_cv_.wait_for(lock, bg_interval_);
+    if (bg_shutdown_)
+      break;
+    lock.unlock();
+    CleanVictims(bg_lookahead_);
+    auto now = std::chrono::steady_clock::now();
+    if (checkpoint_interval_.count() > 0 &&
+        now - last_checkpoint >= checkpoint_interval_)
+    {
+      Checkpoint();
+      last_checkpoint = now;
+    }
+    lock.lock();
   }
-  return false;
 }
 
 /*
  * Used to flush all dirty pages in the buffer pool manager
+ * The writes are issued in asynchronous batches.
+ */
+void BufferPoolManager::FlushAllPages() { WriteBackPages(false); }
+
+/*
+ * Commit point of a transaction: unless the durability level of the disk
+ * manager is NONE, write the dirty pages in batches and wait until they are
+ * on stable storage. The fdatasync is shared with concurrent committers, so
+ * the cost of a commit does not grow with the number of pages it wrote.
+ * Pinned pages are still being modified and are left for a later commit.
  */
-void BufferPoolManager::FlushAllPages()
+void BufferPoolManager::SyncDirtyPages()
 {
-  for (size_t i = 0; i < pool_size_; ++i)
-    if (pages_[i].pin_count_ == 0)
-      FlushPage(pages_[i].GetPageId());
+  if (disk_manager_.GetDurability() == DurabilityLevel::NONE)
+    return;
+  WriteBackPages(true);
+  disk_manager_.Sync();
 }
 
 /**
@@ -160,22 +819,111 @@ void BufferPoolManager::FlushAllPages()
  */
 bool BufferPoolManager::DeletePage(page_id_t page_id)
 {
-  std::lock_guard<std::mutex> lock(latch_);
+  Shard &shard = GetShard(page_id);
+  std::unique_lock<std::mutex> lock(shard.latch);
 
   Page *tmp_page = nullptr;
-  if (page_table_->Find(page_id, tmp_page))
+  // the page id may be allocated again, its old copy must be written first
+  while ((tmp_page = FindPage(shard, lock, page_id)) != nullptr &&
+         tmp_page->writing_)
+    shard.io_cv.wait(lock);
+  if (tmp_page != nullptr)
   {
-    if (tmp_page->GetPinCount())
+    if (!ClaimFrame(tmp_page, 0))
       return false;
 
-    page_table_->Remove(page_id);
-    replacer_->Erase(tmp_page);
-    free_list_->push_back(tmp_page);
+    shard.page_table->Remove(page_id);
+    shard.replacer->Erase(tmp_page);
+    tmp_page->page_id_ = INVALID_PAGE_ID;
+    tmp_page->is_dirty_ = false;
+    ReleaseFrame(tmp_page, 0);
+    shard.free_list->push_back(tmp_page);
   }
   disk_manager_.DeallocatePage(page_id);
   return true;
 }
 
+/*
+ * Grow or shrink the pool to pool_size frames, spread over the shards as at
+ * construction. One shard is latched at a time. Growing puts retired frames
+ * back on the free lists; shrinking retires free frames, then evicts
+ * victims of the replacer as a miss would. A shard whose remaining frames
+ * are all pinned stays larger than asked, the pool size then reports how far
+ * it went.
+ */
+bool BufferPoolManager::Resize(size_t pool_size)
+{
+  if (pool_size < num_shards_ || pool_size > max_pool_size_)
+    return false;
+  std::lock_guard<std::mutex> resize_lock(resize_latch_);
+  bool resized = true;
+  size_t new_pool_size = 0;
+  for (size_t i = 0; i < num_shards_; ++i)
+  {
+    Shard &shard = shards_[i];
+    size_t num_frames = ShardFrames(pool_size, i);
+    std::unique_lock<std::mutex> lock(shard.latch);
+    while (shard.num_frames < num_frames)
+    {
+      shard.free_list->push_back(shard.retired->back());
+      shard.retired->pop_back();
+      shard.num_frames++;
+    }
+    while (shard.num_frames > num_frames && RetireFrame(shard, lock))
+      ;
+    resized = resized && shard.num_frames == num_frames;
+    new_pool_size += shard.num_frames;
+  }
+  pool_size_ = new_pool_size;
+  return resized;
+}
+
+/*
+ * Private helper to take a frame out of a shard for Resize, caller must hold
+ * the shard latch: a free frame, otherwise a victim of the replacer, written
+ * back if dirty (with the latch released) and removed from the page table.
+ * The memory of the frame is given back to the system.
+ * return false if every frame of the shard is pinned
+ */
+bool BufferPoolManager::RetireFrame(Shard &shard,
+                                    std::unique_lock<std::mutex> &lock)
+{
+  Page *tmp_page = nullptr;
+  if (shard.free_list->size())
+  {
+    tmp_page = shard.free_list->back();
+    shard.free_list->pop_back();
+    while (!ClaimFrame(tmp_page, 1))
+      std::this_thread::yield();
+  }
+  else
+  {
+    do
+    {
+      if (!shard.replacer->Victim(tmp_page))
+        return false;
+    } while (!IsMapped(shard, tmp_page) || !ClaimFrame(tmp_page, 1));
+    // fetches of the page wait until it is gone, then read it again
+    tmp_page->io_pending_ = true;
+    while (tmp_page->writing_)
+      shard.io_cv.wait(lock);
+    if (tmp_page->is_dirty_)
+      WriteBack(shard, lock, tmp_page);
+    shard.page_table->Remove(tmp_page->GetPageId());
+    tmp_page->io_pending_ = false;
+    shard.io_cv.notify_all();
+  }
+  // an unpin racing with a reassignment may have left it in the replacer
+  shard.replacer->Erase(tmp_page);
+  tmp_page->is_dirty_ = false;
+  tmp_page->page_id_ = INVALID_PAGE_ID;
+  DiscardFrames(tmp_page->GetData(), PAGE_SIZE, huge_pages_);
+  shard.retired->push_back(tmp_page);
+  shard.num_frames--;
+  ReleaseFrame(tmp_page, 1);
+  return true;
+}
+
 /**
  * User should call this method if needs to create a new page. This routine
  * will call disk manager to allocate a page.
@@ -184,38 +932,51 @@ bool BufferPoolManager::DeletePage(page_id_t page_id)
  * new page's metadata, zero out memory and add corresponding entry into page
  * table.
  * return nullptr is all the pages in pool are pinned
+ * hint: a related page, the new page is allocated close to it on disk
+ * The page id decides the shard, so it is allocated first. If that shard has
+ * no frame left the next page id is tried until every shard has been tried
+ * (ids in use are skipped, so give up after 2 * num_shards_ ids), the ids
+ * passed over are given back at the end.
  */
-Page *BufferPoolManager::NewPage(page_id_t &page_id)
+Page *BufferPoolManager::NewPage(page_id_t &page_id, page_id_t hint,
+                                 BufferAccessStrategy *strategy)
 {
-  std::lock_guard<std::mutex> lock(latch_);
-
-  bool is_empty = false;
+  std::vector<page_id_t> passed_over;
+  std::vector<bool> tried(num_shards_, false);
+  size_t num_tried = 0;
   Page *tmp_page = nullptr;
-  // find a free entry in free_list
-  if (free_list_->size())
+  while (tmp_page == nullptr && num_tried < num_shards_ &&
+         passed_over.size() < 2 * num_shards_)
   {
-    is_empty = true;
-    tmp_page = free_list_->back();
-    free_list_->pop_back();
-  }
-  else if (!(replacer_->Victim(tmp_page)))
-  {
-    return nullptr;
-  }
+    page_id_t new_page_id = disk_manager_.AllocatePage(hint);
+    if (!tried[new_page_id % num_shards_])
+    {
+      tried[new_page_id % num_shards_] = true;
+      ++num_tried;
+    }
+    Shard &shard = GetShard(new_page_id);
+    std::unique_lock<std::mutex> lock(shard.latch);
+    tmp_page = FindFrame(shard, lock, new_page_id, strategy);
+    // the frames being prefetched are unpinned once read
+    while (tmp_page == nullptr && shard.prefetches_in_flight > 0)
+    {
+      shard.io_cv.wait(lock);
+      tmp_page = FindFrame(shard, lock, new_page_id, strategy);
+    }
+    if (tmp_page == nullptr)
+    {
+      passed_over.push_back(new_page_id);
+      continue;
+    }
 
-  if (!is_empty)
-  {
-    if (tmp_page->is_dirty_)
-      FlushPage(tmp_page->GetPageId());
-    page_table_->Remove(tmp_page->GetPageId());
+    page_id = new_page_id;
+    tmp_page->ResetMemory();
+    tmp_page->io_pending_ = false;
+    ReleaseFrame(tmp_page, 0);
+    shard.io_cv.notify_all();
   }
-
-  page_id = disk_manager_.AllocatePage();
-  tmp_page->ResetMemory();
-  tmp_page->page_id_ = page_id;
-  tmp_page->pin_count_ = 1;
-
-  page_table_->Insert(page_id, tmp_page);
+  for (auto passed_over_id : passed_over)
+    disk_manager_.DeallocatePage(passed_over_id);
   return tmp_page;
 }
 
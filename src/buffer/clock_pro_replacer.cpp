@@ -0,0 +1,218 @@
+/**
+ * CLOCK-Pro implementation over a fixed range of frames
+ */
+#include <algorithm>
+#include <cassert>
+
+#include "buffer/clock_pro_replacer.h"
+#include "page/page.h"
+
+namespace cmudb
+{
+
+template <typename T>
+ClockProReplacer<T>::ClockProReplacer(T base, size_t num_frames)
+    : base_(base), num_frames_(num_frames), hand_(0), size_(0),
+      hot_count_(0), cold_target_(std::max<size_t>(1, num_frames / 2)),
+      non_resident_size_(2 * num_frames)
+{
+  frames_ = new FrameState[num_frames_];
+  non_resident_ = new page_id_t[non_resident_size_];
+  for (size_t i = 0; i < non_resident_size_; ++i)
+    non_resident_[i] = INVALID_PAGE_ID;
+}
+
+template <typename T>
+ClockProReplacer<T>::~ClockProReplacer()
+{
+  delete[] frames_;
+  delete[] non_resident_;
+}
+
+/*
+ * Insert value into the clock: a page new to its frame starts cold in its
+ * test period (hot if it was remembered as non-resident), a page already
+ * known gets its reference bit set
+ */
+template <typename T>
+void ClockProReplacer<T>::Insert(const T &value)
+{
+  std::lock_guard<std::mutex> lock(latch_);
+  size_t index = FrameIndex(value);
+  assert(index < num_frames_);
+  FrameState &frame = frames_[index];
+  page_id_t key = ReplacerKey(value);
+
+  if (frame.present && frame.hot)
+    hot_count_--;
+  if (frame.key != key)
+  {
+    frame.key = key;
+    frame.referenced = false;
+    frame.hot = TakeNonResident(key);
+    frame.in_test = !frame.hot;
+  }
+  else
+  {
+    frame.referenced = true;
+  }
+  if (!frame.present)
+    size_++;
+  frame.present = true;
+  if (frame.hot)
+    hot_count_++;
+}
+
+/*
+ * Sweep the hand until a cold page without reference bit is found. On the
+ * way, a referenced cold page turns hot if in its test period and starts one
+ * otherwise, and hot pages lose their reference bit or, beyond the hot
+ * target, are demoted. Return false if the clock is empty.
+ */
+template <typename T>
+bool ClockProReplacer<T>::Victim(T &value)
+{
+  std::lock_guard<std::mutex> lock(latch_);
+  if (size_ == 0)
+    return false;
+
+  size_t hot_target = size_ > cold_target_ ? size_ - cold_target_ : 0;
+  // after three rounds every page has been demoted or lost its bit, only a
+  // guard against cycling
+  for (size_t steps = 0;; ++steps)
+  {
+    size_t index = hand_;
+    hand_ = (hand_ + 1) % num_frames_;
+    FrameState &frame = frames_[index];
+    if (!frame.present)
+      continue;
+
+    bool force = steps >= 3 * num_frames_;
+    if (!force && frame.referenced)
+    {
+      frame.referenced = false;
+      if (!frame.hot && frame.in_test)
+      {
+        frame.hot = true;
+        hot_count_++;
+      }
+      frame.in_test = !frame.hot;
+      continue;
+    }
+    if (!force && frame.hot)
+    {
+      if (hot_count_ > hot_target)
+      {
+        frame.hot = false;
+        hot_count_--;
+      }
+      continue;
+    }
+
+    if (frame.hot)
+      hot_count_--;
+    else if (frame.in_test)
+      AddNonResident(frame.key);
+    frame.present = false;
+    frame.hot = false;
+    frame.key = INVALID_PAGE_ID;
+    size_--;
+    value = base_ + index;
+    return true;
+  }
+}
+
+/*
+ * Remove value from the clock (it is pinned), it keeps its state until it
+ * is inserted again. If removal is successful, return true, otherwise
+ * return false
+ */
+template <typename T>
+bool ClockProReplacer<T>::Erase(const T &value)
+{
+  std::lock_guard<std::mutex> lock(latch_);
+  size_t index = FrameIndex(value);
+  assert(index < num_frames_);
+  FrameState &frame = frames_[index];
+  if (!frame.present)
+    return false;
+  frame.present = false;
+  if (frame.hot)
+    hot_count_--;
+  size_--;
+  return true;
+}
+
+template <typename T>
+size_t ClockProReplacer<T>::Size()
+{
+  std::lock_guard<std::mutex> lock(latch_);
+  return size_;
+}
+
+/*
+ * Append up to count values in the order of the hand: the cold pages without
+ * reference bit, then the other cold pages, then the hot ones (which would
+ * have to be demoted first)
+ */
+template <typename T>
+void ClockProReplacer<T>::PeekVictims(std::vector<T> &values, size_t count)
+{
+  std::lock_guard<std::mutex> lock(latch_);
+  for (int round = 0; round < 3; ++round)
+  {
+    for (size_t i = 0; i < num_frames_ && count > 0; ++i)
+    {
+      size_t index = (hand_ + i) % num_frames_;
+      const FrameState &frame = frames_[index];
+      if (!frame.present)
+        continue;
+      if ((round == 0 && !frame.hot && !frame.referenced) ||
+          (round == 1 && !frame.hot && frame.referenced) ||
+          (round == 2 && frame.hot))
+      {
+        values.push_back(base_ + index);
+        count--;
+      }
+    }
+  }
+}
+
+/*
+ * Private helper: if key is a remembered non-resident page, forget it and
+ * grow the cold target (the cold pages were too few to keep it), return
+ * whether it was found
+ */
+template <typename T>
+bool ClockProReplacer<T>::TakeNonResident(page_id_t key)
+{
+  page_id_t &slot = non_resident_[static_cast<size_t>(key) % non_resident_size_];
+  if (key == INVALID_PAGE_ID || slot != key)
+    return false;
+  slot = INVALID_PAGE_ID;
+  if (cold_target_ + 1 < num_frames_)
+    cold_target_++;
+  return true;
+}
+
+/*
+ * Private helper: remember an evicted cold page during the rest of its test
+ * period. The page it replaces ends its test period without coming back, so
+ * the cold target shrinks.
+ */
+template <typename T>
+void ClockProReplacer<T>::AddNonResident(page_id_t key)
+{
+  if (key == INVALID_PAGE_ID)
+    return;
+  page_id_t &slot = non_resident_[static_cast<size_t>(key) % non_resident_size_];
+  if (slot != INVALID_PAGE_ID && cold_target_ > 1)
+    cold_target_--;
+  slot = key;
+}
+
+template class ClockProReplacer<Page *>;
+// test only
+template class ClockProReplacer<int>;
+
+} // namespace cmudb
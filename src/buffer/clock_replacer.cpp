@@ -0,0 +1,120 @@
+/**
+ * CLOCK implementation over a fixed range of frames
+ */
+#include <cassert>
+
+#include "buffer/clock_replacer.h"
+#include "page/page.h"
+
+namespace cmudb
+{
+
+template <typename T>
+ClockReplacer<T>::ClockReplacer(T base, size_t num_frames)
+    : base_(base), num_frames_(num_frames), hand_(0), size_(0)
+{
+  states_ = new FrameState[num_frames_];
+  for (size_t i = 0; i < num_frames_; ++i)
+    states_[i] = ABSENT;
+}
+
+template <typename T>
+ClockReplacer<T>::~ClockReplacer()
+{
+  delete[] states_;
+}
+
+/*
+ * Insert value into the clock, or give it a second chance if already there
+ */
+template <typename T>
+void ClockReplacer<T>::Insert(const T &value)
+{
+  std::lock_guard<std::mutex> lock(latch_);
+  size_t frame = FrameIndex(value);
+  assert(frame < num_frames_);
+  if (states_[frame] == ABSENT)
+    size_++;
+  states_[frame] = REFERENCED;
+}
+
+/*
+ * Sweep the hand until a value without reference bit is found, clearing the
+ * bits on the way (at most two rounds). Return false if the clock is empty.
+ */
+template <typename T>
+bool ClockReplacer<T>::Victim(T &value)
+{
+  std::lock_guard<std::mutex> lock(latch_);
+  if (size_ == 0)
+    return false;
+
+  while (true)
+  {
+    size_t frame = hand_;
+    hand_ = (hand_ + 1) % num_frames_;
+    if (states_[frame] == REFERENCED)
+    {
+      states_[frame] = PRESENT;
+    }
+    else if (states_[frame] == PRESENT)
+    {
+      states_[frame] = ABSENT;
+      size_--;
+      value = base_ + frame;
+      return true;
+    }
+  }
+}
+
+/*
+ * Remove value from the clock. If removal is successful, return true,
+ * otherwise return false
+ */
+template <typename T>
+bool ClockReplacer<T>::Erase(const T &value)
+{
+  std::lock_guard<std::mutex> lock(latch_);
+  size_t frame = FrameIndex(value);
+  assert(frame < num_frames_);
+  if (states_[frame] == ABSENT)
+    return false;
+  states_[frame] = ABSENT;
+  size_--;
+  return true;
+}
+
+template <typename T>
+size_t ClockReplacer<T>::Size()
+{
+  std::lock_guard<std::mutex> lock(latch_);
+  return size_;
+}
+
+/*
+ * Append up to count values in the order of the hand: those without
+ * reference bit in the first round, then the referenced ones
+ */
+template <typename T>
+void ClockReplacer<T>::PeekVictims(std::vector<T> &values, size_t count)
+{
+  std::lock_guard<std::mutex> lock(latch_);
+  for (FrameState state : {PRESENT, REFERENCED})
+  {
+    for (size_t i = 0; i < num_frames_ && count > 0; ++i)
+    {
+      size_t frame = (hand_ + i) % num_frames_;
+      if (states_[frame] == state)
+      {
+        values.push_back(base_ + frame);
+        count--;
+      }
+    }
+  }
+}
+
+template class ClockReplacer<Page *>;
+// test only
+template class ClockReplacer<int>;
+
+} // namespace cmudb
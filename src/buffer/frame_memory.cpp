@@ -0,0 +1,113 @@
+/**
+ * frame_memory.cpp
+ */
+#include <cstdint>
+#include <fstream>
+#include <linux/mempolicy.h>
+#include <new>
+#include <string>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "buffer/frame_memory.h"
+#include "common/config.h"
+#include "common/logger.h"
+
+namespace cmudb
+{
+
+static size_t RoundUpToHugePage(size_t length)
+{
+  return (length + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+}
+
+char *MapFrames(size_t length, HugePages &huge_pages)
+{
+  length = RoundUpToHugePage(length);
+  if (huge_pages == HugePages::EXPLICIT)
+  {
+    // not MAP_NORESERVE: a short pool fails here rather than on first touch
+    void *frames = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    if (frames != MAP_FAILED)
+      return static_cast<char *>(frames);
+    LOG_DEBUG("not enough explicit huge pages, using transparent ones");
+    huge_pages = HugePages::TRANSPARENT;
+  }
+
+  // map a huge page more and trim both ends, so the frames start aligned
+  size_t mapped_length = length + HUGE_PAGE_SIZE;
+  void *mapped = mmap(nullptr, mapped_length, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (mapped == MAP_FAILED)
+    throw std::bad_alloc();
+  uintptr_t start = reinterpret_cast<uintptr_t>(mapped);
+  uintptr_t aligned = RoundUpToHugePage(start);
+  if (aligned > start)
+    munmap(mapped, aligned - start);
+  if (aligned + length < start + mapped_length)
+    munmap(reinterpret_cast<void *>(aligned + length),
+           start + mapped_length - aligned - length);
+
+  char *frames = reinterpret_cast<char *>(aligned);
+  if (huge_pages == HugePages::TRANSPARENT &&
+      madvise(frames, length, MADV_HUGEPAGE) != 0)
+    huge_pages = HugePages::NONE;
+  // with transparent huge pages always on, opt out explicitly
+  if (huge_pages == HugePages::NONE)
+    madvise(frames, length, MADV_NOHUGEPAGE);
+  return frames;
+}
+
+void UnmapFrames(char *frames, size_t length)
+{
+  munmap(frames, RoundUpToHugePage(length));
+}
+
+void DiscardFrames(char *start, size_t length, HugePages huge_pages)
+{
+  // a huge page from the pool cannot be given back in part
+  if (huge_pages != HugePages::EXPLICIT)
+    madvise(start, length, MADV_DONTNEED);
+}
+
+/*
+ * Parse the node list of sysfs ("0-1,3") once
+ */
+const std::vector<int> &GetNumaNodes()
+{
+  static const std::vector<int> nodes = []() {
+    std::vector<int> nodes;
+    std::ifstream file("/sys/devices/system/node/has_memory");
+    std::string range;
+    while (std::getline(file, range, ','))
+    {
+      size_t dash = range.find('-');
+      int first = std::stoi(range.substr(0, dash));
+      int last = dash == std::string::npos ? first
+                                           : std::stoi(range.substr(dash + 1));
+      for (int node = first; node <= last; ++node)
+        nodes.push_back(node);
+    }
+    if (nodes.empty())
+      nodes.push_back(0);
+    return nodes;
+  }();
+  return nodes;
+}
+
+/*
+ * MPOL_PREFERRED rather than MPOL_BIND: a full node makes the kernel use
+ * another one instead of failing the page fault
+ */
+bool BindToNumaNode(char *start, size_t length, int node)
+{
+  const int bits_per_word = 8 * sizeof(unsigned long);
+  std::vector<unsigned long> node_mask(node / bits_per_word + 1, 0);
+  node_mask[node / bits_per_word] |= 1ul << (node % bits_per_word);
+  return syscall(SYS_mbind, start, length, MPOL_PREFERRED, node_mask.data(),
+                 node_mask.size() * bits_per_word + 1, 0) == 0;
+}
+
+} // namespace cmudb
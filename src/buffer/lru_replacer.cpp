@@ -113,6 +113,23 @@ size_t LRUReplacer<T>::Size()
   return LRU_->size();
 }
 
+/*
+ * Append up to count values from the least recently used end
+ */
+template <typename T>
+void LRUReplacer<T>::PeekVictims(std::vector<T> &values, size_t count)
+{
+  std::lock_guard<std::mutex> lock(latch_);
+
+  for (auto it = LRU_->begin(); it != LRU_->end() && count > 0; ++it, --count)
+  {
+    // timestamp - object
+    std::pair<size_t, T> object;
+    if (hash_map_->Find(it->second, object))
+      values.push_back(object.second);
+  }
+}
+
 template class LRUReplacer<Page *>;
 // test only
 template class LRUReplacer<int>;
@@ -0,0 +1,114 @@
+/**
+ * Open addressed page table with latch free lookups
+ */
+#include "buffer/page_table.h"
+
+namespace cmudb
+{
+
+PageTable::PageTable(Page *base, size_t num_frames)
+    : base_(base), removals_(0)
+{
+  size_t num_slots = 8;
+  shift_ = 61;
+  while (num_slots < 4 * num_frames)
+  {
+    num_slots *= 2;
+    shift_--;
+  }
+  mask_ = num_slots - 1;
+  slots_ = new std::atomic<uint64_t>[num_slots];
+  for (size_t i = 0; i < num_slots; ++i)
+    slots_[i].store(EMPTY_SLOT, std::memory_order_relaxed);
+}
+
+PageTable::~PageTable() { delete[] slots_; }
+
+/*
+ * Look up the frame of a page without taking any latch. A page mapped during
+ * the whole call is always found; the frame returned was mapped to the page
+ * at some point during the call, the caller has to check it still holds the
+ * page once it has pinned it.
+ */
+bool PageTable::Find(const page_id_t &page_id, Page *&frame)
+{
+  while (true)
+  {
+    uint64_t removals = removals_.load(std::memory_order_acquire);
+    if (removals % 2 == 0)
+    {
+      for (size_t slot = HomeSlot(page_id);; slot = (slot + 1) & mask_)
+      {
+        uint64_t entry = slots_[slot].load(std::memory_order_acquire);
+        if (entry == EMPTY_SLOT)
+          break;
+        if (EntryPageId(entry) == page_id)
+        {
+          frame = EntryFrame(entry);
+          return true;
+        }
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (removals_.load(std::memory_order_relaxed) == removals)
+        return false;
+    }
+  }
+}
+
+/*
+ * Remove a page, the entries probed after it are moved back so no probe
+ * sequence is broken. Caller must serialize Insert/Remove.
+ */
+bool PageTable::Remove(const page_id_t &page_id)
+{
+  size_t slot = HomeSlot(page_id);
+  while (true)
+  {
+    uint64_t entry = slots_[slot].load(std::memory_order_relaxed);
+    if (entry == EMPTY_SLOT)
+      return false;
+    if (EntryPageId(entry) == page_id)
+      break;
+    slot = (slot + 1) & mask_;
+  }
+
+  removals_.fetch_add(1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  size_t hole = slot;
+  for (size_t next = (hole + 1) & mask_;; next = (next + 1) & mask_)
+  {
+    uint64_t entry = slots_[next].load(std::memory_order_relaxed);
+    if (entry == EMPTY_SLOT)
+      break;
+    // the entry can fill the hole unless its home lies in (hole, next]
+    size_t home = HomeSlot(EntryPageId(entry));
+    if (((next - home) & mask_) >= ((next - hole) & mask_))
+    {
+      slots_[hole].store(entry, std::memory_order_release);
+      hole = next;
+    }
+  }
+  slots_[hole].store(EMPTY_SLOT, std::memory_order_release);
+  removals_.fetch_add(1, std::memory_order_release);
+  return true;
+}
+
+/*
+ * Map a page to a frame, replacing its mapping if it has one. Caller must
+ * serialize Insert/Remove.
+ */
+void PageTable::Insert(const page_id_t &page_id, Page *const &frame)
+{
+  uint64_t new_entry = MakeEntry(page_id, frame);
+  for (size_t slot = HomeSlot(page_id);; slot = (slot + 1) & mask_)
+  {
+    uint64_t entry = slots_[slot].load(std::memory_order_relaxed);
+    if (entry == EMPTY_SLOT || EntryPageId(entry) == page_id)
+    {
+      slots_[slot].store(new_entry, std::memory_order_release);
+      return;
+    }
+  }
+}
+
+} // namespace cmudb
@@ -0,0 +1,60 @@
+/**
+ * read_ahead.cpp
+ */
+
+#include <algorithm>
+
+#include "buffer/read_ahead.h"
+
+namespace cmudb
+{
+
+ReadAhead::ReadAhead(BufferPoolManager *buffer_pool_manager,
+                     BufferAccessStrategy *strategy)
+    : buffer_pool_manager_(buffer_pool_manager), strategy_(strategy),
+      last_page_id_(INVALID_PAGE_ID), sequential_pages_(0), window_(0),
+      prefetched_page_id_(INVALID_PAGE_ID)
+{
+}
+
+void ReadAhead::Advance(page_id_t page_id, page_id_t next_page_id)
+{
+  if (buffer_pool_manager_ == nullptr)
+    return;
+  if (last_page_id_ != INVALID_PAGE_ID && page_id == last_page_id_ + 1)
+  {
+    sequential_pages_++;
+  }
+  else
+  {
+    sequential_pages_ = 0;
+    window_ = 0;
+    prefetched_page_id_ = INVALID_PAGE_ID;
+  }
+  last_page_id_ = page_id;
+  if (next_page_id == INVALID_PAGE_ID)
+    return;
+  buffer_pool_manager_->PrefetchPage(next_page_id, strategy_);
+
+  if (sequential_pages_ < READ_AHEAD_TRIGGER || next_page_id != page_id + 1)
+    return;
+  // wait until half of the window has been consumed
+  if (window_ > 0 &&
+      prefetched_page_id_ - page_id > static_cast<page_id_t>(window_ / 2))
+    return;
+  size_t max_window = READ_AHEAD_MAX_PAGES;
+  if (strategy_ != nullptr)
+    max_window = std::min(max_window, strategy_->GetRingSize() / 2);
+  window_ = window_ == 0 ? READ_AHEAD_MIN_PAGES : window_ * 2;
+  window_ = std::min(window_, max_window);
+
+  page_id_t extent_end = (page_id / EXTENT_SIZE + 1) * EXTENT_SIZE;
+  page_id_t first = std::max(prefetched_page_id_, next_page_id) + 1;
+  page_id_t last = std::min<page_id_t>(page_id + window_, extent_end - 1);
+  for (page_id_t prefetch_page_id = first; prefetch_page_id <= last;
+       ++prefetch_page_id)
+    buffer_pool_manager_->PrefetchPage(prefetch_page_id, strategy_);
+  prefetched_page_id_ = std::max(prefetched_page_id_, last);
+}
+
+} // namespace cmudb
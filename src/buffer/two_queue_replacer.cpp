@@ -0,0 +1,190 @@
+/**
+ * 2Q implementation over a fixed range of frames
+ */
+#include <algorithm>
+#include <cassert>
+
+#include "buffer/two_queue_replacer.h"
+
+namespace cmudb
+{
+
+template <typename T>
+TwoQueueReplacer<T>::TwoQueueReplacer(T base, size_t num_frames)
+    : base_(base), num_frames_(num_frames), size_(0), a1in_count_(0),
+      a1in_max_(std::max<size_t>(1, num_frames / 4)),
+      a1out_size_(std::max<size_t>(1, num_frames / 2))
+{
+  frames_ = new FrameState[num_frames_ + AM + 1];
+  for (Queue queue : {A1IN, AM})
+  {
+    frames_[Sentinel(queue)].prev = Sentinel(queue);
+    frames_[Sentinel(queue)].next = Sentinel(queue);
+  }
+  a1out_ = new page_id_t[a1out_size_];
+  for (size_t i = 0; i < a1out_size_; ++i)
+    a1out_[i] = INVALID_PAGE_ID;
+}
+
+template <typename T>
+TwoQueueReplacer<T>::~TwoQueueReplacer()
+{
+  delete[] frames_;
+  delete[] a1out_;
+}
+
+/*
+ * Insert value at the most recently used end of its queue: a page new to its
+ * frame goes to Am if remembered in A1out, to A1in otherwise
+ */
+template <typename T>
+void TwoQueueReplacer<T>::Insert(const T &value)
+{
+  std::lock_guard<std::mutex> lock(latch_);
+  size_t index = FrameIndex(value);
+  assert(index < num_frames_);
+  FrameState &frame = frames_[index];
+  page_id_t key = ReplacerKey(value);
+
+  if (frame.present)
+    Unlink(index);
+  else
+    size_++;
+  frame.present = true;
+  if (frame.key != key)
+  {
+    // the frame was given to a deleted page before
+    if (frame.queue == A1IN)
+      a1in_count_--;
+    frame.key = key;
+    frame.queue = TakeA1out(key) ? AM : A1IN;
+    if (frame.queue == A1IN)
+      a1in_count_++;
+  }
+  Link(index);
+}
+
+/*
+ * Take the least recently used page of A1in if it is over its target (it is
+ * then remembered in A1out) or Am is empty, of Am otherwise. Return false if
+ * the replacer is empty.
+ */
+template <typename T>
+bool TwoQueueReplacer<T>::Victim(T &value)
+{
+  std::lock_guard<std::mutex> lock(latch_);
+  if (size_ == 0)
+    return false;
+
+  size_t a1in_lru = frames_[Sentinel(A1IN)].prev;
+  size_t am_lru = frames_[Sentinel(AM)].prev;
+  size_t index = am_lru;
+  if (a1in_lru != Sentinel(A1IN) &&
+      (a1in_count_ > a1in_max_ || am_lru == Sentinel(AM)))
+    index = a1in_lru;
+
+  FrameState &frame = frames_[index];
+  Unlink(index);
+  if (frame.queue == A1IN)
+  {
+    AddA1out(frame.key);
+    a1in_count_--;
+  }
+  frame.present = false;
+  frame.queue = NONE;
+  frame.key = INVALID_PAGE_ID;
+  size_--;
+  value = base_ + index;
+  return true;
+}
+
+/*
+ * Remove value from its queue (it is pinned), it stays in that queue for
+ * when it is inserted again. If removal is successful, return true,
+ * otherwise return false
+ */
+template <typename T>
+bool TwoQueueReplacer<T>::Erase(const T &value)
+{
+  std::lock_guard<std::mutex> lock(latch_);
+  size_t index = FrameIndex(value);
+  assert(index < num_frames_);
+  if (!frames_[index].present)
+    return false;
+  Unlink(index);
+  frames_[index].present = false;
+  size_--;
+  return true;
+}
+
+template <typename T>
+size_t TwoQueueReplacer<T>::Size()
+{
+  std::lock_guard<std::mutex> lock(latch_);
+  return size_;
+}
+
+/*
+ * Append up to count values from the least recently used end of the queue
+ * victims are taken from now, then of the other one
+ */
+template <typename T>
+void TwoQueueReplacer<T>::PeekVictims(std::vector<T> &values, size_t count)
+{
+  std::lock_guard<std::mutex> lock(latch_);
+  Queue first = a1in_count_ > a1in_max_ ? A1IN : AM;
+  for (Queue queue : {first, first == A1IN ? AM : A1IN})
+  {
+    for (size_t index = frames_[Sentinel(queue)].prev;
+         index != Sentinel(queue) && count > 0; index = frames_[index].prev)
+    {
+      values.push_back(base_ + index);
+      count--;
+    }
+  }
+}
+
+// Private helper: link a frame at the most recently used end of its queue
+template <typename T>
+void TwoQueueReplacer<T>::Link(size_t index)
+{
+  size_t head = Sentinel(frames_[index].queue);
+  frames_[index].prev = head;
+  frames_[index].next = frames_[head].next;
+  frames_[frames_[head].next].prev = index;
+  frames_[head].next = index;
+}
+
+template <typename T>
+void TwoQueueReplacer<T>::Unlink(size_t index)
+{
+  frames_[frames_[index].prev].next = frames_[index].next;
+  frames_[frames_[index].next].prev = frames_[index].prev;
+}
+
+/*
+ * Private helper: if key was recently evicted from A1in, forget it and
+ * return true
+ */
+template <typename T>
+bool TwoQueueReplacer<T>::TakeA1out(page_id_t key)
+{
+  page_id_t &slot = a1out_[static_cast<size_t>(key) % a1out_size_];
+  if (key == INVALID_PAGE_ID || slot != key)
+    return false;
+  slot = INVALID_PAGE_ID;
+  return true;
+}
+
+template <typename T>
+void TwoQueueReplacer<T>::AddA1out(page_id_t key)
+{
+  if (key != INVALID_PAGE_ID)
+    a1out_[static_cast<size_t>(key) % a1out_size_] = key;
+}
+
+template class TwoQueueReplacer<Page *>;
+// test only
+template class TwoQueueReplacer<int>;
+
+} // namespace cmudb
@@ -0,0 +1,174 @@
+/**
+ * crc32c.cpp
+ */
+#include <cstring>
+
+#include "common/crc32c.h"
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+namespace cmudb
+{
+
+// reversed Castagnoli polynomial
+static const uint32_t CRC32C_POLY = 0x82f63b78;
+
+namespace
+{
+struct Crc32cTable
+{
+  uint32_t entries[256];
+  Crc32cTable()
+  {
+    for (uint32_t i = 0; i < 256; i++)
+    {
+      uint32_t crc = i;
+      for (int bit = 0; bit < 8; bit++)
+        crc = (crc >> 1) ^ ((crc & 1) ? CRC32C_POLY : 0);
+      entries[i] = crc;
+    }
+  }
+};
+} // namespace
+
+static uint32_t Crc32cSoftware(const char *data, size_t len, uint32_t crc)
+{
+  static const Crc32cTable table;
+  const unsigned char *p = reinterpret_cast<const unsigned char *>(data);
+  for (size_t i = 0; i < len; i++)
+    crc = table.entries[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+  return crc;
+}
+
+#if defined(__x86_64__)
+// block sizes of the three way interleaved loop, powers of two
+static const size_t LONG_BLOCK = 1024;
+static const size_t SHORT_BLOCK = 256;
+
+namespace
+{
+// multiplication of a crc register by x^(8 * len) modulo the polynomial, i.e.
+// the crc of len zero bytes appended, as four byte wise lookup tables (GF(2)
+// matrix technique of zlib's crc32_combine)
+struct Crc32cShift
+{
+  uint32_t entries[4][256];
+
+  static uint32_t MatrixTimes(const uint32_t *matrix, uint32_t vec)
+  {
+    uint32_t sum = 0;
+    for (; vec != 0; vec >>= 1, matrix++)
+    {
+      if (vec & 1)
+        sum ^= *matrix;
+    }
+    return sum;
+  }
+
+  static void MatrixSquare(uint32_t *square, const uint32_t *matrix)
+  {
+    for (int n = 0; n < 32; n++)
+      square[n] = MatrixTimes(matrix, matrix[n]);
+  }
+
+  Crc32cShift(size_t len)
+  {
+    // operator for one zero bit, then squared up to 8 * len bits
+    uint32_t op[32], tmp[32];
+    op[0] = CRC32C_POLY;
+    for (int n = 1; n < 32; n++)
+      op[n] = 1u << (n - 1);
+    for (size_t bits = 1; bits < 8 * len; bits *= 2)
+    {
+      MatrixSquare(tmp, op);
+      memcpy(op, tmp, sizeof(op));
+    }
+    for (uint32_t n = 0; n < 256; n++)
+    {
+      for (int byte = 0; byte < 4; byte++)
+        entries[byte][n] = MatrixTimes(op, n << (8 * byte));
+    }
+  }
+
+  inline uint32_t Apply(uint32_t crc) const
+  {
+    return entries[0][crc & 0xff] ^ entries[1][(crc >> 8) & 0xff] ^
+           entries[2][(crc >> 16) & 0xff] ^ entries[3][crc >> 24];
+  }
+};
+} // namespace
+
+static const Crc32cShift long_shift(LONG_BLOCK);
+static const Crc32cShift short_shift(SHORT_BLOCK);
+
+// crc32 has a latency of three cycles but a throughput of one per cycle, so
+// three independent streams over consecutive blocks keep it busy; their
+// crcs are then combined by shifting
+__attribute__((target("sse4.2"))) static const char *
+Crc32cInterleaved(const char *data, size_t &len, uint64_t &crc0,
+                  size_t block, const Crc32cShift &shift)
+{
+  while (len >= 3 * block)
+  {
+    uint64_t crc1 = 0, crc2 = 0;
+    for (const char *end = data + block; data < end; data += 8)
+    {
+      uint64_t word0, word1, word2;
+      memcpy(&word0, data, 8);
+      memcpy(&word1, data + block, 8);
+      memcpy(&word2, data + 2 * block, 8);
+      crc0 = _mm_crc32_u64(crc0, word0);
+      crc1 = _mm_crc32_u64(crc1, word1);
+      crc2 = _mm_crc32_u64(crc2, word2);
+    }
+    crc0 = shift.Apply(static_cast<uint32_t>(crc0)) ^ crc1;
+    crc0 = shift.Apply(static_cast<uint32_t>(crc0)) ^ crc2;
+    data += 2 * block;
+    len -= 3 * block;
+  }
+  return data;
+}
+
+__attribute__((target("sse4.2"))) static uint32_t
+Crc32cHardware(const char *data, size_t len, uint32_t crc)
+{
+  uint64_t crc64 = crc;
+  data = Crc32cInterleaved(data, len, crc64, LONG_BLOCK, long_shift);
+  data = Crc32cInterleaved(data, len, crc64, SHORT_BLOCK, short_shift);
+  size_t i = 0;
+  for (; i + 8 <= len; i += 8)
+  {
+    uint64_t word;
+    memcpy(&word, data + i, 8);
+    crc64 = _mm_crc32_u64(crc64, word);
+  }
+  crc = static_cast<uint32_t>(crc64);
+  for (; i < len; i++)
+    crc = _mm_crc32_u8(crc, data[i]);
+  return crc;
+}
+#endif
+
+typedef uint32_t (*Crc32cFunction)(const char *, size_t, uint32_t);
+
+static Crc32cFunction ChooseCrc32c()
+{
+#if defined(__x86_64__)
+  if (__builtin_cpu_supports("sse4.2"))
+    return Crc32cHardware;
+#endif
+  return Crc32cSoftware;
+}
+
+static const Crc32cFunction crc32c_function = ChooseCrc32c();
+
+uint32_t Crc32c(const char *data, size_t len, uint32_t crc)
+{
+  return ~crc32c_function(data, len, ~crc);
+}
+
+bool Crc32cIsHardware() { return crc32c_function != Crc32cSoftware; }
+
+} // namespace cmudb
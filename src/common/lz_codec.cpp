@@ -0,0 +1,172 @@
+/**
+ * lz_codec.cpp
+ */
+#include <cstdint>
+#include <cstring>
+
+#include "common/lz_codec.h"
+
+namespace cmudb
+{
+
+static const size_t MIN_MATCH = 4;
+static const size_t MAX_OFFSET = 65535;
+// the last bytes are always literals, so the match finder can read 4 bytes
+// anywhere it looks
+static const size_t LAST_LITERALS = 5;
+static const int HASH_BITS = 12;
+
+static inline uint32_t Read32(const unsigned char *p)
+{
+  uint32_t value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+static inline uint32_t Hash(uint32_t sequence)
+{
+  return (sequence * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// append a length continuation (runs of 255), false if out of space
+static bool PutLength(unsigned char *&op, const unsigned char *end,
+                      size_t length)
+{
+  for (; length >= 255; length -= 255)
+  {
+    if (op >= end)
+      return false;
+    *op++ = 255;
+  }
+  if (op >= end)
+    return false;
+  *op++ = static_cast<unsigned char>(length);
+  return true;
+}
+
+// append a sequence, match_length 0 for the final literal run
+static bool PutSequence(unsigned char *&op, const unsigned char *end,
+                        const unsigned char *literals, size_t literal_length,
+                        size_t offset, size_t match_length)
+{
+  if (op >= end)
+    return false;
+  unsigned char *token = op++;
+  *token = (literal_length < 15 ? literal_length : 15) << 4;
+  if (literal_length >= 15 && !PutLength(op, end, literal_length - 15))
+    return false;
+  if (static_cast<size_t>(end - op) < literal_length)
+    return false;
+  memcpy(op, literals, literal_length);
+  op += literal_length;
+  if (match_length == 0)
+    return true;
+
+  if (end - op < 2)
+    return false;
+  *op++ = offset & 0xff;
+  *op++ = offset >> 8;
+  size_t length = match_length - MIN_MATCH;
+  *token |= length < 15 ? length : 15;
+  return length < 15 || PutLength(op, end, length - 15);
+}
+
+size_t LzCompress(const char *src, size_t len, char *dst, size_t capacity)
+{
+  const unsigned char *in = reinterpret_cast<const unsigned char *>(src);
+  unsigned char *op = reinterpret_cast<unsigned char *>(dst);
+  const unsigned char *end = op + capacity;
+  // last position + 1 of every hashed 4 byte sequence, 0 for none
+  uint32_t table[1 << HASH_BITS] = {0};
+
+  size_t anchor = 0;
+  size_t ip = 0;
+  while (ip + MIN_MATCH + LAST_LITERALS <= len)
+  {
+    uint32_t sequence = Read32(in + ip);
+    uint32_t &slot = table[Hash(sequence)];
+    size_t ref = slot;
+    slot = ip + 1;
+    if (ref == 0 || ip + 1 - ref > MAX_OFFSET ||
+        Read32(in + ref - 1) != sequence)
+    {
+      ip++;
+      continue;
+    }
+    ref--;
+    size_t match_length = MIN_MATCH;
+    while (ip + match_length < len - LAST_LITERALS &&
+           in[ref + match_length] == in[ip + match_length])
+      match_length++;
+    if (!PutSequence(op, end, in + anchor, ip - anchor, ip - ref,
+                     match_length))
+      return 0;
+    ip += match_length;
+    anchor = ip;
+  }
+  if (!PutSequence(op, end, in + anchor, len - anchor, 0, 0))
+    return 0;
+  return op - reinterpret_cast<unsigned char *>(dst);
+}
+
+// read a length continuation, false if it runs past the end
+static bool GetLength(const unsigned char *&ip, const unsigned char *end,
+                      size_t &length)
+{
+  unsigned char byte;
+  do
+  {
+    if (ip >= end)
+      return false;
+    byte = *ip++;
+    length += byte;
+  } while (byte == 255);
+  return true;
+}
+
+bool LzDecompress(const char *src, size_t len, char *dst, size_t dst_len)
+{
+  const unsigned char *ip = reinterpret_cast<const unsigned char *>(src);
+  const unsigned char *in_end = ip + len;
+  unsigned char *out = reinterpret_cast<unsigned char *>(dst);
+  size_t op = 0;
+  while (ip < in_end)
+  {
+    unsigned char token = *ip++;
+    size_t literal_length = token >> 4;
+    if (literal_length == 15 && !GetLength(ip, in_end, literal_length))
+      return false;
+    if (static_cast<size_t>(in_end - ip) < literal_length ||
+        dst_len - op < literal_length)
+      return false;
+    memcpy(out + op, ip, literal_length);
+    ip += literal_length;
+    op += literal_length;
+    // the final sequence has no match
+    if (ip == in_end)
+      break;
+
+    if (in_end - ip < 2)
+      return false;
+    size_t offset = ip[0] | (ip[1] << 8);
+    ip += 2;
+    size_t match_length = token & 15;
+    if (match_length == 15 && !GetLength(ip, in_end, match_length))
+      return false;
+    match_length += MIN_MATCH;
+    if (offset == 0 || offset > op || dst_len - op < match_length)
+      return false;
+    if (offset >= match_length)
+      memcpy(out + op, out + op - offset, match_length);
+    else
+    {
+      // byte by byte, the match overlaps the bytes it produces
+      for (size_t i = 0; i < match_length; i++)
+        out[op + i] = out[op + i - offset];
+    }
+    op += match_length;
+  }
+  return op == dst_len;
+}
+
+} // namespace cmudb
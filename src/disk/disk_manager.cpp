@@ -1,108 +1,1283 @@
 /**
  * disk_manager.cpp
  */
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
 #include <cstring>
-#include <iostream>
+#include <fcntl.h>
+#include <iterator>
+#include <memory>
 #include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <unordered_map>
 
+#include "common/crc32c.h"
+#include "common/exception.h"
 #include "common/logger.h"
+#include "common/lz_codec.h"
 #include "disk/disk_manager.h"
 
 namespace cmudb
 {
 
+// first bytes of every bitmap page
+static const uint32_t BITMAP_MAGIC = 0x42444d43;
+
+// where bitmap page 0 records the number of data files
+static const size_t BITMAP_NUM_FILES_OFFSET = 4;
+
+// where bitmap page 0 records the on-disk format version, bumped whenever
+// the place of pages in the files or the layout of a page changes
+static const size_t BITMAP_VERSION_OFFSET = 8;
+static const uint32_t DISK_FORMAT_VERSION = 1;
+
+// a slot of the double write file: header followed by the page image
+struct DoubleWriteHeader
+{
+  uint64_t seq; // 0 for a slot never written
+  page_id_t page_id;
+  uint32_t reserved;
+};
+static const size_t DOUBLE_WRITE_SLOT_SIZE =
+    sizeof(DoubleWriteHeader) + PAGE_SIZE;
+
+// the page is written from a copy stamped with its checksum, the caller's
+// buffer is left alone (a frame may change while its write is in flight)
+static char *StampedCopy(const char *page_data, char *copy)
+{
+  memcpy(copy, page_data, PAGE_SIZE);
+  uint32_t crc = Crc32c(copy, PAGE_DATA_SIZE);
+  memcpy(copy + PAGE_DATA_SIZE, &crc, PAGE_CHECKSUM_SIZE);
+  return copy;
+}
+
+static void StampChecksum(char *page_data)
+{
+  uint32_t crc = Crc32c(page_data, PAGE_DATA_SIZE);
+  memcpy(page_data + PAGE_DATA_SIZE, &crc, PAGE_CHECKSUM_SIZE);
+}
+
+// a page that was never written (all zeros) carries no checksum
+static bool HasValidChecksum(const char *page_data)
+{
+  uint32_t stored;
+  memcpy(&stored, page_data + PAGE_DATA_SIZE, PAGE_CHECKSUM_SIZE);
+  if (stored == Crc32c(page_data, PAGE_DATA_SIZE))
+    return true;
+  if (stored != 0)
+    return false;
+  for (size_t i = 0; i < PAGE_DATA_SIZE; i++)
+  {
+    if (page_data[i] != 0)
+      return false;
+  }
+  return true;
+}
+
+// a compressed page image: this header, then the compressed page
+struct CompressedPageHeader
+{
+  uint32_t magic;
+  uint32_t length; // of the compressed page
+  uint32_t crc;    // of magic, length and the compressed page
+};
+static const uint32_t COMPRESSED_PAGE_MAGIC = 0x50434443;
+
+static uint32_t CompressedPageCrc(const CompressedPageHeader &header,
+                                  const char *compressed)
+{
+  uint32_t crc = Crc32c(reinterpret_cast<const char *>(&header),
+                        offsetof(CompressedPageHeader, crc));
+  return Crc32c(compressed, header.length, crc);
+}
+
+// inflate a compressed page image in place, any other page is left alone
+// @return: false if a compressed image could not be inflated
+static bool DecompressPage(char *page_data)
+{
+  CompressedPageHeader header;
+  memcpy(&header, page_data, sizeof(header));
+  const char *compressed = page_data + sizeof(header);
+  if (header.magic != COMPRESSED_PAGE_MAGIC ||
+      header.length > PAGE_SIZE - sizeof(header) ||
+      CompressedPageCrc(header, compressed) != header.crc)
+    return true;
+  char page[PAGE_SIZE];
+  if (!LzDecompress(compressed, header.length, page, PAGE_SIZE))
+    return false;
+  memcpy(page_data, page, PAGE_SIZE);
+  return true;
+}
+
 /**
  * Constructor: open/create a single database file
  * @input db_file: database file name
+ * @input direct_io: open the file with O_DIRECT, bypassing the page cache
+ */
+DiskManager::DiskManager(const std::string &db_file, bool direct_io)
+    : DiskManager(std::vector<std::string>{db_file}, direct_io)
+{
+}
+
+/**
+ * Constructor: open/create a database striped over several files
+ * @input db_files: data file names, the same ones in the same order every
+ * time the database is opened
+ * @input direct_io: open the files with O_DIRECT, bypassing the page cache
+ */
+DiskManager::DiskManager(const std::vector<std::string> &db_files,
+                         bool direct_io)
+    : direct_io_(false), file_name_(db_files.at(0)), next_page_id_(0),
+      growth_step_(static_cast<off_t>(FILE_GROWTH_STEP) * PAGE_SIZE),
+      durability_(DurabilityLevel::NONE), syncs_started_(0), syncs_done_(0),
+      sync_running_(false), sync_waiters_(0), unsynced_bytes_(0),
+      group_interval_(GROUP_COMMIT_INTERVAL_MS),
+      group_bytes_(GROUP_COMMIT_BYTES), group_shutdown_(false),
+      checksum_mode_(ChecksumMode::OFF), dblwr_fd_(-1), dblwr_next_slot_(0),
+      dblwr_seq_(0), compression_(false), fs_block_size_(PAGE_SIZE),
+      write_coalescing_(true), io_engine_(nullptr)
+{
+  try
+  {
+    for (auto &name : db_files)
+      OpenFile(name, direct_io);
+    std::lock_guard<std::mutex> lock(alloc_latch_);
+    LoadBitmaps();
+  }
+  catch (...)
+  {
+    CloseFiles();
+    throw;
+  }
+}
+
+/**
+ * Private helper function to open/create a data file, the file is created if
+ * it does not exist but an existing one is never truncated
+ */
+void DiskManager::OpenFile(const std::string &name, bool direct_io)
+{
+  int flags = O_RDWR | O_CREAT;
+  int fd = -1;
+  if (direct_io)
+  {
+    fd = open(name.c_str(), flags | O_DIRECT, 0644);
+    if (fd >= 0)
+      direct_io_ = true;
+    else if (errno == EINVAL)
+    {
+      // e.g. tmpfs, keep going with buffered I/O
+      LOG_DEBUG("O_DIRECT not supported for %s", name.c_str());
+    }
+  }
+  if (fd < 0)
+    fd = open(name.c_str(), flags, 0644);
+  if (fd < 0)
+    throw Exception("can't open db file " + name + ": " + strerror(errno));
+
+  DataFile *file = new DataFile;
+  file->fd = fd;
+  file->name = name;
+  file->size = 0;
+  struct stat stat_buf;
+  if (fstat(fd, &stat_buf) == 0)
+  {
+    file->size = stat_buf.st_size;
+    if (files_.empty() || stat_buf.st_blksize > fs_block_size_)
+      fs_block_size_ = stat_buf.st_blksize;
+  }
+  file->preallocated_size = file->size.load();
+  files_.push_back(file);
+}
+
+/**
+ * Private helper functions to map a page id to its data file and the offset
+ * in it. Extents are striped round robin over the files; within a file the
+ * pages are grouped by PAGES_PER_BITMAP, each group preceded by a bitmap
+ * page slot. With a single file this is the plain layout: bitmap page k,
+ * then the pages it covers.
  */
-DiskManager::DiskManager(const std::string &db_file)
-    : file_name_(db_file), next_page_id_(0)
+DiskManager::DataFile *DiskManager::PageLocation(page_id_t page_id,
+                                                 off_t &offset)
+{
+  size_t extent = page_id / EXTENT_SIZE;
+  off_t local = static_cast<off_t>(extent / files_.size()) * EXTENT_SIZE +
+                page_id % EXTENT_SIZE;
+  offset = (local + local / PAGES_PER_BITMAP + 1) * PAGE_SIZE;
+  return files_[extent % files_.size()];
+}
+
+DiskManager::DataFile *DiskManager::BitmapLocation(size_t index,
+                                                   off_t &offset)
+{
+  offset = static_cast<off_t>(index / files_.size()) * (PAGES_PER_BITMAP + 1) *
+           PAGE_SIZE;
+  return files_[index % files_.size()];
+}
+
+void DiskManager::CloseFiles()
 {
-  db_io_.open(db_file, std::ios::binary | std::ios::in | std::ios::out);
-  // directory or file does not exist
-  if (!db_io_.is_open())
+  for (auto file : files_)
   {
-    db_io_.clear();
-    // create a new file
-    db_io_.open(db_file, std::ios::binary | std::ios::trunc | std::ios::out);
-    db_io_.close();
-    // reopen with original mode
-    db_io_.open(db_file, std::ios::binary | std::ios::in | std::ios::out);
+    close(file->fd);
+    delete file;
   }
+  files_.clear();
 }
 
-DiskManager::~DiskManager() { db_io_.close(); }
+DiskManager::~DiskManager()
+{
+  StopGroupSyncer();
+  // drains outstanding asynchronous I/O
+  delete io_engine_;
+  {
+    std::lock_guard<std::mutex> lock(alloc_latch_);
+    for (size_t i = 0; i < bitmaps_.size(); i++)
+    {
+      if (bitmap_dirty_[i])
+        WriteBitmap(i);
+      free(bitmaps_[i]);
+    }
+  }
+  Sync();
+  CloseFiles();
+  if (dblwr_fd_ >= 0)
+    close(dblwr_fd_);
+}
 
 /**
  * Write the contents of the specified page into disk file
+ * pwrite does not move any shared file cursor, so concurrent writers of
+ * different pages never serialize on each other (except in REPAIR mode,
+ * where writers take turns on the double write file)
  */
 void DiskManager::WritePage(page_id_t page_id, const char *page_data)
 {
-  size_t offset = page_id * PAGE_SIZE;
-  // set write cursor to offset
-  db_io_.seekp(offset);
-  db_io_.write(page_data, PAGE_SIZE);
+  // page aligned, so direct I/O can write it as is
+  alignas(PAGE_SIZE) char copy[PAGE_SIZE];
+  StampedCopy(page_data, copy);
+  if (checksum_mode_ == ChecksumMode::REPAIR)
+  {
+    std::lock_guard<std::mutex> lock(dblwr_latch_);
+    PageWrite page = {page_id, copy};
+    DoubleWrite(&page, 1);
+    WriteInPlace(page_id, copy);
+  }
+  else
+    WriteInPlace(page_id, copy);
+}
+
+/**
+ * Private helper function to write a page at its place in the db file
+ */
+void DiskManager::WriteInPlace(page_id_t page_id, const char *page_data)
+{
+  off_t offset;
+  DataFile *file = PageLocation(page_id, offset);
+  size_t size = PAGE_SIZE;
+  // compressed image, or aligned copy of page_data for direct I/O
+  alignas(PAGE_SIZE) char buf[PAGE_SIZE];
+  if (compression_)
+  {
+    size = CompressPage(page_data, buf);
+    if (size < PAGE_SIZE)
+      page_data = buf;
+  }
+  if (direct_io_ && !IsPageAligned(page_data))
+  {
+    memcpy(buf, page_data, PAGE_SIZE);
+    page_data = buf;
+  }
+  GrowFile(file, offset + PAGE_SIZE);
   // check for I/O error
-  if (db_io_.bad())
+  if (PositionalWrite(file->fd, page_data, size, offset) < 0)
   {
     LOG_DEBUG("I/O error while writing");
+  }
+  else if (size < PAGE_SIZE)
+    PunchTail(file, offset, size);
+  AddUnsyncedBytes(size);
+}
+
+/**
+ * Turn transparent compression on or off. Compression only saves space on
+ * file systems with blocks smaller than a page, elsewhere pages are written
+ * as is.
+ */
+void DiskManager::SetCompression(bool enable)
+{
+  compression_ = enable;
+  if (enable && fs_block_size_ >= PAGE_SIZE)
+  {
+    LOG_DEBUG("compression saves no space with %ld byte file system blocks",
+              static_cast<long>(fs_block_size_));
+  }
+}
+
+/**
+ * Private helper function to compress a page into image (PAGE_SIZE bytes)
+ * The image takes whole file system blocks: only whole blocks are punched
+ * out, and a write of part of a block makes the kernel read the block first
+ * (O_DIRECT cannot write less). With blocks as large as a page nothing is
+ * compressed.
+ * @return: size of the image, PAGE_SIZE if compression saves nothing (image
+ * is not used then)
+ */
+size_t DiskManager::CompressPage(const char *page_data, char *image)
+{
+  size_t block = static_cast<size_t>(fs_block_size_);
+  if (block >= PAGE_SIZE)
+    return PAGE_SIZE;
+  CompressedPageHeader header;
+  header.length = LzCompress(page_data, PAGE_SIZE, image + sizeof(header),
+                             PAGE_SIZE - block - sizeof(header));
+  if (header.length == 0)
+    return PAGE_SIZE;
+  header.magic = COMPRESSED_PAGE_MAGIC;
+  header.crc = CompressedPageCrc(header, image + sizeof(header));
+  memcpy(image, &header, sizeof(header));
+  size_t used = sizeof(header) + header.length;
+  size_t size = (used + block - 1) / block * block;
+  memset(image + used, 0, size - used);
+  return size;
+}
+
+/**
+ * Private helper function to give back the file system blocks of a page slot
+ * behind its compressed image; what is left of a partly used block stays
+ * and is ignored by reads
+ */
+void DiskManager::PunchTail(DataFile *file, off_t offset, size_t image_size)
+{
+  off_t start = (offset + static_cast<off_t>(image_size) + fs_block_size_ - 1) /
+                fs_block_size_ * fs_block_size_;
+  off_t end = offset + PAGE_SIZE;
+  if (start >= end)
     return;
+  if (fallocate(file->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, start,
+                end - start) < 0)
+  {
+    LOG_DEBUG("punching a hole failed: %s", strerror(errno));
   }
-  // needs to flush to keep disk file in sync
-  db_io_.flush();
+}
+
+/**
+ * Private helper function run on every page read: inflate a compressed image
+ * and verify the checksum
+ */
+bool DiskManager::FinishRead(page_id_t page_id, char *page_data)
+{
+  if (DecompressPage(page_data) &&
+      (checksum_mode_ == ChecksumMode::OFF || HasValidChecksum(page_data)))
+    return true;
+  return RecoverPage(page_id, page_data);
 }
 
 /**
  * Read the contents of the specified page into the given memory area
+ * The file size is cached, so a read costs a single pread. Reading beyond
+ * the end of file yields zeros, as with ReadPageAsync.
+ * @return: false on I/O error or if the checksum does not match (and the page
+ * could not be repaired)
  */
-void DiskManager::ReadPage(page_id_t page_id, char *page_data)
+bool DiskManager::ReadPage(page_id_t page_id, char *page_data)
 {
-  int offset = page_id * PAGE_SIZE;
+  off_t offset;
+  DataFile *file = PageLocation(page_id, offset);
   // check if read beyond file length
-  if (offset >= GetFileSize())
+  if (offset >= file->size)
   {
     LOG_DEBUG("I/O error while reading");
-    // std::cerr << "I/O error while reading" << std::endl;
+    memset(page_data, 0, PAGE_SIZE);
+    return true;
   }
-  else
+  char *bounce = nullptr;
+  char *buf = page_data;
+  if (direct_io_ && !IsPageAligned(page_data))
+    buf = bounce = AllocateAlignedPages(1);
+  ssize_t read_count = PositionalRead(file->fd, buf, PAGE_SIZE, offset);
+  if (read_count < 0)
+  {
+    LOG_DEBUG("I/O error while reading");
+    free(bounce);
+    return false;
+  }
+  // if file ends before reading PAGE_SIZE
+  if (read_count < PAGE_SIZE)
+  {
+    LOG_DEBUG("Read less than a page");
+    memset(buf + read_count, 0, PAGE_SIZE - read_count);
+  }
+  if (bounce != nullptr)
+  {
+    memcpy(page_data, bounce, PAGE_SIZE);
+    free(bounce);
+  }
+  return FinishRead(page_id, page_data);
+}
+
+/**
+ * Queue a read of the specified page, the callback is invoked once the page
+ * content is in page_data. Reading beyond the end of file yields zeros.
+ */
+void DiskManager::ReadPageAsync(page_id_t page_id, char *page_data,
+                                const IOCallback &callback)
+{
+  std::vector<IORequest> requests(1);
+  requests[0].fd = PageLocation(page_id, requests[0].offset)->fd;
+  requests[0].is_write = false;
+  requests[0].buf = page_data;
+  requests[0].len = PAGE_SIZE;
+  requests[0].callback = [this, page_id, page_data, callback](bool success) {
+    if (success)
+      success = FinishRead(page_id, page_data);
+    if (callback)
+      callback(success);
+  };
+  GetIOEngine()->Submit(requests);
+}
+
+void DiskManager::WritePageAsync(page_id_t page_id, const char *page_data,
+                                 const IOCallback &callback)
+{
+  WritePagesAsync({{page_id, page_data}}, callback);
+}
+
+/**
+ * Queue the writes of a batch of pages, all of them are in flight at the same
+ * time (up to IO_QUEUE_DEPTH). The callback runs once after the last page of
+ * the batch completes, with false if any of the writes failed.
+ * With write coalescing on, the pages are written in page id order and the
+ * pages that are adjacent in a data file go in one vectored write of up to
+ * WRITE_COALESCE_PAGES pages (a compressed page is written alone).
+ */
+void DiskManager::WritePagesAsync(const std::vector<PageWrite> &batch,
+                                  const IOCallback &callback)
+{
+  if (batch.empty())
+  {
+    if (callback)
+      callback(true);
+    return;
+  }
+  struct BatchState
   {
-    // set read cursor to offset
-    db_io_.seekp(offset);
-    db_io_.read(page_data, PAGE_SIZE);
-    // if file ends before reading PAGE_SIZE
-    int read_count = db_io_.gcount();
-    if (read_count < PAGE_SIZE)
+    // pages not written yet
+    std::atomic<size_t> remaining;
+    std::atomic<bool> success;
+    IOCallback callback;
+    // stamped copies and compressed images of the batch
+    char *copies = nullptr;
+    char *images = nullptr;
+    ~BatchState()
     {
-      LOG_DEBUG("Read less than a page");
-      // std::cerr << "Read less than a page" << std::endl;
-      memset(page_data + read_count, 0, PAGE_SIZE - read_count);
+      free(copies);
+      free(images);
     }
+  };
+  auto state = std::make_shared<BatchState>();
+  state->remaining = batch.size();
+  state->success = true;
+  state->callback = callback;
+  state->copies = AllocateAlignedPages(batch.size());
+  if (compression_)
+    state->images = AllocateAlignedPages(batch.size());
+
+  std::vector<PageWrite> pages(batch);
+  if (write_coalescing_)
+  {
+    std::stable_sort(pages.begin(), pages.end(),
+                     [](const PageWrite &a, const PageWrite &b) {
+                       return a.page_id < b.page_id;
+                     });
+  }
+  // the double write file holds DOUBLE_WRITE_SLOTS pages, so in REPAIR mode a
+  // large batch goes in chunks
+  size_t chunk_size = pages.size();
+  std::unique_lock<std::mutex> dblwr_lock(dblwr_latch_, std::defer_lock);
+  if (checksum_mode_ == ChecksumMode::REPAIR)
+  {
+    chunk_size = DOUBLE_WRITE_SLOTS;
+    dblwr_lock.lock();
+  }
+  for (size_t start = 0; start < pages.size(); start += chunk_size)
+  {
+    size_t end = std::min(pages.size(), start + chunk_size);
+    std::vector<IORequest> requests;
+    std::vector<DataFile *> request_files;
+    for (size_t i = start; i < end; i++)
+    {
+      char *buf = StampedCopy(pages[i].page_data,
+                              state->copies + i * PAGE_SIZE);
+      pages[i].page_data = buf;
+      off_t offset;
+      DataFile *file = PageLocation(pages[i].page_id, offset);
+      GrowFile(file, offset + PAGE_SIZE);
+      size_t size = PAGE_SIZE;
+      if (compression_)
+      {
+        char *image = state->images + i * PAGE_SIZE;
+        size = CompressPage(pages[i].page_data, image);
+        if (size < PAGE_SIZE)
+          buf = image;
+      }
+      // append to the previous write if the page lands right after it
+      if (write_coalescing_ && !requests.empty() && size == PAGE_SIZE)
+      {
+        IORequest &last = requests.back();
+        if (last.fd == file->fd && last.len % PAGE_SIZE == 0 &&
+            last.offset + static_cast<off_t>(last.len) == offset &&
+            last.len < WRITE_COALESCE_PAGES * PAGE_SIZE)
+        {
+          if (last.iovecs.empty())
+            last.iovecs.push_back({last.buf, last.len});
+          last.iovecs.push_back({buf, PAGE_SIZE});
+          last.len += PAGE_SIZE;
+          continue;
+        }
+      }
+      requests.emplace_back();
+      requests.back().fd = file->fd;
+      requests.back().is_write = true;
+      requests.back().offset = offset;
+      requests.back().buf = buf;
+      requests.back().len = size;
+      request_files.push_back(file);
+    }
+    for (size_t i = 0; i < requests.size(); i++)
+    {
+      DataFile *file = request_files[i];
+      off_t offset = requests[i].offset;
+      size_t size = requests[i].len;
+      size_t num_pages = std::max<size_t>(1, requests[i].iovecs.size());
+      requests[i].callback = [this, state, file, offset, size,
+                              num_pages](bool success) {
+        if (success && size < PAGE_SIZE)
+          PunchTail(file, offset, size);
+        AddUnsyncedBytes(size);
+        if (!success)
+          state->success = false;
+        if (state->remaining.fetch_sub(num_pages) == num_pages &&
+            state->callback)
+          state->callback(state->success);
+      };
+    }
+    if (checksum_mode_ == ChecksumMode::REPAIR)
+      DoubleWrite(&pages[start], end - start);
+    GetIOEngine()->Submit(requests);
   }
 }
 
+void DiskManager::WaitForAsyncIO()
+{
+  if (io_engine_ != nullptr)
+    io_engine_->Drain();
+}
+
 /**
  * Allocate new page (operations like create index/table)
- * For now just keep an increasing counter
+ * Without a hint the page comes from the mixed space: the lowest free page
+ * that is not in an extent owned by some table or index. This is where the
+ * first page of a new object goes.
+ * With a hint the page belongs to the same object as the hint page: it is
+ * taken from the object's extent (the one holding hint), or from a newly
+ * reserved extent if that one is full or the hint page is still in the mixed
+ * space. An object thus grows in runs of EXTENT_SIZE contiguous pages, even
+ * when several objects grow concurrently.
+ * The bitmap is written through before the page id is handed out, otherwise
+ * a page could be handed out twice after a restart.
  */
-page_id_t DiskManager::AllocatePage() { return next_page_id_++; }
+page_id_t DiskManager::AllocatePage(page_id_t hint)
+{
+  std::lock_guard<std::mutex> lock(alloc_latch_);
+  page_id_t page_id = INVALID_PAGE_ID;
+  if (hint < 0 || hint >= next_page_id_)
+  {
+    auto run = free_runs_.begin();
+    if (run != free_runs_.end())
+    {
+      page_id = run->first;
+      TakeFreeRange(run, page_id, 1);
+    }
+    else
+      page_id = next_page_id_++;
+  }
+  else
+  {
+    int extent = hint / EXTENT_SIZE;
+    if (IsExtentOwned(extent))
+      page_id = FindFreePageInExtent(extent, hint);
+    if (page_id == INVALID_PAGE_ID)
+      page_id = ReserveExtent(extent + 1) * EXTENT_SIZE;
+  }
+  SetAllocated(page_id, true);
+  WriteBitmap(page_id / PAGES_PER_BITMAP);
+  return page_id;
+}
 
 /**
  * Deallocate page (operations like drop index/table)
- * Need bitmap in header page for tracking pages
+ * The bitmap is only written back lazily: losing a deallocation in a crash
+ * leaks a page, but never hands out a live one.
+ * A page of an owned extent stays reserved for its object until the whole
+ * extent is free, then the extent goes back to the mixed space.
  */
-void DiskManager::DeallocatePage(__attribute__((unused)) page_id_t page_id)
+void DiskManager::DeallocatePage(page_id_t page_id)
 {
-  return;
+  std::lock_guard<std::mutex> lock(alloc_latch_);
+  if (page_id < 0 || page_id >= next_page_id_)
+    return;
+  if (!IsAllocated(page_id))
+  {
+    LOG_DEBUG("page %d deallocated twice", page_id);
+    return;
+  }
+  SetAllocated(page_id, false);
+
+  int extent = page_id / EXTENT_SIZE;
+  if (!IsExtentOwned(extent))
+  {
+    AddFreeRange(page_id, 1);
+    return;
+  }
+  page_id_t first = extent * EXTENT_SIZE;
+  for (page_id_t i = first; i < first + EXTENT_SIZE; i++)
+  {
+    if (IsAllocated(i))
+      return;
+  }
+  SetExtentOwned(extent, false);
+  AddFreeRange(first, EXTENT_SIZE);
 }
 
 /**
- * Private helper function to get disk file size
+ * Private helper function to find the free page of an owned extent to
+ * allocate next: the first one after hint, so an object that appends pages
+ * fills its extent sequentially, otherwise the closest one before hint
+ * @return: INVALID_PAGE_ID if the extent is full
  */
-int DiskManager::GetFileSize()
+page_id_t DiskManager::FindFreePageInExtent(int extent, page_id_t hint)
 {
-  struct stat stat_buf;
-  int rc = stat(file_name_.c_str(), &stat_buf);
-  return rc == 0 ? stat_buf.st_size : -1;
+  page_id_t first = extent * EXTENT_SIZE;
+  for (page_id_t i = hint + 1; i < first + EXTENT_SIZE; i++)
+  {
+    if (!IsAllocated(i))
+      return i;
+  }
+  for (page_id_t i = hint; i >= first; i--)
+  {
+    if (!IsAllocated(i))
+      return i;
+  }
+  return INVALID_PAGE_ID;
+}
+
+/**
+ * Private helper function to reserve a completely free extent for an object,
+ * preferably the given one so that consecutive extents of an object are
+ * contiguous too. If no free extent is left, one is cut at the high water
+ * mark, the pages skipped to align it go to the mixed space.
+ * @return: index of the reserved extent
+ */
+int DiskManager::ReserveExtent(int preferred)
+{
+  page_id_t first = INVALID_PAGE_ID;
+  auto run = free_runs_.upper_bound(preferred * EXTENT_SIZE);
+  if (run != free_runs_.begin() &&
+      std::prev(run)->first + std::prev(run)->second >=
+          (preferred + 1) * EXTENT_SIZE)
+  {
+    run = std::prev(run);
+    first = preferred * EXTENT_SIZE;
+  }
+  else
+  {
+    for (run = free_runs_.begin(); run != free_runs_.end(); ++run)
+    {
+      page_id_t aligned =
+          (run->first + EXTENT_SIZE - 1) / EXTENT_SIZE * EXTENT_SIZE;
+      if (aligned + EXTENT_SIZE <= run->first + run->second)
+      {
+        first = aligned;
+        break;
+      }
+    }
+  }
+
+  if (first != INVALID_PAGE_ID)
+    TakeFreeRange(run, first, EXTENT_SIZE);
+  else
+  {
+    first = (next_page_id_ + EXTENT_SIZE - 1) / EXTENT_SIZE * EXTENT_SIZE;
+    if (first > next_page_id_)
+      AddFreeRange(next_page_id_, first - next_page_id_);
+    next_page_id_ = first + EXTENT_SIZE;
+  }
+  SetExtentOwned(first / EXTENT_SIZE, true);
+  return first / EXTENT_SIZE;
+}
+
+/**
+ * Private helper function to remove [first, first + length) from the free
+ * run containing it
+ */
+void DiskManager::TakeFreeRange(std::map<page_id_t, page_id_t>::iterator run,
+                                page_id_t first, page_id_t length)
+{
+  page_id_t start = run->first;
+  page_id_t end = run->first + run->second;
+  free_runs_.erase(run);
+  if (start < first)
+    free_runs_[start] = first - start;
+  if (first + length < end)
+    free_runs_[first + length] = end - first - length;
+}
+
+/**
+ * Private helper function to add [first, first + length) to the free runs,
+ * merging with the neighbouring runs
+ */
+void DiskManager::AddFreeRange(page_id_t first, page_id_t length)
+{
+  auto next = free_runs_.find(first + length);
+  if (next != free_runs_.end())
+  {
+    length += next->second;
+    free_runs_.erase(next);
+  }
+  auto prev = free_runs_.lower_bound(first);
+  if (prev != free_runs_.begin())
+  {
+    --prev;
+    if (prev->first + prev->second == first)
+    {
+      first = prev->first;
+      length += prev->second;
+    }
+  }
+  free_runs_[first] = length;
+}
+
+/**
+ * Private helper function to read the bitmap pages of an existing database
+ * and rebuild the high water mark and the free runs from them
+ */
+void DiskManager::LoadBitmaps()
+{
+  // bitmap page k is in the (k / num_files)-th bitmap slot of file
+  // k % num_files
+  off_t group_size = static_cast<off_t>(PAGES_PER_BITMAP + 1) * PAGE_SIZE;
+  size_t num_bitmaps = 0;
+  for (size_t i = 0; i < files_.size(); i++)
+  {
+    size_t num_slots = (files_[i]->size + group_size - 1) / group_size;
+    if (num_slots > 0)
+      num_bitmaps = std::max(num_bitmaps, (num_slots - 1) * files_.size() + i + 1);
+  }
+  for (size_t i = 0; i < num_bitmaps; i++)
+  {
+    char *bitmap = AllocateAlignedPages(1);
+    memset(bitmap, 0, PAGE_SIZE);
+    bitmaps_.push_back(bitmap);
+    bitmap_dirty_.push_back(false);
+    off_t offset;
+    DataFile *file = BitmapLocation(i, offset);
+    PositionalRead(file->fd, bitmap, PAGE_SIZE, offset);
+    uint32_t magic = *reinterpret_cast<uint32_t *>(bitmap);
+    uint32_t *num_files =
+        reinterpret_cast<uint32_t *>(bitmap + BITMAP_NUM_FILES_OFFSET);
+    uint32_t *version =
+        reinterpret_cast<uint32_t *>(bitmap + BITMAP_VERSION_OFFSET);
+    std::string error;
+    // a bitmap page never written (a hole) means nothing allocated there
+    if (magic == 0)
+    {
+      *reinterpret_cast<uint32_t *>(bitmap) = BITMAP_MAGIC;
+      if (i == 0)
+      {
+        *num_files = files_.size();
+        *version = DISK_FORMAT_VERSION;
+      }
+    }
+    // e.g. a file of the original layout (pages back to back from offset 0,
+    // no checksum trailer), which cannot be converted in place
+    else if (magic != BITMAP_MAGIC ||
+             (i == 0 && *version != DISK_FORMAT_VERSION))
+      error = " has an unsupported format (expected version " +
+              std::to_string(DISK_FORMAT_VERSION) + ")";
+    else if (i == 0 && *num_files != files_.size())
+      error = " has no valid space map for " + std::to_string(files_.size()) +
+              " data files";
+    if (!error.empty())
+    {
+      for (auto b : bitmaps_)
+        free(b);
+      throw Exception("db file " + file_name_ + error);
+    }
+  }
+
+  page_id_t num_pages = num_bitmaps * PAGES_PER_BITMAP;
+  for (page_id_t page_id = 0; page_id < num_pages; page_id++)
+  {
+    if (page_id % EXTENT_SIZE == 0 && IsExtentOwned(page_id / EXTENT_SIZE))
+      next_page_id_ = page_id + EXTENT_SIZE;
+    else if (IsAllocated(page_id))
+      next_page_id_ = std::max(next_page_id_, page_id + 1);
+  }
+  // free pages of owned extents are not part of the mixed space
+  page_id_t run_start = INVALID_PAGE_ID;
+  for (page_id_t page_id = 0; page_id <= next_page_id_; page_id++)
+  {
+    bool is_free = page_id < next_page_id_ && !IsAllocated(page_id) &&
+                   !IsExtentOwned(page_id / EXTENT_SIZE);
+    if (is_free && run_start == INVALID_PAGE_ID)
+      run_start = page_id;
+    else if (!is_free && run_start != INVALID_PAGE_ID)
+    {
+      free_runs_[run_start] = page_id - run_start;
+      run_start = INVALID_PAGE_ID;
+    }
+  }
+}
+
+/**
+ * Private helper functions to access the bitmaps: a bitmap page holds a
+ * magic number (bitmap page 0 then the number of data files and the format
+ * version), one owned bit per extent at EXTENT_MAP_OFFSET and one
+ * allocated bit per page after BITMAP_HEADER_SIZE
+ */
+bool DiskManager::IsPageAllocated(page_id_t page_id)
+{
+  std::lock_guard<std::mutex> lock(alloc_latch_);
+  return page_id >= 0 && page_id < next_page_id_ && IsAllocated(page_id);
+}
+
+bool DiskManager::IsAllocated(page_id_t page_id)
+{
+  size_t index = page_id / PAGES_PER_BITMAP;
+  if (index >= bitmaps_.size())
+    return false;
+  const char *bits = bitmaps_[index] + BITMAP_HEADER_SIZE;
+  int bit = page_id % PAGES_PER_BITMAP;
+  return bits[bit / 8] & (1 << (bit % 8));
+}
+
+bool DiskManager::IsExtentOwned(int extent)
+{
+  size_t index = extent / EXTENTS_PER_BITMAP;
+  if (index >= bitmaps_.size())
+    return false;
+  const char *bits = bitmaps_[index] + EXTENT_MAP_OFFSET;
+  int bit = extent % EXTENTS_PER_BITMAP;
+  return bits[bit / 8] & (1 << (bit % 8));
+}
+
+void DiskManager::SetAllocated(page_id_t page_id, bool allocated)
+{
+  char *bits = GetBitmap(page_id / PAGES_PER_BITMAP) + BITMAP_HEADER_SIZE;
+  int bit = page_id % PAGES_PER_BITMAP;
+  if (allocated)
+    bits[bit / 8] |= 1 << (bit % 8);
+  else
+    bits[bit / 8] &= ~(1 << (bit % 8));
+}
+
+void DiskManager::SetExtentOwned(int extent, bool owned)
+{
+  char *bits = GetBitmap(extent / EXTENTS_PER_BITMAP) + EXTENT_MAP_OFFSET;
+  int bit = extent % EXTENTS_PER_BITMAP;
+  if (owned)
+    bits[bit / 8] |= 1 << (bit % 8);
+  else
+    bits[bit / 8] &= ~(1 << (bit % 8));
+}
+
+/**
+ * Private helper function to get a bitmap page for modification, creating
+ * it (and the ones before it) if needed
+ */
+char *DiskManager::GetBitmap(size_t index)
+{
+  while (bitmaps_.size() <= index)
+  {
+    char *bitmap = AllocateAlignedPages(1);
+    memset(bitmap, 0, PAGE_SIZE);
+    *reinterpret_cast<uint32_t *>(bitmap) = BITMAP_MAGIC;
+    if (bitmaps_.empty())
+    {
+      *reinterpret_cast<uint32_t *>(bitmap + BITMAP_NUM_FILES_OFFSET) =
+          files_.size();
+      *reinterpret_cast<uint32_t *>(bitmap + BITMAP_VERSION_OFFSET) =
+          DISK_FORMAT_VERSION;
+    }
+    bitmaps_.push_back(bitmap);
+    bitmap_dirty_.push_back(true);
+  }
+  bitmap_dirty_[index] = true;
+  return bitmaps_[index];
+}
+
+void DiskManager::WriteBitmap(size_t index)
+{
+  StampChecksum(bitmaps_[index]);
+  off_t offset;
+  DataFile *file = BitmapLocation(index, offset);
+  GrowFile(file, offset + PAGE_SIZE);
+  if (PositionalWrite(file->fd, bitmaps_[index], PAGE_SIZE, offset) < 0)
+  {
+    LOG_DEBUG("I/O error while writing bitmap page");
+    return;
+  }
+  AddUnsyncedBytes(PAGE_SIZE);
+  bitmap_dirty_[index] = false;
+}
+
+/**
+ * Private helper function to create the asynchronous I/O engine on first use,
+ * so that a disk manager only used synchronously starts no threads
+ */
+AsyncIOEngine *DiskManager::GetIOEngine()
+{
+  std::call_once(io_engine_init_, [this]() {
+    io_engine_ = AsyncIOEngine::Create(IO_QUEUE_DEPTH);
+    LOG_DEBUG("asynchronous I/O uses %s", io_engine_->GetName());
+  });
+  return io_engine_;
+}
+
+/**
+ * Set by how many pages the file is preallocated when a write goes past the
+ * preallocated space, 0 lets the file grow one write at a time
+ */
+void DiskManager::SetGrowthStep(size_t num_pages)
+{
+  std::lock_guard<std::mutex> lock(growth_latch_);
+  growth_step_ = static_cast<off_t>(num_pages) * PAGE_SIZE;
+}
+
+/**
+ * Private helper function called before writing up to end: record the new
+ * logical file size, and if end lies beyond the preallocated space reserve
+ * the next growth step with fallocate. FALLOC_FL_KEEP_SIZE leaves st_size
+ * alone, so the size of the file stays the logical one across restarts, while
+ * the blocks of the appended pages are already reserved contiguously.
+ */
+void DiskManager::GrowFile(DataFile *file, off_t end)
+{
+  off_t size = file->size;
+  while (size < end && !file->size.compare_exchange_weak(size, end))
+    ;
+  if (end <= file->preallocated_size)
+    return;
+
+  std::lock_guard<std::mutex> lock(growth_latch_);
+  if (end <= file->preallocated_size || growth_step_ == 0)
+    return;
+  off_t new_size = (end + growth_step_ - 1) / growth_step_ * growth_step_;
+  // a write far past the end only reserves the step around it, not the gap
+  off_t start =
+      std::max<off_t>(file->preallocated_size, new_size - growth_step_);
+  if (fallocate(file->fd, FALLOC_FL_KEEP_SIZE, start, new_size - start) < 0)
+  {
+    // e.g. not supported by the file system, stop trying
+    LOG_DEBUG("fallocate failed: %s", strerror(errno));
+    growth_step_ = 0;
+    return;
+  }
+  file->preallocated_size = new_size;
+}
+
+/**
+ * Set the durability level, for GROUP_COMMIT also how often the group is
+ * committed: every group_interval, or as soon as group_bytes have been
+ * written since the last fdatasync
+ */
+void DiskManager::SetDurability(DurabilityLevel level,
+                                std::chrono::milliseconds group_interval,
+                                size_t group_bytes)
+{
+  StopGroupSyncer();
+  std::lock_guard<std::mutex> lock(sync_latch_);
+  durability_ = level;
+  group_interval_ = group_interval;
+  group_bytes_ = group_bytes;
+  if (level == DurabilityLevel::GROUP_COMMIT)
+  {
+    group_shutdown_ = false;
+    group_syncer_ = std::thread(&DiskManager::GroupSyncLoop, this);
+  }
+}
+
+/**
+ * Commit point: return once every write completed before the call is on
+ * stable storage. Writes of many callers are covered by one fdatasync: who
+ * arrives while one is running waits for it and then shares the next one.
+ * With GROUP_COMMIT only the background thread syncs, callers just wait.
+ */
+void DiskManager::Sync()
+{
+  std::unique_lock<std::mutex> lock(sync_latch_);
+  if (durability_ == DurabilityLevel::NONE)
+    return;
+  // a sync already running may have started before our writes completed
+  uint64_t ticket = syncs_started_ + 1;
+  sync_waiters_++;
+  if (durability_ == DurabilityLevel::GROUP_COMMIT)
+  {
+    sync_cv_.wait(lock, [&]() {
+      return syncs_done_ >= ticket ||
+             durability_ != DurabilityLevel::GROUP_COMMIT;
+    });
+  }
+  while (syncs_done_ < ticket)
+  {
+    if (!sync_running_)
+      RunSync(lock);
+    else
+      sync_cv_.wait(lock);
+  }
+  sync_waiters_--;
+}
+
+uint64_t DiskManager::GetSyncCount()
+{
+  std::lock_guard<std::mutex> lock(sync_latch_);
+  return syncs_done_;
+}
+
+/**
+ * Private helper function to issue one fdatasync, caller must hold
+ * sync_latch_ (it is released during the fdatasync) and no sync may be
+ * running
+ */
+void DiskManager::RunSync(std::unique_lock<std::mutex> &lock)
+{
+  sync_running_ = true;
+  uint64_t sync_id = ++syncs_started_;
+  unsynced_bytes_ = 0;
+  lock.unlock();
+  SyncFiles();
+  lock.lock();
+  syncs_done_ = sync_id;
+  sync_running_ = false;
+  sync_cv_.notify_all();
+}
+
+/**
+ * Private helper function to account written bytes, wakes the group syncer
+ * early when enough have been written
+ */
+void DiskManager::AddUnsyncedBytes(size_t bytes)
+{
+  size_t unsynced = unsynced_bytes_ += bytes;
+  if (unsynced >= group_bytes_ && unsynced - bytes < group_bytes_)
+    group_cv_.notify_one();
+}
+
+/**
+ * Background thread of GROUP_COMMIT: commit the group once per interval if
+ * anything was written or somebody waits, earlier if group_bytes_ have been
+ * written
+ */
+void DiskManager::GroupSyncLoop()
+{
+  std::unique_lock<std::mutex> lock(sync_latch_);
+  while (!group_shutdown_)
+  {
+    group_cv_.wait_for(lock, group_interval_, [this]() {
+      return group_shutdown_ || unsynced_bytes_ >= group_bytes_;
+    });
+    if (unsynced_bytes_ > 0 || sync_waiters_ > 0)
+      RunSync(lock);
+  }
+}
+
+void DiskManager::StopGroupSyncer()
+{
+  {
+    std::lock_guard<std::mutex> lock(sync_latch_);
+    group_shutdown_ = true;
+    // pending group commit waiters sync themselves from now on
+    if (durability_ == DurabilityLevel::GROUP_COMMIT)
+      durability_ = DurabilityLevel::COMMIT;
+  }
+  group_cv_.notify_all();
+  sync_cv_.notify_all();
+  if (group_syncer_.joinable())
+    group_syncer_.join();
+}
+
+/**
+ * Set the checksum mode. Switching to REPAIR opens the double write file and
+ * first restores every page whose in place write was torn by a crash.
+ */
+void DiskManager::SetChecksumMode(ChecksumMode mode)
+{
+  if (mode == ChecksumMode::REPAIR && dblwr_fd_ < 0)
+  {
+    std::string dblwr_file = file_name_ + ".dblwr";
+    dblwr_fd_ = open(dblwr_file.c_str(), O_RDWR | O_CREAT, 0644);
+    if (dblwr_fd_ < 0)
+    {
+      LOG_DEBUG("can't open %s: %s", dblwr_file.c_str(), strerror(errno));
+      mode = ChecksumMode::VERIFY;
+    }
+    else
+      RecoverTornPages();
+  }
+  checksum_mode_ = mode;
+}
+
+/**
+ * Private helper function to copy pages to the double write file and make
+ * them durable there before they are written in place, so that a crash can
+ * tear the in place write but not both copies. Slots are filled round robin;
+ * before they wrap around, the in place writes of their previous contents
+ * must be durable.
+ */
+void DiskManager::DoubleWrite(const PageWrite *pages, size_t count)
+{
+  if (dblwr_next_slot_ + count > DOUBLE_WRITE_SLOTS)
+  {
+    WaitForAsyncIO();
+    SyncFiles();
+    dblwr_next_slot_ = 0;
+  }
+  std::vector<DoubleWriteHeader> headers(count);
+  std::vector<struct iovec> iov(2 * count);
+  for (size_t i = 0; i < count; i++)
+  {
+    headers[i].seq = ++dblwr_seq_;
+    headers[i].page_id = pages[i].page_id;
+    headers[i].reserved = 0;
+    iov[2 * i].iov_base = &headers[i];
+    iov[2 * i].iov_len = sizeof(DoubleWriteHeader);
+    iov[2 * i + 1].iov_base = const_cast<char *>(pages[i].page_data);
+    iov[2 * i + 1].iov_len = PAGE_SIZE;
+  }
+  ssize_t len = count * DOUBLE_WRITE_SLOT_SIZE;
+  if (pwritev(dblwr_fd_, iov.data(), iov.size(),
+              dblwr_next_slot_ * DOUBLE_WRITE_SLOT_SIZE) != len ||
+      fdatasync(dblwr_fd_) < 0)
+  {
+    LOG_DEBUG("I/O error while writing double write file");
+  }
+  dblwr_next_slot_ += count;
+}
+
+/**
+ * Private helper function for a page read with a bad checksum: in REPAIR mode
+ * restore it from the double write file and write it back in place, so the
+ * next read finds it intact
+ */
+bool DiskManager::RecoverPage(page_id_t page_id, char *page_data)
+{
+  if (checksum_mode_ != ChecksumMode::REPAIR ||
+      !ReadDoubleWriteCopy(page_id, page_data))
+  {
+    LOG_DEBUG("checksum mismatch on page %d", page_id);
+    return false;
+  }
+  LOG_DEBUG("page %d restored from double write file", page_id);
+  WriteInPlace(page_id, page_data);
+  return true;
+}
+
+/**
+ * Private helper function to get the newest intact copy of a page from the
+ * double write file. It runs without dblwr_latch_ (a writer holding it may be
+ * waiting for this very read), a slot overwritten meanwhile fails its
+ * checksum.
+ */
+bool DiskManager::ReadDoubleWriteCopy(page_id_t page_id, char *page_data)
+{
+  std::vector<char> slots(DOUBLE_WRITE_SLOTS * DOUBLE_WRITE_SLOT_SIZE, 0);
+  if (PositionalRead(dblwr_fd_, slots.data(), slots.size(), 0) < 0)
+    return false;
+  const char *copy = nullptr;
+  uint64_t copy_seq = 0;
+  for (size_t i = 0; i < DOUBLE_WRITE_SLOTS; i++)
+  {
+    DoubleWriteHeader header;
+    memcpy(&header, &slots[i * DOUBLE_WRITE_SLOT_SIZE], sizeof(header));
+    const char *image = &slots[i * DOUBLE_WRITE_SLOT_SIZE] + sizeof(header);
+    if (header.seq > copy_seq && header.page_id == page_id &&
+        HasValidChecksum(image))
+    {
+      copy = image;
+      copy_seq = header.seq;
+    }
+  }
+  if (copy == nullptr)
+    return false;
+  memcpy(page_data, copy, PAGE_SIZE);
+  return true;
+}
+
+/**
+ * Private helper function run when the double write file is opened: every
+ * page with an intact copy there whose in place image is torn gets the
+ * newest copy back. Also continues the sequence numbers of the file.
+ */
+void DiskManager::RecoverTornPages()
+{
+  std::vector<char> slots(DOUBLE_WRITE_SLOTS * DOUBLE_WRITE_SLOT_SIZE, 0);
+  PositionalRead(dblwr_fd_, slots.data(), slots.size(), 0);
+  // page id -> newest intact copy (sequence number, image)
+  std::unordered_map<page_id_t, std::pair<uint64_t, const char *>> copies;
+  for (size_t i = 0; i < DOUBLE_WRITE_SLOTS; i++)
+  {
+    DoubleWriteHeader header;
+    memcpy(&header, &slots[i * DOUBLE_WRITE_SLOT_SIZE], sizeof(header));
+    const char *image = &slots[i * DOUBLE_WRITE_SLOT_SIZE] + sizeof(header);
+    dblwr_seq_ = std::max(dblwr_seq_, header.seq);
+    if (header.seq == 0 || !HasValidChecksum(image))
+      continue;
+    auto &copy = copies[header.page_id];
+    if (header.seq > copy.first)
+      copy = std::make_pair(header.seq, image);
+  }
+
+  char *page = AllocateAlignedPages(1);
+  size_t restored = 0;
+  for (auto &copy : copies)
+  {
+    memset(page, 0, PAGE_SIZE);
+    off_t offset;
+    DataFile *file = PageLocation(copy.first, offset);
+    if (offset < file->size)
+      PositionalRead(file->fd, page, PAGE_SIZE, offset);
+    if (!DecompressPage(page) || !HasValidChecksum(page))
+    {
+      WriteInPlace(copy.first, copy.second.second);
+      restored++;
+    }
+  }
+  free(page);
+  if (restored > 0)
+  {
+    SyncFiles();
+    LOG_DEBUG("restored %zu torn pages from double write file", restored);
+  }
+}
+
+/**
+ * Private helper function to fdatasync every data file
+ */
+void DiskManager::SyncFiles()
+{
+  for (auto file : files_)
+  {
+    if (fdatasync(file->fd) < 0)
+    {
+      LOG_DEBUG("fdatasync of %s failed: %s", file->name.c_str(),
+                strerror(errno));
+    }
+  }
 }
 
 } // namespace cmudb
@@ -0,0 +1,435 @@
+/**
+ * io_engine.cpp
+ */
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <linux/io_uring.h>
+#include <new>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "common/config.h"
+#include "common/logger.h"
+#include "disk/io_engine.h"
+
+namespace cmudb
+{
+
+ssize_t PositionalRead(int fd, char *buf, size_t len, off_t offset)
+{
+  size_t done = 0;
+  while (done < len)
+  {
+    ssize_t rc = pread(fd, buf + done, len - done, offset + done);
+    if (rc < 0 && errno == EINTR)
+      continue;
+    if (rc < 0)
+      return -1;
+    // end of file
+    if (rc == 0)
+      break;
+    done += rc;
+  }
+  return done;
+}
+
+ssize_t PositionalWrite(int fd, const char *buf, size_t len, off_t offset)
+{
+  size_t done = 0;
+  while (done < len)
+  {
+    ssize_t rc = pwrite(fd, buf + done, len - done, offset + done);
+    if (rc < 0 && errno == EINTR)
+      continue;
+    if (rc <= 0)
+      return -1;
+    done += rc;
+  }
+  return done;
+}
+
+ssize_t PositionalWriteVector(int fd, const struct iovec *iov, int iovcnt,
+                              off_t offset)
+{
+  // a short pwritev leaves the rest in a copy of the vector
+  std::vector<struct iovec> rest(iov, iov + iovcnt);
+  size_t first = 0;
+  size_t done = 0;
+  while (first < rest.size())
+  {
+    ssize_t rc = pwritev(fd, &rest[first], rest.size() - first, offset + done);
+    if (rc < 0 && errno == EINTR)
+      continue;
+    if (rc <= 0)
+      return -1;
+    done += rc;
+    for (size_t skip = rc; skip > 0;)
+    {
+      if (skip >= rest[first].iov_len)
+      {
+        skip -= rest[first].iov_len;
+        first++;
+      }
+      else
+      {
+        rest[first].iov_base = static_cast<char *>(rest[first].iov_base) + skip;
+        rest[first].iov_len -= skip;
+        skip = 0;
+      }
+    }
+  }
+  return done;
+}
+
+char *AllocateAlignedPages(size_t num_pages)
+{
+  void *buf = nullptr;
+  if (posix_memalign(&buf, PAGE_SIZE, num_pages * PAGE_SIZE) != 0)
+    throw std::bad_alloc();
+  return reinterpret_cast<char *>(buf);
+}
+
+/*****************************************************************************
+ * AsyncIOEngine
+ *****************************************************************************/
+AsyncIOEngine *AsyncIOEngine::Create(size_t queue_depth, bool use_io_uring)
+{
+  if (use_io_uring)
+  {
+    IOUringEngine *engine = new IOUringEngine(queue_depth);
+    if (engine->IsValid())
+      return engine;
+    delete engine;
+    LOG_DEBUG("io_uring not available, fall back to thread pool");
+  }
+  return new ThreadPoolIOEngine(queue_depth, IO_WORKER_THREADS);
+}
+
+void AsyncIOEngine::Drain()
+{
+  std::unique_lock<std::mutex> lock(latch_);
+  slot_cv_.wait(lock, [this]() { return in_flight_ == 0; });
+}
+
+void AsyncIOEngine::AcquireSlot(std::unique_lock<std::mutex> &lock,
+                                size_t queue_depth)
+{
+  slot_cv_.wait(lock, [&]() { return in_flight_ < queue_depth; });
+  in_flight_++;
+}
+
+/*
+ * A short read means end of file (or, for io_uring, a transfer the kernel
+ * split): read the rest synchronously and zero-fill whatever lies past the
+ * end of file, same as DiskManager::ReadPage. A short write is finished
+ * synchronously.
+ */
+void AsyncIOEngine::Complete(IORequest *request, ssize_t result)
+{
+  bool success = result >= 0;
+  if (success && static_cast<size_t>(result) < request->len &&
+      !request->iovecs.empty())
+  {
+    // the buffers past the ones written
+    std::vector<struct iovec> rest;
+    size_t skip = result;
+    for (const struct iovec &iov : request->iovecs)
+    {
+      if (skip >= iov.iov_len)
+      {
+        skip -= iov.iov_len;
+        continue;
+      }
+      rest.push_back({static_cast<char *>(iov.iov_base) + skip,
+                      iov.iov_len - skip});
+      skip = 0;
+    }
+    size_t rest_len = request->len - result;
+    success = PositionalWriteVector(request->fd, rest.data(), rest.size(),
+                                    request->offset + result) ==
+              static_cast<ssize_t>(rest_len);
+  }
+  else if (success && static_cast<size_t>(result) < request->len)
+  {
+    char *rest_buf = request->buf + result;
+    size_t rest_len = request->len - result;
+    off_t rest_offset = request->offset + result;
+    if (request->is_write)
+    {
+      success = PositionalWrite(request->fd, rest_buf, rest_len, rest_offset) ==
+                static_cast<ssize_t>(rest_len);
+    }
+    else
+    {
+      ssize_t rc = PositionalRead(request->fd, rest_buf, rest_len, rest_offset);
+      if (rc < 0)
+        success = false;
+      else
+        memset(rest_buf + rc, 0, rest_len - rc);
+    }
+  }
+  if (!success)
+  {
+    LOG_DEBUG("I/O error in asynchronous %s",
+              request->is_write ? "write" : "read");
+  }
+  if (request->callback)
+    request->callback(success);
+  delete request;
+
+  std::lock_guard<std::mutex> lock(latch_);
+  in_flight_--;
+  slot_cv_.notify_all();
+}
+
+/*****************************************************************************
+ * IOUringEngine
+ *****************************************************************************/
+IOUringEngine::IOUringEngine(size_t queue_depth)
+    : ring_fd_(-1), queue_depth_(queue_depth),
+      sq_ring_(MAP_FAILED), sqes_(nullptr), cq_ring_(MAP_FAILED)
+{
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  int ring_fd = syscall(__NR_io_uring_setup, queue_depth, &params);
+  if (ring_fd < 0)
+    return;
+
+  sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cq_ring_size_ =
+      params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+  if (single_mmap)
+  {
+    sq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    cq_ring_size_ = sq_ring_size_;
+  }
+  sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+  if (sq_ring_ == MAP_FAILED)
+  {
+    close(ring_fd);
+    return;
+  }
+  if (single_mmap)
+    cq_ring_ = sq_ring_;
+  else
+    cq_ring_ = mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+  sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+  void *sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+  if (cq_ring_ == MAP_FAILED || sqes == MAP_FAILED)
+  {
+    if (cq_ring_ != MAP_FAILED && !single_mmap)
+      munmap(cq_ring_, cq_ring_size_);
+    munmap(sq_ring_, sq_ring_size_);
+    sq_ring_ = cq_ring_ = MAP_FAILED;
+    close(ring_fd);
+    return;
+  }
+  sqes_ = reinterpret_cast<struct io_uring_sqe *>(sqes);
+
+  char *sq = reinterpret_cast<char *>(sq_ring_);
+  sq_tail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+  sq_mask_ = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+  sq_array_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+  // sqe slot i is always described by array entry i
+  for (unsigned i = 0; i < params.sq_entries; i++)
+    sq_array_[i] = i;
+
+  char *cq = reinterpret_cast<char *>(cq_ring_);
+  cq_head_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+  cq_tail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+  cq_mask_ = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+  cqes_ = reinterpret_cast<struct io_uring_cqe *>(cq + params.cq_off.cqes);
+
+  // never have more requests in flight than submission slots, so neither
+  // the submission nor the completion ring can overflow
+  queue_depth_ = std::min<size_t>(queue_depth_, params.sq_entries);
+  ring_fd_ = ring_fd;
+  reaper_ = std::thread(&IOUringEngine::ReapCompletions, this);
+}
+
+IOUringEngine::~IOUringEngine()
+{
+  if (!IsValid())
+    return;
+  Drain();
+  {
+    // a nop with user_data 0 tells the reaper to exit
+    std::lock_guard<std::mutex> lock(latch_);
+    PushSqe(nullptr);
+    Enter(1, 0, 0);
+  }
+  reaper_.join();
+  munmap(sqes_, sqes_size_);
+  if (cq_ring_ != sq_ring_)
+    munmap(cq_ring_, cq_ring_size_);
+  munmap(sq_ring_, sq_ring_size_);
+  close(ring_fd_);
+}
+
+void IOUringEngine::Enter(unsigned to_submit, unsigned min_complete,
+                          unsigned flags)
+{
+  while (true)
+  {
+    int rc = syscall(__NR_io_uring_enter, ring_fd_, to_submit, min_complete,
+                     flags, nullptr, 0);
+    if (rc < 0)
+    {
+      if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+        continue;
+      LOG_DEBUG("io_uring_enter failed: %s", strerror(errno));
+      return;
+    }
+    if (static_cast<unsigned>(rc) >= to_submit)
+      return;
+    // the kernel consumed only part of the batch, push the rest
+    to_submit -= rc;
+  }
+}
+
+/*
+ * Fill the next submission queue entry, caller must hold latch_. A null
+ * request queues the shutdown nop.
+ */
+void IOUringEngine::PushSqe(IORequest *request)
+{
+  unsigned tail = *sq_tail_;
+  struct io_uring_sqe *sqe = &sqes_[tail & *sq_mask_];
+  memset(sqe, 0, sizeof(*sqe));
+  if (request == nullptr)
+  {
+    sqe->opcode = IORING_OP_NOP;
+  }
+  else
+  {
+    // readv/writev are available since the first io_uring kernel (5.1)
+    sqe->opcode = request->is_write ? IORING_OP_WRITEV : IORING_OP_READV;
+    sqe->fd = request->fd;
+    sqe->off = request->offset;
+    if (request->iovecs.empty())
+    {
+      request->iov.iov_base = request->buf;
+      request->iov.iov_len = request->len;
+      sqe->addr = reinterpret_cast<uint64_t>(&request->iov);
+      sqe->len = 1;
+    }
+    else
+    {
+      sqe->addr = reinterpret_cast<uint64_t>(request->iovecs.data());
+      sqe->len = request->iovecs.size();
+    }
+  }
+  sqe->user_data = reinterpret_cast<uint64_t>(request);
+  // publish the entry before the new tail
+  __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+}
+
+void IOUringEngine::Submit(std::vector<IORequest> &requests)
+{
+  std::unique_lock<std::mutex> lock(latch_);
+  unsigned pending = 0;
+  for (auto &request : requests)
+  {
+    if (in_flight_ >= queue_depth_ && pending > 0)
+    {
+      // the queue is full of our own entries, hand them to the kernel
+      // before waiting for one of them to complete
+      Enter(pending, 0, 0);
+      pending = 0;
+    }
+    AcquireSlot(lock, queue_depth_);
+    PushSqe(new IORequest(request));
+    pending++;
+  }
+  if (pending > 0)
+    Enter(pending, 0, 0);
+}
+
+void IOUringEngine::ReapCompletions()
+{
+  while (true)
+  {
+    unsigned head = *cq_head_;
+    unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+    if (head == tail)
+    {
+      Enter(0, 1, IORING_ENTER_GETEVENTS);
+      continue;
+    }
+    struct io_uring_cqe cqe = cqes_[head & *cq_mask_];
+    __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+
+    IORequest *request = reinterpret_cast<IORequest *>(cqe.user_data);
+    if (request == nullptr)
+      return;
+    Complete(request, cqe.res < 0 ? -1 : cqe.res);
+  }
+}
+
+/*****************************************************************************
+ * ThreadPoolIOEngine
+ *****************************************************************************/
+ThreadPoolIOEngine::ThreadPoolIOEngine(size_t queue_depth,
+                                       size_t num_workers)
+    : queue_depth_(queue_depth), shutdown_(false)
+{
+  for (size_t i = 0; i < num_workers; i++)
+    workers_.push_back(std::thread(&ThreadPoolIOEngine::WorkerLoop, this));
+}
+
+ThreadPoolIOEngine::~ThreadPoolIOEngine()
+{
+  Drain();
+  {
+    std::lock_guard<std::mutex> lock(latch_);
+    shutdown_ = true;
+  }
+  queue_cv_.notify_all();
+  for (auto &worker : workers_)
+    worker.join();
+}
+
+void ThreadPoolIOEngine::Submit(std::vector<IORequest> &requests)
+{
+  std::unique_lock<std::mutex> lock(latch_);
+  for (auto &request : requests)
+  {
+    AcquireSlot(lock, queue_depth_);
+    queue_.push_back(new IORequest(request));
+    queue_cv_.notify_one();
+  }
+}
+
+void ThreadPoolIOEngine::WorkerLoop()
+{
+  while (true)
+  {
+    IORequest *request;
+    {
+      std::unique_lock<std::mutex> lock(latch_);
+      queue_cv_.wait(lock, [this]() { return shutdown_ || !queue_.empty(); });
+      if (queue_.empty())
+        return;
+      request = queue_.front();
+      queue_.pop_front();
+    }
+    ssize_t rc;
+    if (!request->iovecs.empty())
+      rc = PositionalWriteVector(request->fd, request->iovecs.data(),
+                                 request->iovecs.size(), request->offset);
+    else if (request->is_write)
+      rc = PositionalWrite(request->fd, request->buf, request->len, request->offset);
+    else
+      rc = PositionalRead(request->fd, request->buf, request->len, request->offset);
+    Complete(request, rc);
+  }
+}
+
+} // namespace cmudb
@@ -0,0 +1,67 @@
+/**
+ * buffer_access_strategy.h
+ *
+ * Buffer access strategy of a bulk operation (sequential scan, bulk insert),
+ * in the style of PostgreSQL's. The operation passes it to the buffer pool
+ * manager, which loads its pages into a small ring of frames recycled by the
+ * operation itself, so it cannot take over the buffer pool: once the ring is
+ * full, the frame of the page loaded ring_size misses ago is reused (written
+ * back first if dirty) as long as that page is still there and unpinned.
+ * Pages already in the pool are used where they are.
+ *
+ * As a frame only ever holds pages of its own shard of the pool, the ring is
+ * split into one ring per shard, sized on first use to share ring_size
+ * frames among the shards (at least one each).
+ *
+ * A strategy is owned by one operation and must not be shared by threads.
+ */
+
+#pragma once
+
+#include <cstdlib>
+#include <vector>
+
+#include "common/config.h"
+#include "page/page.h"
+
+namespace cmudb
+{
+
+class BufferAccessStrategy
+{
+  friend class BufferPoolManager;
+
+public:
+  // a ring_size of 0 is taken as 1
+  explicit BufferAccessStrategy(size_t ring_size = SCAN_RING_SIZE)
+      : ring_size_(ring_size > 0 ? ring_size : 1)
+  {
+  }
+
+  inline size_t GetRingSize() const { return ring_size_; }
+
+private:
+  struct RingSlot
+  {
+    Page *frame = nullptr;
+    // the page loaded into the frame, the frame is only reused if it still
+    // holds it
+    page_id_t page_id = INVALID_PAGE_ID;
+  };
+
+  // ring of the frames of one shard
+  struct Ring
+  {
+    explicit Ring(size_t size) : slots(size), current(0) {}
+
+    std::vector<RingSlot> slots;
+    // slot of the last page loaded
+    size_t current;
+  };
+
+  size_t ring_size_;
+  // one per shard of the pool, empty until first used
+  std::vector<Ring> rings_;
+};
+
+} // namespace cmudb
@@ -4,16 +4,84 @@
  * Functionality: The simplified Buffer Manager interface allows a client to
  * new/delete pages on disk, to read a disk page into the buffer pool and pin
  * it, also to unpin a page in the buffer pool.
+ *
+ * With direct_io the db file is opened with O_DIRECT, so pages are cached
+ * here only instead of also in the kernel page cache. Given several db files,
+ * the pages are striped over them (see DiskManager).
+ *
+ * The pool is partitioned into shards, each with its own latch, page table,
+ * replacer and free list; a page always lives in the shard its id hashes to.
+ * Threads working on different pages thus rarely wait for each other. By
+ * default a pool gets up to BUFFER_POOL_SHARDS shards of at least
+ * MIN_SHARD_FRAMES frames.
+ *
+ * The replacement policy (LRU, CLOCK, CLOCK-Pro or the scan resistant 2Q) is
+ * chosen at construction, every shard gets its own replacer over its frames.
+ * A sequential scan or bulk insert can also pass a BufferAccessStrategy to
+ * keep its pages in a small ring of frames (see buffer/buffer_access_strategy.h).
+ *
+ * Disk I/O is done with the shard latch released, so a slow read or write
+ * back does not hold up the hits of other threads. A frame under I/O is
+ * marked io_pending_ and already mapped to the page coming in: threads
+ * fetching that page wait for the read in flight rather than issuing their
+ * own.
+ *
+ * Hits and unpins take no latch at all: the page table is read latch free
+ * (see buffer/page_table.h) and the frame is pinned with an atomic
+ * increment, then checked to still hold the page. A frame is reassigned only
+ * by whoever swaps its pin count from 0 to PIN_EXCLUSIVE, so a hit either
+ * pins it first or sees the flag and falls back to the latched path. Pinned
+ * frames are not taken out of the replacer (an unpin to zero inserts the
+ * frame again, which counts as a reference); victims found pinned are
+ * dropped from it until their next unpin.
+ *
+ * PeekPage goes further for optimistic readers (see index/b_plus_tree.h): it
+ * neither pins nor latches, and hands out the version of the page latch
+ * instead, to be validated after reading. Claiming a frame bumps that
+ * version, so a read that raced with the frame being reassigned fails
+ * validation. Peeks are not counted as hits and do not reference the frame
+ * in the replacer.
+ *
+ * An optional background writer keeps the next victims of every replacer
+ * clean, so a miss rarely has to write a dirty page back first, and takes a
+ * checkpoint periodically. A checkpoint writes the dirty pages in page id
+ * order, latching one shard at a time and only to copy pages out: it is
+ * fuzzy, the pages dirtied meanwhile are left for the next one.
+ *
+ * The pool can be resized online, between its initial size and max_pool_size
+ * frames (the memory budget, by default the initial size): the page
+ * metadata, page tables and address space of max_pool_size frames are set up
+ * at construction, frames beyond the current size are retired and hold no
+ * memory. Shrinking retires free frames first, then evicts unpinned pages
+ * (dirty ones are written back) and gives their memory back to the system;
+ * pinned pages are never evicted. Growing puts retired frames back on the
+ * free lists. The number of shards is fixed at construction.
+ *
+ * Frames are mapped on huge page boundaries and by default backed by
+ * transparent huge pages (see buffer/frame_memory.h). With numa_local, the
+ * frames of each shard start on a huge page of their own and are bound to
+ * a NUMA node, shards going round robin over the nodes.
  */
 
 #pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <list>
 #include <mutex>
 #include <memory>
+#include <string>
+#include <thread>
+#include <vector>
 
+#include "buffer/buffer_access_strategy.h"
+#include "buffer/clock_pro_replacer.h"
+#include "buffer/clock_replacer.h"
+#include "buffer/frame_memory.h"
 #include "buffer/lru_replacer.h"
+#include "buffer/page_table.h"
+#include "buffer/two_queue_replacer.h"
 #include "disk/disk_manager.h"
-#include "hash/extendible_hash.h"
 #include "page/page.h"
 
 namespace cmudb
@@ -21,11 +89,27 @@ namespace cmudb
 class BufferPoolManager
 {
 public:
-  BufferPoolManager(size_t pool_size, const std::string &db_file);
+  // num_shards 0 picks the number of shards from the pool size,
+  // max_pool_size (at least pool_size) bounds Resize
+  BufferPoolManager(size_t pool_size, const std::string &db_file,
+                    bool direct_io = false, size_t num_shards = 0,
+                    ReplacerType replacer_type = ReplacerType::LRU,
+                    size_t max_pool_size = 0,
+                    HugePages huge_pages = HugePages::TRANSPARENT,
+                    bool numa_local = false);
+  BufferPoolManager(size_t pool_size, const std::vector<std::string> &db_files,
+                    bool direct_io = false, size_t num_shards = 0,
+                    ReplacerType replacer_type = ReplacerType::LRU,
+                    size_t max_pool_size = 0,
+                    HugePages huge_pages = HugePages::TRANSPARENT,
+                    bool numa_local = false);
 
   ~BufferPoolManager();
 
-  Page *FetchPage(page_id_t page_id);
+  // a page missing from the pool is loaded into a frame of the strategy's
+  // ring if one is given
+  Page *FetchPage(page_id_t page_id,
+                  BufferAccessStrategy *strategy = nullptr);
 
   bool UnpinPage(page_id_t page_id, bool is_dirty);
 
@@ -33,23 +117,149 @@ public:
 
   void FlushAllPages();
 
-  Page *NewPage(page_id_t &page_id);
+  // a page in the pool, unpinned, with the version its content must still
+  // have once read (Page::ValidateVersion); nullptr if the page is missing,
+  // under I/O or write latched
+  Page *PeekPage(page_id_t page_id, uint32_t &version);
+
+  // start reading a page in the background, see buffer/read_ahead.h
+  void PrefetchPage(page_id_t page_id,
+                    BufferAccessStrategy *strategy = nullptr);
+
+  void SyncDirtyPages();
+
+  // write the unpinned dirty pages in page id order, then Sync()
+  void Checkpoint();
+
+  // start a thread that every interval writes the dirty pages among the next
+  // lookahead victims of each shard, and every checkpoint_interval (0: never)
+  // takes a checkpoint. Stopped by the destructor at the latest.
+  void StartBackgroundWriter(
+      std::chrono::milliseconds interval =
+          std::chrono::milliseconds(BG_WRITER_INTERVAL_MS),
+      size_t lookahead = BG_WRITER_LOOKAHEAD,
+      std::chrono::milliseconds checkpoint_interval =
+          std::chrono::milliseconds(CHECKPOINT_INTERVAL_MS));
+  void StopBackgroundWriter();
+
+  Page *NewPage(page_id_t &page_id, page_id_t hint = INVALID_PAGE_ID,
+                BufferAccessStrategy *strategy = nullptr);
 
   bool DeletePage(page_id_t page_id);
 
+  // change the number of frames, false if pool_size is out of [number of
+  // shards, max_pool_size] or pinned pages kept the pool from shrinking that
+  // far (it then shrinks as far as it can, see GetPoolSize)
+  bool Resize(size_t pool_size);
+  inline size_t GetPoolSize() const { return pool_size_; }
+  inline size_t GetMaxPoolSize() const { return max_pool_size_; }
+  // bytes of page frames in use, and at most
+  inline size_t GetMemoryUsage() const { return pool_size_ * PAGE_SIZE; }
+  inline size_t GetMemoryBudget() const { return max_pool_size_ * PAGE_SIZE; }
+
+  inline DiskManager *GetDiskManager() { return &disk_manager_; }
+  inline size_t GetNumShards() const { return num_shards_; }
+  // the kind of pages the frames actually got
+  inline HugePages GetHugePages() const { return huge_pages_; }
+  // FetchPage calls that found the page in the pool, and that had to read it
+  uint64_t GetNumHits();
+  uint64_t GetNumMisses();
+  // victims that had to be written back before their frame could be reused
+  uint64_t GetNumDirtyEvictions();
+
 private:
-  size_t pool_size_;
-  // array of pages
+  struct Shard
+  {
+    // frames in use, out of max_frames starting at frames
+    size_t num_frames;
+    size_t max_frames;
+    Page *frames;
+    // to keep track of page id and its memory location
+    PageTable *page_table;
+    // to collect unpinned pages for replacement
+    Replacer<Page *> *replacer;
+    // to collect free pages for replacement
+    std::list<Page *> *free_list;
+    // frames taken out of the pool by Resize
+    std::vector<Page *> *retired;
+    // protects the four above (readers of the page table excepted) and the
+    // metadata of the shard's pages that is not atomic
+    std::mutex latch;
+    // signalled whenever a page I/O of the shard completes
+    std::condition_variable io_cv;
+    // page writes issued with the latch released and not completed yet
+    size_t writes_in_flight = 0;
+    size_t prefetches_in_flight = 0;
+    uint64_t num_misses = 0;
+    uint64_t num_dirty_evictions = 0;
+  };
+
+  inline Shard &GetShard(page_id_t page_id)
+  {
+    return shards_[static_cast<size_t>(page_id) % num_shards_];
+  }
+  // frames of shard i in a pool of pool_size frames
+  inline size_t ShardFrames(size_t pool_size, size_t i) const
+  {
+    return pool_size / num_shards_ + (i < pool_size % num_shards_ ? 1 : 0);
+  }
+  Page *FindPage(Shard &shard, std::unique_lock<std::mutex> &lock,
+                 page_id_t page_id);
+  Page *FindFrame(Shard &shard, std::unique_lock<std::mutex> &lock,
+                  page_id_t page_id, BufferAccessStrategy *strategy);
+  BufferAccessStrategy::Ring &GetRing(BufferAccessStrategy *strategy,
+                                      page_id_t page_id);
+  Page *TakeRingFrame(Shard &shard, BufferAccessStrategy::Ring &ring);
+  bool TryPin(Shard &shard, Page *page, page_id_t page_id);
+  void Unpin(Shard &shard, Page *page);
+  bool IsMapped(Shard &shard, Page *page);
+  inline bool ClaimFrame(Page *page, int pin_count)
+  {
+    int unpinned = 0;
+    if (!page->pin_count_.compare_exchange_strong(
+            unpinned, Page::PIN_EXCLUSIVE | pin_count,
+            std::memory_order_acquire))
+      return false;
+    // the content may change, fail the optimistic reads of the frame
+    page->rwlatch_.BumpVersion();
+    return true;
+  }
+  inline void ReleaseFrame(Page *page, int pin_count)
+  {
+    page->pin_count_.fetch_sub(Page::PIN_EXCLUSIVE | pin_count,
+                               std::memory_order_release);
+  }
+  void WriteBack(Shard &shard, std::unique_lock<std::mutex> &lock, Page *page);
+  bool RetireFrame(Shard &shard, std::unique_lock<std::mutex> &lock);
+  void WriteBackPages(bool dirty_only);
+  bool CopyForWrite(Shard &shard, Page *page, char *copy,
+                    bool dirty_only = true);
+  void WriteCopies(std::vector<PageWrite> &batch, std::vector<Page *> &pages);
+  void CleanVictims(size_t lookahead);
+  void BackgroundWriterLoop();
+
+  // frames in use, changed by Resize only
+  std::atomic<size_t> pool_size_;
+  size_t max_pool_size_;
+  // serializes Resize calls
+  std::mutex resize_latch_;
+  // array of max_pool_size_ pages, on huge pages like the frames
   Page *pages_;
+  // HUGE_PAGE_SIZE aligned page frames, pages_[i] uses the i-th one (the
+  // frames of a shard follow a gap up to a huge page boundary if numa_local)
+  char *frames_;
+  size_t frames_size_;
+  HugePages huge_pages_;
   DiskManager disk_manager_;
-  // to keep track of page id and its memory location
-  HashTable<page_id_t, Page *> *page_table_;
-  // to collect unpinned pages for replacement
-  Replacer<Page *> *replacer_;
-  // to collect free pages for replacement
-  std::list<Page *> *free_list_;
-  // to protect shared data structure, you may need it for synchronization
-  // between replacer and page table
-  std::mutex latch_;
+  size_t num_shards_;
+  Shard *shards_;
+  // background writer, the settings are fixed while it runs
+  std::thread bg_writer_;
+  std::mutex bg_latch_;
+  std::condition_variable bg_cv_;
+  bool bg_shutdown_ = false;
+  std::chrono::milliseconds bg_interval_;
+  size_t bg_lookahead_ = 0;
+  std::chrono::milliseconds checkpoint_interval_;
 };
 } // namespace cmudb
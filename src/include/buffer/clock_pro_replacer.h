@@ -0,0 +1,92 @@
+/**
+ * clock_pro_replacer.h
+ *
+ * Functionality: CLOCK-Pro (Jiang et al., USENIX ATC 2005) over a fixed
+ * range of values (the frames of a buffer pool). Pages are hot or cold: a
+ * newly loaded page is cold and in its test period, if it is referenced
+ * again before the hand comes back it turns hot. Victims are only taken
+ * among cold pages, hot pages without reference bit are demoted to cold
+ * while there are more than the hot target. A cold page evicted during its
+ * test period is remembered as a non-resident page, its return while still
+ * remembered makes it hot at once and grows the cold target (so a scan is
+ * kept out of the hot set, while a loop slightly larger than the pool is
+ * recognized).
+ *
+ * Differences from the paper: a single hand does the work of the three
+ * hands, pinned pages leave the clock and the targets apply to the unpinned
+ * ones, and the non-resident pages are kept in a fixed size direct mapped
+ * table (a collision forgets the older one, ending its test period). So
+ * Insert/Erase are O(1) and nothing is allocated after construction.
+ *
+ * To recognize a page that comes back, the replacer asks a value for its
+ * key (ReplacerKey(), the page id of a Page *).
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+
+#include "buffer/replacer.h"
+#include "common/config.h"
+
+namespace cmudb
+{
+
+template <typename T>
+class ClockProReplacer : public Replacer<T>
+{
+public:
+  // the values are the elements of [base, base + num_frames)
+  ClockProReplacer(T base, size_t num_frames);
+
+  ~ClockProReplacer();
+
+  void Insert(const T &value);
+
+  bool Victim(T &value);
+
+  bool Erase(const T &value);
+
+  size_t Size();
+
+  void PeekVictims(std::vector<T> &values, size_t count);
+
+  // for tests
+  inline size_t GetColdTarget() const { return cold_target_; }
+
+private:
+  struct FrameState
+  {
+    // the page in the frame, INVALID_PAGE_ID once it is evicted
+    page_id_t key = INVALID_PAGE_ID;
+    bool present = false;
+    bool hot = false;
+    bool referenced = false;
+    bool in_test = false;
+  };
+
+  inline size_t FrameIndex(const T &value)
+  {
+    return static_cast<size_t>(value - base_);
+  }
+  bool TakeNonResident(page_id_t key);
+  void AddNonResident(page_id_t key);
+
+  T base_;
+  size_t num_frames_;
+  FrameState *frames_;
+  size_t hand_;
+  // number of values in the replacer, and the hot ones among them
+  size_t size_;
+  size_t hot_count_;
+  // the unpinned cold pages aimed at, adapted in [1, num_frames - 1]
+  size_t cold_target_;
+  // non-resident cold pages in their test period, by key
+  page_id_t *non_resident_;
+  size_t non_resident_size_;
+
+  std::mutex latch_;
+};
+
+} // namespace cmudb
@@ -0,0 +1,65 @@
+/**
+ * clock_replacer.h
+ *
+ * Functionality: CLOCK approximation of LRU. The replacer covers a fixed
+ * range of values (the frames of a buffer pool), each with a reference bit
+ * set when it is unpinned. Victim() sweeps a hand over the range, clearing
+ * set bits and taking the first unpinned value whose bit is clear.
+ *
+ * Insert/Erase only touch the state of one value, so pinning and unpinning
+ * are O(1) and never allocate.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+
+#include "buffer/replacer.h"
+
+namespace cmudb
+{
+
+template <typename T>
+class ClockReplacer : public Replacer<T>
+{
+public:
+  // the values are the elements of [base, base + num_frames)
+  ClockReplacer(T base, size_t num_frames);
+
+  ~ClockReplacer();
+
+  void Insert(const T &value);
+
+  bool Victim(T &value);
+
+  bool Erase(const T &value);
+
+  size_t Size();
+
+  void PeekVictims(std::vector<T> &values, size_t count);
+
+private:
+  enum FrameState : uint8_t
+  {
+    ABSENT = 0,
+    PRESENT,
+    REFERENCED
+  };
+
+  inline size_t FrameIndex(const T &value)
+  {
+    return static_cast<size_t>(value - base_);
+  }
+
+  T base_;
+  size_t num_frames_;
+  FrameState *states_;
+  size_t hand_;
+  // number of values in the replacer
+  size_t size_;
+
+  std::mutex latch_;
+};
+
+} // namespace cmudb
@@ -0,0 +1,50 @@
+/**
+ * frame_memory.h
+ *
+ * Memory of the buffer pool frames. Frames are mapped anonymously (mmap) and
+ * aligned to HUGE_PAGE_SIZE, so the kernel can back them with 2 MiB pages:
+ * a large pool then needs far fewer TLB entries, and B+ tree traversals
+ * hopping between random frames miss the TLB much less often. Transparent
+ * huge pages are asked for with MADV_HUGEPAGE; explicit huge pages come from
+ * the hugetlbfs pool (vm.nr_hugepages) and fall back to transparent ones if
+ * it is short.
+ *
+ * On a NUMA system a range of frames can be bound to a node (mbind, raw
+ * syscall so there is no libnuma dependency): its pages are then allocated
+ * there, as long as the node has memory left.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace cmudb
+{
+
+enum class HugePages
+{
+  // 4 KiB pages only
+  NONE = 0,
+  // transparent huge pages, when the kernel has them (the default)
+  TRANSPARENT,
+  // preallocated huge pages (MAP_HUGETLB)
+  EXPLICIT
+};
+
+// map length bytes (rounded up to HUGE_PAGE_SIZE) of zeroed frame memory,
+// huge_pages is set to what was used
+char *MapFrames(size_t length, HugePages &huge_pages);
+void UnmapFrames(char *frames, size_t length);
+
+// give the memory of [start, start + length) back to the system, it reads
+// as zeros afterwards (explicit huge pages are kept)
+void DiscardFrames(char *start, size_t length, HugePages huge_pages);
+
+// NUMA nodes with memory, in order (just node 0 without NUMA)
+const std::vector<int> &GetNumaNodes();
+// allocate the pages of [start, start + length) on node, false if the
+// kernel refused
+bool BindToNumaNode(char *start, size_t length, int node);
+
+} // namespace cmudb
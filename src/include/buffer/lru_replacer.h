@@ -34,6 +34,8 @@ public:
 
   size_t Size();
 
+  void PeekVictims(std::vector<T> &values, size_t count);
+
 private:
   // add your member variables here
 
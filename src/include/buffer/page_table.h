@@ -0,0 +1,77 @@
+/**
+ * page_table.h
+ *
+ * Functionality: the page table of a buffer pool shard, mapping page ids to
+ * the frames of the shard. Lookups take no latch: the table is open
+ * addressed (linear probing) over atomic slots, each holding a page id and a
+ * frame index in one 64-bit word, so a reader always sees a whole entry.
+ * Insert and Remove must be serialized by the caller (the shard latch).
+ *
+ * Remove shifts the entries after the removed one back instead of leaving a
+ * tombstone, so a reader racing with it could step over the entry it looks
+ * for. Removals bump a sequence number (odd while one is in progress), and
+ * a lookup that found nothing checks it and probes again if it changed.
+ *
+ * The table is sized to four times the frames, so it never fills up (a
+ * frame being reassigned is mapped under its old and new page id for a
+ * while) and probe sequences stay short. Slots are chosen by a multiplicative
+ * hash of the page id itself.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "hash/hash_table.h"
+#include "page/page.h"
+
+namespace cmudb
+{
+
+class PageTable : public HashTable<page_id_t, Page *>
+{
+public:
+  // maps page ids to the elements of [base, base + num_frames)
+  PageTable(Page *base, size_t num_frames);
+
+  ~PageTable();
+
+  bool Find(const page_id_t &page_id, Page *&frame) override;
+
+  bool Remove(const page_id_t &page_id) override;
+
+  void Insert(const page_id_t &page_id, Page *const &frame) override;
+
+private:
+  static const uint64_t EMPTY_SLOT = ~0ull;
+
+  inline size_t HomeSlot(page_id_t page_id) const
+  {
+    return (static_cast<uint32_t>(page_id) * 0x9E3779B97F4A7C15ull) >> shift_;
+  }
+  inline uint64_t MakeEntry(page_id_t page_id, Page *frame) const
+  {
+    return static_cast<uint64_t>(static_cast<uint32_t>(page_id)) << 32 |
+           static_cast<uint64_t>(frame - base_);
+  }
+  inline page_id_t EntryPageId(uint64_t entry) const
+  {
+    return static_cast<page_id_t>(entry >> 32);
+  }
+  inline Page *EntryFrame(uint64_t entry) const
+  {
+    return base_ + (entry & 0xFFFFFFFFull);
+  }
+
+  Page *base_;
+  // number of slots (a power of two) minus one
+  size_t mask_;
+  // 64 - log2 of the number of slots
+  int shift_;
+  std::atomic<uint64_t> *slots_;
+  // odd while a Remove moves entries
+  std::atomic<uint64_t> removals_;
+};
+
+} // namespace cmudb
@@ -0,0 +1,49 @@
+/**
+ * read_ahead.h
+ *
+ * Read ahead state of a scan following a chain of pages (table heap pages,
+ * B+ tree leaves). The scan reports every page it moves on to past its first
+ * one (so a scan within a single page costs nothing), with the next page of
+ * the chain:
+ *
+ * - the next page is prefetched at once, so the scan does not wait for it at
+ *   the page boundary;
+ * - once READ_AHEAD_TRIGGER pages in a row follow each other on disk (page
+ *   ids n, n + 1, ...), the pages after the next one are prefetched by id,
+ *   READ_AHEAD_MIN_PAGES ahead, doubling up to READ_AHEAD_MAX_PAGES each
+ *   time half of the window has been consumed, within the current extent.
+ *   A jump in the chain starts over.
+ *
+ * With a buffer access strategy the window is capped at half of its ring,
+ * so prefetched pages are not recycled before the scan reaches them.
+ */
+
+#pragma once
+
+#include "buffer/buffer_pool_manager.h"
+
+namespace cmudb
+{
+
+class ReadAhead
+{
+public:
+  ReadAhead(BufferPoolManager *buffer_pool_manager = nullptr,
+            BufferAccessStrategy *strategy = nullptr);
+
+  // the scan moved on to page_id, whose successor in the chain is
+  // next_page_id
+  void Advance(page_id_t page_id, page_id_t next_page_id);
+
+private:
+  BufferPoolManager *buffer_pool_manager_;
+  BufferAccessStrategy *strategy_;
+  page_id_t last_page_id_;
+  // pages in a row that followed each other on disk
+  size_t sequential_pages_;
+  size_t window_;
+  // last page prefetched by id
+  page_id_t prefetched_page_id_;
+};
+
+} // namespace cmudb
@@ -6,10 +6,30 @@
 #pragma once
 
 #include <cstdlib>
+#include <vector>
+
+#include "page/page.h"
 
 namespace cmudb
 {
 
+// replacement policy of a buffer pool
+enum class ReplacerType
+{
+  LRU = 0,
+  // see buffer/clock_replacer.h
+  CLOCK,
+  // see buffer/clock_pro_replacer.h
+  CLOCK_PRO,
+  // see buffer/two_queue_replacer.h
+  TWO_QUEUE
+};
+
+// the key a value is recognized by when it comes back to a replacer that
+// keeps history of evicted values
+inline page_id_t ReplacerKey(Page *value) { return value->GetPageId(); }
+inline page_id_t ReplacerKey(int value) { return value; }
+
 template <typename T>
 class Replacer
 {
@@ -20,6 +40,10 @@ public:
   virtual bool Victim(T &value) = 0;
   virtual bool Erase(const T &value) = 0;
   virtual size_t Size() = 0;
+  // append up to count values in the order Victim() would take them if
+  // nothing changes, without changing any state (as close as the policy can
+  // tell without running its sweep)
+  virtual void PeekVictims(std::vector<T> &values, size_t count) = 0;
 };
 
 } // namespace cmudb
@@ -0,0 +1,94 @@
+/**
+ * two_queue_replacer.h
+ *
+ * Functionality: scan resistant 2Q replacement (Johnson and Shasha, VLDB
+ * 1994) over a fixed range of values (the frames of a buffer pool). A page
+ * loaded for the first time goes to the A1in queue, a page loaded again
+ * while it is still remembered in A1out (the page ids recently evicted from
+ * A1in) goes to the Am queue. Victims come from A1in while it holds more
+ * than a quarter of the frames, otherwise from Am. So pages touched once,
+ * like the heap pages of a sequential scan, leave first and do not push the
+ * pages used over and over (B+ tree internal pages) out of Am.
+ *
+ * Both queues are LRU ordered, intrusive lists over the frames. A1out is a
+ * fixed size direct mapped table of half as many page ids as frames (a
+ * collision forgets the older one), so Insert/Erase are O(1) and nothing is
+ * allocated after construction.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+
+#include "buffer/replacer.h"
+#include "common/config.h"
+
+namespace cmudb
+{
+
+template <typename T>
+class TwoQueueReplacer : public Replacer<T>
+{
+public:
+  // the values are the elements of [base, base + num_frames)
+  TwoQueueReplacer(T base, size_t num_frames);
+
+  ~TwoQueueReplacer();
+
+  void Insert(const T &value);
+
+  bool Victim(T &value);
+
+  bool Erase(const T &value);
+
+  size_t Size();
+
+  void PeekVictims(std::vector<T> &values, size_t count);
+
+private:
+  enum Queue : uint8_t
+  {
+    NONE = 0,
+    A1IN,
+    AM
+  };
+
+  struct FrameState
+  {
+    // the page in the frame, INVALID_PAGE_ID once it is evicted
+    page_id_t key = INVALID_PAGE_ID;
+    // the queue of the page, kept while it is pinned
+    Queue queue = NONE;
+    bool present = false;
+    // neighbours in the queue, toward the most and least recently used end
+    size_t prev = 0;
+    size_t next = 0;
+  };
+
+  inline size_t FrameIndex(const T &value)
+  {
+    return static_cast<size_t>(value - base_);
+  }
+  // each queue is a circular list through a sentinel after the frames
+  inline size_t Sentinel(Queue queue) { return num_frames_ + queue; }
+  void Link(size_t index);
+  void Unlink(size_t index);
+  bool TakeA1out(page_id_t key);
+  void AddA1out(page_id_t key);
+
+  T base_;
+  size_t num_frames_;
+  FrameState *frames_;
+  // number of values in the replacer
+  size_t size_;
+  // pages of A1in in the buffer pool, pinned ones included, and its target
+  size_t a1in_count_;
+  size_t a1in_max_;
+  page_id_t *a1out_;
+  size_t a1out_size_;
+
+  std::mutex latch_;
+};
+
+} // namespace cmudb
@@ -12,8 +12,41 @@ namespace cmudb
 #define INVALID_PAGE_ID -1 // representing an invalid page id
 #define INVALID_TXN_ID -1  // representing an invalid txn id
 #define HEADER_PAGE_ID 0   // the header page id
-#define PAGE_SIZE 4096     // size of a data page in byte
+#ifndef PAGE_SIZE
+#define PAGE_SIZE 4096     // size of a data page in byte, tests may override it
+#endif
+#define PAGE_CHECKSUM_SIZE 4 // checksum trailer, stamped by the disk manager
+// bytes of a page usable by page formats, in front of the checksum
+#define PAGE_DATA_SIZE (PAGE_SIZE - PAGE_CHECKSUM_SIZE)
 #define BUCKET_SIZE 50     // size of extendible hash bucket
+#define BUFFER_POOL_SHARDS 16 // max independently latched buffer pool parts
+#define MIN_SHARD_FRAMES 64   // frames of the smallest buffer pool shard
+#define VTABLE_POOL_SIZE 100  // initial frames of the virtual table pool
+#define VTABLE_POOL_BUDGET_MB 64 // memory the virtual table pool may grow to
+#define HUGE_PAGE_SIZE (2 << 20) // buffer pool frames are aligned to it
+#define OPTIMISTIC_READ_RETRIES 4 // B+ tree lookups restarted before latching
+#define SCAN_RING_SIZE 16  // frames recycled by a sequential scan/bulk insert
+#define READ_AHEAD_TRIGGER 2 // consecutive pages that start read ahead
+#define READ_AHEAD_MIN_PAGES 4 // first read ahead window, doubled after
+#define READ_AHEAD_MAX_PAGES 32 // largest read ahead window
+#define BG_WRITER_INTERVAL_MS 20 // pause between background writer rounds
+#define BG_WRITER_LOOKAHEAD 16   // next victims per shard kept clean
+#define CHECKPOINT_INTERVAL_MS 1000 // period of the background checkpoint
+#define IO_QUEUE_DEPTH 64  // max asynchronous page I/Os in flight
+#define IO_WORKER_THREADS 4 // workers of the thread pool I/O fallback
+#define WRITE_COALESCE_PAGES 64 // max pages merged into one vectored write
+#define FILE_GROWTH_STEP 1024 // pages the db file is preallocated by
+#define GROUP_COMMIT_INTERVAL_MS 10 // max delay of a group commit
+#define GROUP_COMMIT_BYTES (4 << 20) // written bytes that force a group commit
+#define DOUBLE_WRITE_SLOTS 64 // pages in the double write buffer
+#define EXTENT_SIZE 64      // pages in an extent, the unit owned by an object
+#define BITMAP_HEADER_SIZE 128 // bytes in front of the page bits of a bitmap
+#define EXTENT_MAP_OFFSET 64   // where the extent bits of a bitmap start
+// number of pages and extents covered by one free space bitmap page, in
+// whole extents
+#define PAGES_PER_BITMAP                                                     \
+  ((PAGE_DATA_SIZE - BITMAP_HEADER_SIZE) * 8 / EXTENT_SIZE * EXTENT_SIZE)
+#define EXTENTS_PER_BITMAP (PAGES_PER_BITMAP / EXTENT_SIZE)
 
 typedef int32_t page_id_t; // page id type
 typedef int32_t txn_id_t;  // transaction id type
@@ -0,0 +1,23 @@
+/**
+ * crc32c.h
+ *
+ * CRC32C (Castagnoli) checksum, computed with the SSE4.2 crc32 instruction
+ * when the CPU has it and with a lookup table otherwise. Both give the same
+ * result, so files are portable between machines.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace cmudb
+{
+
+// extend crc with len bytes of data, start with crc = 0
+uint32_t Crc32c(const char *data, size_t len, uint32_t crc = 0);
+
+// true if Crc32c uses the hardware instruction
+bool Crc32cIsHardware();
+
+} // namespace cmudb
@@ -0,0 +1,25 @@
+/**
+ * lz_codec.h
+ *
+ * Small LZ77 codec in the style of the LZ4 block format: a sequence is a
+ * token (literal length, match length), the literals, and a 16 bit offset
+ * back to the match. Built for speed over ratio, pages of fixed width columns
+ * and repeated strings still compress well.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+namespace cmudb
+{
+
+// compress len bytes of src into dst
+// @return: compressed size, 0 if it does not fit in capacity bytes
+size_t LzCompress(const char *src, size_t len, char *dst, size_t capacity);
+
+// decompress len bytes of src into exactly dst_len bytes of dst
+// @return: false if src is malformed (never reads or writes out of bounds)
+bool LzDecompress(const char *src, size_t len, char *dst, size_t dst_len);
+
+} // namespace cmudb
@@ -2,13 +2,31 @@
  * rwmutex.h
  *
  * Reader-Writer lock
+ *
+ * FutexRWMutex behaves like RWMutex (a writer waiting keeps new readers
+ * out) in a single 32-bit word, so it can sit in every buffer pool frame
+ * descriptor: the reader count, a writer bit and a waiters bit. Uncontended
+ * lock and unlock are one atomic operation; a thread that has to wait sleeps
+ * on the word with a futex, and unlocks only make the wake up syscall when
+ * the waiters bit is set.
+ *
+ * The rest of the word is a version, bumped by every write unlock, for
+ * optimistic readers that take no lock: they read the version, read the
+ * data, and validate that the version is unchanged (and no writer came in),
+ * otherwise what they read may be torn. The version has 18 bits, a reader
+ * is only fooled if exactly a multiple of 2^18 writes happen during its read.
  */
 
 #pragma once
 
+#include <atomic>
 #include <climits>
 #include <condition_variable>
+#include <cstdint>
+#include <linux/futex.h>
 #include <mutex>
+#include <sys/syscall.h>
+#include <unistd.h>
 
 namespace cmudb
 {
@@ -75,4 +93,129 @@ private:
   uint32_t reader_count_;
   bool writer_entered_;
 };
+
+class FutexRWMutex
+{
+  static const uint32_t READER_MASK = (1u << 12) - 1;
+  // a writer holds the lock, or waits for the readers in it to leave
+  static const uint32_t WRITER = 1u << 12;
+  // some thread sleeps on the word
+  static const uint32_t WAITERS = 1u << 13;
+  static const uint32_t VERSION_ONE = 1u << 14;
+  static const uint32_t VERSION_MASK = ~(VERSION_ONE - 1);
+
+public:
+  FutexRWMutex() : state_(0) {}
+
+  FutexRWMutex(const FutexRWMutex &) = delete;
+  FutexRWMutex &operator=(const FutexRWMutex &) = delete;
+
+  void WLock()
+  {
+    uint32_t state = state_.load(std::memory_order_relaxed);
+    while (true)
+    {
+      if ((state & WRITER) == 0)
+      {
+        if (state_.compare_exchange_weak(state, state | WRITER,
+                                         std::memory_order_acquire))
+          break;
+        continue;
+      }
+      Wait(state);
+      state = state_.load(std::memory_order_relaxed);
+    }
+    state |= WRITER;
+    while ((state & READER_MASK) != 0)
+    {
+      Wait(state);
+      state = state_.load(std::memory_order_acquire);
+    }
+    // writes to the data stay after the writer bit for optimistic readers
+    std::atomic_thread_fence(std::memory_order_release);
+  }
+
+  void WUnlock()
+  {
+    uint32_t state = state_.load(std::memory_order_relaxed);
+    while (!state_.compare_exchange_weak(
+        state, (state & ~(WRITER | WAITERS)) + VERSION_ONE,
+        std::memory_order_release, std::memory_order_relaxed))
+      ;
+    if (state & WAITERS)
+      WakeAll();
+  }
+
+  void RLock()
+  {
+    uint32_t state = state_.load(std::memory_order_relaxed);
+    while (true)
+    {
+      if ((state & WRITER) == 0 && (state & READER_MASK) != READER_MASK)
+      {
+        if (state_.compare_exchange_weak(state, state + 1,
+                                         std::memory_order_acquire))
+          return;
+        continue;
+      }
+      Wait(state);
+      state = state_.load(std::memory_order_relaxed);
+    }
+  }
+
+  void RUnlock()
+  {
+    uint32_t state = state_.fetch_sub(1, std::memory_order_release);
+    // the last reader out lets a waiting writer in
+    if ((state & WAITERS) && (state & READER_MASK) == 1)
+    {
+      state_.fetch_and(~WAITERS, std::memory_order_relaxed);
+      WakeAll();
+    }
+  }
+
+  // start an optimistic read, false if a writer is in
+  bool ReadVersion(uint32_t &version) const
+  {
+    uint32_t state = state_.load(std::memory_order_acquire);
+    version = state & VERSION_MASK;
+    return (state & WRITER) == 0;
+  }
+
+  // true if the data read since ReadVersion returned version is consistent
+  bool ValidateVersion(uint32_t version) const
+  {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return (state_.load(std::memory_order_relaxed) & (VERSION_MASK | WRITER)) ==
+           version;
+  }
+
+  // fail the optimistic reads in progress, for a change of the data made
+  // without the lock (nobody may hold it)
+  void BumpVersion()
+  {
+    state_.fetch_add(VERSION_ONE, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+  }
+
+private:
+  // sleep until the word changes from state (with the waiters bit set)
+  void Wait(uint32_t state)
+  {
+    if ((state & WAITERS) == 0 &&
+        !state_.compare_exchange_strong(state, state | WAITERS,
+                                        std::memory_order_relaxed))
+      return;
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(&state_),
+            FUTEX_WAIT_PRIVATE, state | WAITERS, nullptr, nullptr, 0);
+  }
+
+  void WakeAll()
+  {
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(&state_),
+            FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+  }
+
+  std::atomic<uint32_t> state_;
+};
 } // namespace cmudb
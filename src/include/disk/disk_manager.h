@@ -5,35 +5,258 @@
  * database. It also performs read and write of pages to and from disk, and
  * provides a logical file layer within the context of a database management
  * system.
+ *
+ * Page I/O goes through positional pread/pwrite on a raw file descriptor, so
+ * there is no shared seek cursor and ReadPage/WritePage can be called from
+ * many threads at once.
+ *
+ * A database can be made of several data files (e.g. on different disks):
+ * extents are striped over them round robin, so a page id maps to a (file,
+ * offset) pair and the extents of a growing table or index land on every
+ * file in turn. The list of files is fixed when the database is created.
+ *
+ * The *Async methods hand pages to an asynchronous I/O engine (io_uring, or a
+ * thread pool fallback, see disk/io_engine.h) so that callers can keep many
+ * page I/Os in flight. Buffers must stay valid until the callback has run.
+ * A batch of writes is sorted by page id and runs of pages adjacent on disk
+ * are merged into vectored writes, so a flush or checkpoint issues a few
+ * large sequential writes rather than many scattered pages.
+ *
+ * In direct I/O mode the file is opened with O_DIRECT, so pages bypass the
+ * kernel page cache and are cached only by the buffer pool. Buffers handed to
+ * the *Async methods must then be PAGE_SIZE aligned (buffer pool frames are);
+ * ReadPage/WritePage bounce unaligned buffers through an aligned copy.
+ *
+ * Free space is tracked by bitmap pages stored in the data files themselves.
+ * Within a file every group of PAGES_PER_BITMAP pages is preceded by a
+ * bitmap page slot, so page ids stay contiguous and the physical slot of a
+ * page skips the bitmap pages. With a single file, bitmap page k sits right
+ * before the pages it covers.
+ * Pages are grouped in extents of EXTENT_SIZE contiguous pages, an extent is
+ * either part of the mixed space or owned by a single table or index (see
+ * AllocatePage).
+ * Bitmap page 0 records the on-disk format version. A file of any other
+ * format, including the original one (page k at offset k * PAGE_SIZE, no
+ * checksum trailer), fails to open with an "unsupported format" error.
+ *
+ * Writes only reach the kernel, Sync() makes them durable according to the
+ * durability level. Concurrent Sync() calls share a single fdatasync.
+ *
+ * Every page written gets the CRC32C of its first PAGE_DATA_SIZE bytes
+ * stamped into its last PAGE_CHECKSUM_SIZE bytes, on a copy the page is
+ * written from (the caller's buffer is left alone). Depending on the
+ * checksum mode reads verify it, and in REPAIR mode each write first goes to
+ * a double write file (<db_file>.dblwr), from which a torn or corrupted page
+ * is restored.
+ *
+ * With compression on, a page that compresses to fewer file system blocks is
+ * stored as a compressed image at the start of its slot, and the blocks of
+ * the rest of the slot are punched out (the file becomes sparse). This only
+ * pays off with blocks smaller than a page, pages are written as is
+ * otherwise. Reads recognize compressed images whatever the current setting.
  */
 
 #pragma once
 #include <atomic>
-#include <fstream>
+#include <chrono>
+#include <condition_variable>
+#include <map>
+#include <mutex>
 #include <string>
+#include <sys/types.h>
+#include <thread>
+#include <vector>
 
 #include "common/config.h"
+#include "disk/io_engine.h"
 
 namespace cmudb
 {
 
+// one page of a batched write
+struct PageWrite
+{
+  page_id_t page_id;
+  const char *page_data;
+};
+
+enum class DurabilityLevel
+{
+  // Sync() does nothing, durability is left to the kernel
+  NONE = 0,
+  // Sync() returns once an fdatasync that started after the call completed
+  COMMIT,
+  // like COMMIT, but fdatasync is only issued by a background thread, every
+  // group_interval or once group_bytes have been written
+  GROUP_COMMIT
+};
+
+enum class ChecksumMode
+{
+  // checksums are stamped but never checked
+  OFF = 0,
+  // a read of a page with a bad checksum fails
+  VERIFY,
+  // like VERIFY, but the page is restored from the double write file if it
+  // has an intact copy; writes go through the double write file
+  REPAIR
+};
+
 class DiskManager
 {
 public:
-  DiskManager(const std::string &db_file);
+  DiskManager(const std::string &db_file, bool direct_io = false);
+  // pages striped over several data files, the first one is the main file
+  DiskManager(const std::vector<std::string> &db_files, bool direct_io = false);
   ~DiskManager();
 
   void WritePage(page_id_t page_id, const char *page_data);
-  void ReadPage(page_id_t page_id, char *page_data);
+  // false on I/O error or a checksum mismatch that could not be repaired
+  bool ReadPage(page_id_t page_id, char *page_data);
 
-  page_id_t AllocatePage();
+  // asynchronous page I/O, callback runs on an I/O engine thread
+  void ReadPageAsync(page_id_t page_id, char *page_data,
+                     const IOCallback &callback);
+  void WritePageAsync(page_id_t page_id, const char *page_data,
+                      const IOCallback &callback);
+  // callback runs once, after every page of the batch has been written
+  void WritePagesAsync(const std::vector<PageWrite> &batch,
+                       const IOCallback &callback);
+  // block until all asynchronous I/O issued so far has completed
+  void WaitForAsyncIO();
+
+  // allocate the free page closest to hint, or the lowest free page
+  page_id_t AllocatePage(page_id_t hint = INVALID_PAGE_ID);
   void DeallocatePage(page_id_t page_id);
+  bool IsPageAllocated(page_id_t page_id);
+
+  // false if direct I/O was not asked for or the file system refused it
+  inline bool IsDirectIO() const { return direct_io_; }
+  inline size_t GetNumFiles() const { return files_.size(); }
+
+  // preallocate the file num_pages at a time as it grows
+  void SetGrowthStep(size_t num_pages);
+
+  // call before the disk manager is shared between threads
+  void SetDurability(
+      DurabilityLevel level,
+      std::chrono::milliseconds group_interval =
+          std::chrono::milliseconds(GROUP_COMMIT_INTERVAL_MS),
+      size_t group_bytes = GROUP_COMMIT_BYTES);
+  inline DurabilityLevel GetDurability() const { return durability_; }
+  // make every write completed before the call durable (commit point)
+  void Sync();
+  // number of fdatasync issued so far
+  uint64_t GetSyncCount();
+
+  // call before the disk manager is shared between threads, switching to
+  // REPAIR first restores the pages torn by a crash
+  void SetChecksumMode(ChecksumMode mode);
+  inline ChecksumMode GetChecksumMode() const { return checksum_mode_; }
+
+  // call before the disk manager is shared between threads
+  void SetCompression(bool enable);
+  inline bool IsCompressed() const { return compression_; }
+
+  // call before the disk manager is shared between threads
+  inline void SetWriteCoalescing(bool enable) { write_coalescing_ = enable; }
 
 private:
-  int GetFileSize();
-  std::fstream db_io_;
+  struct DataFile
+  {
+    int fd;
+    std::string name;
+    // logical file size, end of the last page written
+    std::atomic<off_t> size;
+    // the file has blocks reserved up to here, protected by growth_latch_
+    // (read without it as a fast path)
+    std::atomic<off_t> preallocated_size;
+  };
+
+  void OpenFile(const std::string &name, bool direct_io);
+  void CloseFiles();
+  DataFile *PageLocation(page_id_t page_id, off_t &offset);
+  DataFile *BitmapLocation(size_t index, off_t &offset);
+  void GrowFile(DataFile *file, off_t end);
+  void SyncFiles();
+  void AddUnsyncedBytes(size_t bytes);
+  void RunSync(std::unique_lock<std::mutex> &lock);
+  void GroupSyncLoop();
+  void StopGroupSyncer();
+  AsyncIOEngine *GetIOEngine();
+  void WriteInPlace(page_id_t page_id, const char *page_data);
+  size_t CompressPage(const char *page_data, char *image);
+  void PunchTail(DataFile *file, off_t offset, size_t image_size);
+  bool FinishRead(page_id_t page_id, char *page_data);
+  // caller must hold dblwr_latch_
+  void DoubleWrite(const PageWrite *pages, size_t count);
+  bool RecoverPage(page_id_t page_id, char *page_data);
+  bool ReadDoubleWriteCopy(page_id_t page_id, char *page_data);
+  void RecoverTornPages();
+  // free space management, caller must hold alloc_latch_
+  void LoadBitmaps();
+  page_id_t FindFreePageInExtent(int extent, page_id_t hint);
+  int ReserveExtent(int preferred);
+  void TakeFreeRange(std::map<page_id_t, page_id_t>::iterator run,
+                     page_id_t first, page_id_t length);
+  void AddFreeRange(page_id_t first, page_id_t length);
+  bool IsAllocated(page_id_t page_id);
+  bool IsExtentOwned(int extent);
+  void SetAllocated(page_id_t page_id, bool allocated);
+  void SetExtentOwned(int extent, bool owned);
+  char *GetBitmap(size_t index);
+  void WriteBitmap(size_t index);
+
+  // data files, their descriptors are shared by all threads
+  std::vector<DataFile *> files_;
+  bool direct_io_;
+  // name of the main file
   std::string file_name_;
-  std::atomic<page_id_t> next_page_id_;
+  // protects next_page_id_, free_runs_ and the bitmaps
+  std::mutex alloc_latch_;
+  // every page id at or above the high water mark is free
+  page_id_t next_page_id_;
+  // free pages of the mixed space below next_page_id_ as runs: first page id
+  // -> run length
+  std::map<page_id_t, page_id_t> free_runs_;
+  // in memory copy of the bitmap pages, deallocations write them lazily
+  std::vector<char *> bitmaps_;
+  std::vector<bool> bitmap_dirty_;
+  off_t growth_step_;
+  std::mutex growth_latch_;
+  // durability, everything below is protected by sync_latch_
+  DurabilityLevel durability_;
+  std::mutex sync_latch_;
+  std::condition_variable sync_cv_;
+  // syncs_done_ only counts the ones started before it, so a Sync() call
+  // waits for syncs_done_ to reach syncs_started_ + 1 as of its call
+  uint64_t syncs_started_;
+  uint64_t syncs_done_;
+  bool sync_running_;
+  size_t sync_waiters_;
+  // bytes written since the last fdatasync started
+  std::atomic<size_t> unsynced_bytes_;
+  std::chrono::milliseconds group_interval_;
+  size_t group_bytes_;
+  std::condition_variable group_cv_;
+  std::thread group_syncer_;
+  bool group_shutdown_;
+  // checksums and double write file
+  ChecksumMode checksum_mode_;
+  int dblwr_fd_;
+  // held from the double write of a page until its in place write is issued
+  std::mutex dblwr_latch_;
+  size_t dblwr_next_slot_;
+  uint64_t dblwr_seq_;
+  // transparent compression, holes are punched in whole fs blocks (the
+  // largest of the data files)
+  bool compression_;
+  off_t fs_block_size_;
+  // merge adjacent pages of a batch into vectored writes
+  bool write_coalescing_;
+  // created on first asynchronous request
+  std::once_flag io_engine_init_;
+  AsyncIOEngine *io_engine_;
 };
 
 } // namespace cmudb
@@ -0,0 +1,160 @@
+/**
+ * io_engine.h
+ *
+ * Asynchronous page I/O engines used by the disk manager. Requests are
+ * submitted in batches and complete out of order on a background thread,
+ * which invokes the callback of every request.
+ *
+ * IOUringEngine talks to io_uring directly through raw syscalls (no liburing).
+ * When the kernel (or a seccomp filter) refuses io_uring_setup, Create()
+ * falls back to ThreadPoolIOEngine, which runs blocking pread/pwrite on a
+ * small pool of worker threads.
+ *
+ * Every request names its file, so one engine serves all the data files of a
+ * disk manager. A write request may gather several buffers (pwritev), so
+ * adjacent pages go to the device in one transfer.
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <thread>
+#include <vector>
+
+#include "common/config.h"
+
+namespace cmudb
+{
+
+// invoked on an engine thread once the request is done, true means success
+typedef std::function<void(bool)> IOCallback;
+
+struct IORequest
+{
+  int fd;
+  bool is_write;
+  off_t offset;
+  char *buf;
+  size_t len;
+  // a vectored write when not empty: buf is unused and len is the total
+  // length of the buffers
+  std::vector<struct iovec> iovecs;
+  IOCallback callback;
+  // used by io_uring readv/writev
+  struct iovec iov;
+};
+
+// blocking positional read/write, retry on EINTR and short transfers
+// return number of bytes transferred (less than len only at end of file),
+// -1 on I/O error
+ssize_t PositionalRead(int fd, char *buf, size_t len, off_t offset);
+ssize_t PositionalWrite(int fd, const char *buf, size_t len, off_t offset);
+// blocking vectored write of the buffers in iov, same contract as
+// PositionalWrite
+ssize_t PositionalWriteVector(int fd, const struct iovec *iov, int iovcnt,
+                              off_t offset);
+
+// O_DIRECT needs buffers aligned to the logical block size, a page boundary
+// satisfies every device
+inline bool IsPageAligned(const void *buf)
+{
+  return reinterpret_cast<uintptr_t>(buf) % PAGE_SIZE == 0;
+}
+// PAGE_SIZE aligned memory for num_pages pages, release with free()
+char *AllocateAlignedPages(size_t num_pages);
+
+class AsyncIOEngine
+{
+public:
+  AsyncIOEngine() : in_flight_(0) {}
+  virtual ~AsyncIOEngine() {}
+
+  // create io_uring engine if supported (and wanted), otherwise thread pool
+  static AsyncIOEngine *Create(size_t queue_depth, bool use_io_uring = true);
+
+  // queue a batch of requests, block only if queue_depth requests are
+  // already in flight
+  virtual void Submit(std::vector<IORequest> &requests) = 0;
+
+  // block until every submitted request has completed
+  void Drain();
+
+  virtual const char *GetName() const = 0;
+
+protected:
+  // finish a request: fix up short transfers, run callback, release slot
+  void Complete(IORequest *request, ssize_t result);
+  // wait for a free slot, caller must hold latch_
+  void AcquireSlot(std::unique_lock<std::mutex> &lock, size_t queue_depth);
+
+  size_t in_flight_;
+  std::mutex latch_;
+  std::condition_variable slot_cv_;
+};
+
+class IOUringEngine : public AsyncIOEngine
+{
+public:
+  IOUringEngine(size_t queue_depth);
+  ~IOUringEngine();
+
+  // false if io_uring_setup/mmap failed, engine must not be used then
+  inline bool IsValid() const { return ring_fd_ >= 0; }
+
+  void Submit(std::vector<IORequest> &requests) override;
+
+  const char *GetName() const override { return "io_uring"; }
+
+private:
+  void ReapCompletions();
+  void Enter(unsigned to_submit, unsigned min_complete, unsigned flags);
+  void PushSqe(IORequest *request);
+
+  int ring_fd_;
+  size_t queue_depth_;
+  // submission ring
+  void *sq_ring_;
+  size_t sq_ring_size_;
+  unsigned *sq_tail_;
+  unsigned *sq_mask_;
+  unsigned *sq_array_;
+  struct io_uring_sqe *sqes_;
+  size_t sqes_size_;
+  // completion ring
+  void *cq_ring_;
+  size_t cq_ring_size_;
+  unsigned *cq_head_;
+  unsigned *cq_tail_;
+  unsigned *cq_mask_;
+  struct io_uring_cqe *cqes_;
+
+  std::thread reaper_;
+};
+
+class ThreadPoolIOEngine : public AsyncIOEngine
+{
+public:
+  ThreadPoolIOEngine(size_t queue_depth, size_t num_workers);
+  ~ThreadPoolIOEngine();
+
+  void Submit(std::vector<IORequest> &requests) override;
+
+  const char *GetName() const override { return "thread pool"; }
+
+private:
+  void WorkerLoop();
+
+  size_t queue_depth_;
+  bool shutdown_;
+  std::deque<IORequest *> queue_;
+  std::condition_variable queue_cv_;
+  std::vector<std::thread> workers_;
+};
+
+} // namespace cmudb
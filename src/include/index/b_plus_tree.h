@@ -7,12 +7,42 @@
  * (2) support insert & remove
  * (3) The structure should shrink and grow dynamically
  * (4) Implement index iterator for range scan
+ *
+ * Concurrent operations are serialized by latch crabbing: a lookup read
+ * latches a child before releasing its parent, an insert or remove write
+ * latches its path and releases the ancestors once a child is safe (cannot
+ * split or merge). The latches and pins a writer holds are kept in the page
+ * set of its transaction, nullptr standing for root_latch_, which protects
+ * root_page_id_.
+ *
+ * In optimistic mode, point lookups first try optimistic lock coupling: no
+ * latch, no pin, nothing written to shared memory. Each page is read under
+ * the version of its latch (see BufferPoolManager::PeekPage) and validated
+ * once the child version has been read, the leaf once the value is copied.
+ * A lookup whose page changed under it restarts, and falls back to latch
+ * crabbing after OPTIMISTIC_READ_RETRIES attempts or if a page is not in the
+ * buffer pool. A torn page is fed to the comparator before validation, so
+ * the mode is only for keys of inlined columns.
+ *
+ * In B-link mode (Lehman and Yao) every page also has a right link and a
+ * high key, the upper bound of its keys, kept at the end of the page (only
+ * B-link trees give up the room for them). Any operation holds a single page
+ * latch at a time: the parent is released before the child is latched, and
+ * an operation that finds its key at or beyond the high key of a page (the
+ * page split meanwhile) moves right. A split links the new page in at its
+ * level first, then releases the page and adds the new page to the parent
+ * (found again from the pages passed on the way down, moving right if the
+ * parent split too) in key order, so splits of neighbouring pages may reach
+ * the parent in any order. Removes never merge pages, a page emptied stays
+ * in the tree. A tree must always be opened in the mode it was built with.
  */
 #pragma once
 
+#include <mutex>
 #include <queue>
 #include <vector>
 
+#include "common/rwmutex.h"
 #include "concurrency/transaction.h"
 #include "index/index_iterator.h"
 #include "page/b_plus_tree_internal_page.h"
@@ -41,7 +71,8 @@ public:
   explicit BPlusTree(const std::string &name,
                      BufferPoolManager *buffer_pool_manager,
                      const KeyComparator &comparator,
-                     page_id_t root_page_id = INVALID_PAGE_ID);
+                     page_id_t root_page_id = INVALID_PAGE_ID,
+                     bool optimistic = false, bool blink = false);
 
   // Returns true if this B+ tree has no keys and values.
   bool IsEmpty() const;
@@ -72,13 +103,18 @@ public:
   void RemoveFromFile(const std::string &file_name,
                       Transaction *transaction = nullptr);
   // expose for test purpose
-  B_PLUS_TREE_LEAF_PAGE_TYPE *FindLeafPage(const KeyType &key,
-                                           SearchType option = SearchType::Find,
-                                           bool leftMost = false);
+  // The leaf page is returned pinned and latched (read latched for Find, in
+  // the page set of the transaction otherwise), nullptr if the tree is empty
+  // or a page failed its checksum (the transaction is then aborted).
+  Page *FindLeafPage(const KeyType &key, SearchType option = SearchType::Find,
+                     bool leftMost = false, Transaction *transaction = nullptr);
 
 private:
   void StartNewTree(const KeyType &key, const ValueType &value);
 
+  // false if the lookup has to be retried
+  bool OptimisticLookup(const KeyType &key, ValueType &value, bool &found);
+
   bool InsertIntoLeaf(const KeyType &key, const ValueType &value,
                       Transaction *transaction = nullptr);
 
@@ -101,7 +137,30 @@ private:
   template <typename N>
   void Redistribute(N *neighbor_node, N *node, int index);
 
-  bool AdjustRoot(BPlusTreePage *node);
+  bool AdjustRoot(BPlusTreePage *node, Transaction *transaction = nullptr);
+
+  // true if the operation cannot split or merge node
+  bool IsSafe(BPlusTreePage *node, SearchType option);
+
+  // unlatch and unpin the page set, then delete the pages removed from the tree
+  void ReleaseLatches(Transaction *transaction, bool is_dirty);
+  void DeletePages(Transaction *transaction);
+
+  // B-link mode, path receives the internal pages passed, root first
+  Page *FindLeafPageBLink(const KeyType &key, bool leftMost, bool exclusive,
+                          Transaction *transaction,
+                          std::vector<page_id_t> *path = nullptr);
+  Page *MoveRight(Page *page, const KeyType &key, bool exclusive);
+  bool IsBeyondHighKey(BPlusTreePage *node, const KeyType &key,
+                       page_id_t &next_page_id);
+  bool InsertBLink(const KeyType &key, const ValueType &value,
+                   Transaction *transaction);
+  void InsertIntoParentBLink(page_id_t old_page_id, KeyType key,
+                             page_id_t new_page_id,
+                             std::vector<page_id_t> &path);
+  template <typename N>
+  page_id_t SplitBLink(N *node, KeyType &separator);
+  void RemoveBLink(const KeyType &key, Transaction *transaction);
 
   void UpdateRootPageId(int insert_record = false);
 
@@ -110,6 +169,14 @@ private:
   std::atomic<page_id_t> root_page_id_;
   BufferPoolManager *buffer_pool_manager_;
   KeyComparator comparator_;
+  FutexRWMutex root_latch_;
+  // pages removed from the tree but still pinned by a reader when deleted,
+  // retried by the next writers
+  std::mutex deferred_latch_;
+  std::vector<page_id_t> deferred_deletes_;
+  std::atomic<size_t> num_deferred_deletes_;
+  bool optimistic_;
+  bool blink_;
 };
 
 } // namespace cmudb
@@ -1,8 +1,15 @@
 /**
  * index_iterator.h
  * For range scan of b+ tree
+ * The leaves ahead are read in the background (see buffer/read_ahead.h).
+ * The current leaf is kept read latched. Moving to the next leaf releases it
+ * before latching the next one, as a remove latches leaves right to left.
+ * Known limitation: a merge can move the entries of the next leaf into the
+ * leaf just released, so a scan running alongside removes can miss keys that
+ * were present the whole time. Pinning the next leaf does not prevent it.
  */
 #pragma once
+#include "buffer/read_ahead.h"
 #include "page/b_plus_tree_leaf_page.h"
 
 namespace cmudb
@@ -17,8 +24,8 @@ class IndexIterator
 public:
   // you may define your own constructor based on your member variables
   IndexIterator();
-  IndexIterator(BufferPoolManager *buffer_pool_manager,
-                B_PLUS_TREE_LEAF_PAGE_TYPE *leaf_page,
+  // page is a read latched leaf, or nullptr for an empty tree
+  IndexIterator(BufferPoolManager *buffer_pool_manager, Page *page,
                 int offset);
   ~IndexIterator();
 
@@ -29,10 +36,14 @@ public:
   IndexIterator &operator++();
 
 private:
+  void SkipExhaustedLeaves();
+
   // add your own private member variables here
   BufferPoolManager *buffer_pool_manager_;
+  Page *page_;
   B_PLUS_TREE_LEAF_PAGE_TYPE *leaf_page_;
   int offset_;
+  ReadAhead read_ahead_;
 };
 
 } // namespace cmudb
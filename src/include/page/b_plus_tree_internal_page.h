@@ -12,6 +12,9 @@
  *  --------------------------------------------------------------------------
  * | HEADER | KEY(1)+PAGE_ID(1) | KEY(2)+PAGE_ID(2) | ... | KEY(n)+PAGE_ID(n) |
  *  --------------------------------------------------------------------------
+ *
+ * A page of a B-link tree also keeps its next page id (right sibling) and
+ * its high key in the last bytes of the page, see the leaf page.
  */
 
 #pragma once
@@ -31,7 +34,8 @@ class BPlusTreeInternalPage : public BPlusTreePage
 {
 public:
   // must call initialize method after "create" a new node
-  void Init(page_id_t page_id, page_id_t parent_id = INVALID_PAGE_ID);
+  void Init(page_id_t page_id, page_id_t parent_id = INVALID_PAGE_ID,
+            bool blink = false);
 
   KeyType KeyAt(int index) const;
   void SetKeyAt(int index, const KeyType &key);
@@ -43,6 +47,14 @@ public:
                        const ValueType &new_value);
   int InsertNodeAfter(const ValueType &old_value, const KeyType &new_key,
                       const ValueType &new_value);
+  int InsertNode(const KeyType &new_key, const ValueType &new_value,
+                 const KeyComparator &comparator);
+
+  // B-link trees only
+  page_id_t GetNextPageId() const;
+  void SetNextPageId(page_id_t next_page_id);
+  KeyType GetHighKey() const;
+  void SetHighKey(const KeyType &key);
   void Remove(int index);
   ValueType RemoveAndReturnOnlyChild();
 
@@ -71,6 +83,12 @@ private:
                     BufferPoolManager *buffer_pool_manager);
   void CopyFirstFrom(const MappingType &pair, int parent_index,
                      BufferPoolManager *buffer_pool_manager);
+  struct BLinkTrailer
+  {
+    page_id_t next_page_id;
+    KeyType high_key;
+  };
+  BLinkTrailer *Trailer() const;
   MappingType array[0];
 };
 } // namespace cmudb
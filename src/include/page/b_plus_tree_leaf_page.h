@@ -17,6 +17,10 @@
  *  ------------------------------
  * | PageId (4) | NextPageId (4)
  *  ------------------------------
+ * A page of a B-link tree also keeps its high key in the last bytes of the
+ * page (max size is lowered to make room, other trees do not pay for it).
+ * It bounds the keys of the page from above (exclusive) when it has a next
+ * page.
  */
 #pragma once
 #include <utility>
@@ -38,11 +42,15 @@ class BPlusTreeLeafPage : public BPlusTreePage
 public:
   // After creating a new leaf page from buffer pool, must call initialize
   // method to set default values
-  void Init(page_id_t page_id, page_id_t parent_id = INVALID_PAGE_ID);
+  void Init(page_id_t page_id, page_id_t parent_id = INVALID_PAGE_ID,
+            bool blink = false);
 
   // helper methods
   page_id_t GetNextPageId() const;
   void SetNextPageId(page_id_t next_page_id);
+  // B-link trees only
+  KeyType GetHighKey() const;
+  void SetHighKey(const KeyType &key);
   KeyType KeyAt(int index) const;
   int KeyIndex(const KeyType &key, const KeyComparator &comparator) const;
   const MappingType &GetItem(int index);
@@ -72,6 +80,7 @@ private:
   void CopyLastFrom(const MappingType &item);
   void CopyFirstFrom(const MappingType &item, int parentIndex,
                      BufferPoolManager *buffer_pool_manager);
+  KeyType *HighKeySlot() const;
   page_id_t next_page_id_;
   MappingType array[0];
 };
@@ -4,10 +4,21 @@
  * Wrapper around actual data page in main memory and also contains bookkeeping
  * information used by buffer pool manager like pin_count/dirty_flag/page_id.
  * Use page as a basic unit within the database system
+ *
+ * The page content lives in a PAGE_SIZE aligned frame owned by the buffer pool
+ * manager (aligned so it can be handed to O_DIRECT I/O), so on-page structures
+ * must be overlaid on GetData(), never on the Page object itself.
+ *
+ * A Page is just the descriptor of a frame, kept to 32 bytes (the latch is a
+ * single word, see FutexRWMutex): the buffer pool keeps the descriptors in
+ * an array apart from the frames, two per cache line, so its sweeps over
+ * every frame (flushes, checkpoints) stay in cache, while a hit still finds
+ * all it needs of a frame in one line.
  */
 
 #pragma once
 
+#include <atomic>
 #include <cstring>
 #include <iostream>
 
@@ -22,29 +33,59 @@ class Page
   friend class BufferPoolManager;
 
 public:
-  Page() { ResetMemory(); }
+  Page() {}
   ~Page(){};
   // get actual data page content
   inline char *GetData() { return data_; }
   // get page id
-  inline page_id_t GetPageId() { return page_id_; }
+  inline page_id_t GetPageId()
+  {
+    return page_id_.load(std::memory_order_relaxed);
+  }
   // get page pin count
-  inline int GetPinCount() { return pin_count_; }
+  inline int GetPinCount()
+  {
+    return pin_count_.load(std::memory_order_relaxed) & ~PIN_EXCLUSIVE;
+  }
   // method use to latch/unlatch page content
   inline void WUnlatch() { rwlatch_.WUnlock(); }
   inline void WLatch() { rwlatch_.WLock(); }
   inline void RUnlatch() { rwlatch_.RUnlock(); }
   inline void RLatch() { rwlatch_.RLock(); }
+  // true if the content has not changed since BufferPoolManager::PeekPage
+  // returned version
+  inline bool ValidateVersion(uint32_t version)
+  {
+    return rwlatch_.ValidateVersion(version);
+  }
 
 private:
+  // set in pin_count_ while the buffer pool manager has the frame to itself
+  // (loading another page into it, copying it out), latch free lookups back
+  // off then
+  static const int PIN_EXCLUSIVE = 1 << 30;
+
   // method used by buffer pool manager
   inline void ResetMemory() { memset(data_, 0, PAGE_SIZE); }
-  // members
-  char data_[PAGE_SIZE]; // actual data
-  page_id_t page_id_ = INVALID_PAGE_ID;
-  int pin_count_ = 0;
-  bool is_dirty_ = false;
-  RWMutex rwlatch_;
+  // members, largest first so there is no padding between them
+  char *data_ = nullptr; // actual data, set by buffer pool manager
+  // FetchPage calls that found the page in this frame
+  std::atomic<uint64_t> num_hits_{0};
+  // pins are taken without the shard latch on a hit, the page id only
+  // changes while the frame is PIN_EXCLUSIVE
+  std::atomic<page_id_t> page_id_{INVALID_PAGE_ID};
+  std::atomic<int> pin_count_{0};
+  FutexRWMutex rwlatch_;
+  std::atomic<bool> is_dirty_{false};
+  // the frame is being read in or its old page written back, with the shard
+  // latch released: lookups of its page ids wait instead of using it
+  bool io_pending_ = false;
+  // a copy of the page is being written by the background writer or a
+  // checkpoint: the frame may be used, but its page must not be written again
+  // (or the frame reused) before that write is done
+  bool writing_ = false;
 };
 
+static_assert(sizeof(Page) <= 32, "a frame descriptor must fit half a line");
+
 } // namespace cmudb
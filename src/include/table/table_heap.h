@@ -2,6 +2,10 @@
  * table_heap.h
  *
  * doubly-linked list of heap pages
+ *
+ * Bulk operations pass a BufferAccessStrategy so that their pages only
+ * recycle a small ring of buffer pool frames (sequential scans through
+ * begin() always do).
  */
 
 #pragma once
@@ -30,7 +34,9 @@ public:
             page_id_t first_page_id = INVALID_PAGE_ID);
 
   // for insert, if tuple is too large (>~page_size), return false
-  bool InsertTuple(const Tuple &tuple, RID &rid, Transaction *txn);
+  // a bulk insert passes the same strategy to every call
+  bool InsertTuple(const Tuple &tuple, RID &rid, Transaction *txn,
+                   BufferAccessStrategy *strategy = nullptr);
 
   bool MarkDelete(const RID &rid, Transaction *txn); // for delete
 
@@ -43,7 +49,8 @@ public:
                    Transaction *txn);                    // when commit delete or rollback insert
   void RollbackDelete(const RID &rid, Transaction *txn); // when rollback delete
 
-  bool GetTuple(const RID &rid, Tuple &tuple, Transaction *txn);
+  bool GetTuple(const RID &rid, Tuple &tuple, Transaction *txn,
+                BufferAccessStrategy *strategy = nullptr);
 
   bool DeleteTableHeap();
 
@@ -2,11 +2,21 @@
  * table_iterator.h
  *
  * For seq scan of table heap
+ *
+ * The pages are read through the buffer access strategy of the scan (shared
+ * by the copies of an iterator), so a full scan only recycles a ring of
+ * SCAN_RING_SIZE frames and leaves the rest of the buffer pool alone. The
+ * pages ahead in the chain are read in the background (see
+ * buffer/read_ahead.h).
  */
 
 #pragma once
 
 #include <cassert>
+#include <memory>
+
+#include "buffer/buffer_access_strategy.h"
+#include "buffer/read_ahead.h"
 
 #include "common/rid.h"
 #include "table/tuple.h"
@@ -21,7 +31,8 @@ class TableIterator
   friend class Cursor;
 
 public:
-  TableIterator(TableHeap *table_heap, RID rid, Transaction *txn);
+  TableIterator(TableHeap *table_heap, RID rid, Transaction *txn,
+                std::shared_ptr<BufferAccessStrategy> strategy = nullptr);
 
   ~TableIterator() { delete tuple_; }
 
@@ -47,6 +58,8 @@ private:
   TableHeap *table_heap_;
   Tuple *tuple_;
   Transaction *txn_;
+  std::shared_ptr<BufferAccessStrategy> strategy_;
+  ReadAhead read_ahead_;
 };
 
 } // namespace cmudb
\ No newline at end of file
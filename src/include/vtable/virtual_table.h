@@ -28,6 +28,7 @@ Index *ConstructIndex(IndexMetadata *metadata,
                       BufferPoolManager *buffer_pool_manager,
                       page_id_t root_id = INVALID_PAGE_ID);
 Transaction *GetTransaction();
+size_t GetEnvSize(const char *name, size_t default_value);
 
 /* API declaration */
 int VtabCreate(sqlite3 *db, void *pAux, int argc, const char *const *argv,
@@ -59,6 +60,15 @@ int VtabCommit(sqlite3_vtab *pVTab);
 
 int VtabBegin(sqlite3_vtab *pVTab);
 
+/* SQL functions */
+void PoolResizeFunction(sqlite3_context *ctx, int argc, sqlite3_value **argv);
+
+void PoolSizeFunction(sqlite3_context *ctx, int argc, sqlite3_value **argv);
+
+void PoolMemoryFunction(sqlite3_context *ctx, int argc, sqlite3_value **argv);
+
+void PoolBudgetFunction(sqlite3_context *ctx, int argc, sqlite3_value **argv);
+
 // global parameters
 struct GlobalParameters
 {
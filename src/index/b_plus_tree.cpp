@@ -1,9 +1,12 @@
 /**
  * b_plus_tree.cpp
  */
+#include <algorithm>
+#include <deque>
+#include <fstream>
 #include <iostream>
 #include <string>
-#include <deque>
+#include <thread>
 
 #include "common/exception.h"
 #include "common/logger.h"
@@ -21,11 +24,13 @@ INDEX_TEMPLATE_ARGUMENTS
 BPLUSTREE_TYPE::BPlusTree(const std::string &name,
                           BufferPoolManager *buffer_pool_manager,
                           const KeyComparator &comparator,
-                          page_id_t root_page_id)
+                          page_id_t root_page_id, bool optimistic,
+                          bool blink)
     : index_name_(name),
       root_page_id_(root_page_id),
       buffer_pool_manager_(buffer_pool_manager),
-      comparator_(comparator) {}
+      comparator_(comparator), num_deferred_deletes_(0),
+      optimistic_(optimistic), blink_(blink) {}
 
 /*
  * Helper function to decide whether current b+tree is empty
@@ -50,20 +55,102 @@ bool BPLUSTREE_TYPE::GetValue(const KeyType &key,
 {
   ValueType val;
   bool flag = false;
-  B_PLUS_TREE_LEAF_PAGE_TYPE *leaf_page = FindLeafPage(key);
+  if (optimistic_)
+  {
+    for (int attempt = 0; attempt < OPTIMISTIC_READ_RETRIES; attempt++)
+    {
+      if (!OptimisticLookup(key, val, flag))
+        continue;
+      if (flag)
+        result.push_back(val);
+      return flag;
+    }
+  }
+
+  Page *page = FindLeafPage(key, SearchType::Find, false, transaction);
+  if (page == nullptr)
+    return false;
 
+  B_PLUS_TREE_LEAF_PAGE_TYPE *leaf_page;
+  leaf_page = reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(page->GetData());
   if (leaf_page->Lookup(key, val, comparator_))
   {
     result.push_back(val);
     flag = true;
   }
 
-  Page *page = reinterpret_cast<Page *>(leaf_page);
+  page->RUnlatch();
   buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
 
   return flag;
 }
 
+/*
+ * Point lookup by optimistic lock coupling. A page is only trusted once its
+ * version is validated, so the size of a page is checked before searching
+ * it, and the child of a parent before peeking at it.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_TYPE::OptimisticLookup(const KeyType &key, ValueType &value,
+                                      bool &found)
+{
+  const int leaf_capacity =
+      (PAGE_DATA_SIZE - sizeof(B_PLUS_TREE_LEAF_PAGE_TYPE)) / sizeof(MappingType);
+  const int internal_capacity =
+      (PAGE_DATA_SIZE - sizeof(B_PLUS_TREE_PARENT_PAGE_TYPE)) /
+      sizeof(std::pair<KeyType, page_id_t>);
+
+  page_id_t page_id = root_page_id_;
+  found = false;
+  if (page_id == INVALID_PAGE_ID)
+    return true;
+  uint32_t version;
+  Page *page = buffer_pool_manager_->PeekPage(page_id, version);
+  // the root must not have changed before its version was read
+  if (page == nullptr || root_page_id_ != page_id)
+    return false;
+
+  while (true)
+  {
+    BPlusTreePage *node = reinterpret_cast<BPlusTreePage *>(page->GetData());
+    int size = node->GetSize();
+    page_id_t next_id;
+    if (blink_ && IsBeyondHighKey(node, key, next_id))
+    {
+      if (!page->ValidateVersion(version))
+        return false;
+      Page *next = buffer_pool_manager_->PeekPage(next_id, version);
+      if (next == nullptr)
+        return false;
+      page = next;
+      continue;
+    }
+    if (node->IsLeafPage())
+    {
+      if (size < 0 || size > leaf_capacity)
+        return false;
+      found = reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(node)->Lookup(
+          key, value, comparator_);
+      return page->ValidateVersion(version);
+    }
+    // an internal page in the tree has at least two children
+    if (size < 2 || size > internal_capacity)
+      return false;
+    page_id_t child_id = reinterpret_cast<B_PLUS_TREE_PARENT_PAGE_TYPE *>(node)->Lookup(
+        key, comparator_);
+    if (!page->ValidateVersion(version))
+      return false;
+
+    uint32_t child_version;
+    Page *child = buffer_pool_manager_->PeekPage(child_id, child_version);
+    // the child is still the one to follow when its version was read
+    if (child == nullptr || !page->ValidateVersion(version))
+      return false;
+    page = child;
+    version = child_version;
+  }
+}
+
 /*****************************************************************************
  * INSERTION
  *****************************************************************************/
@@ -78,15 +165,16 @@ INDEX_TEMPLATE_ARGUMENTS
 bool BPLUSTREE_TYPE::Insert(const KeyType &key, const ValueType &value,
                             Transaction *transaction)
 {
-  if (IsEmpty())
-  {
-    StartNewTree(key, value);
-    return true;
-  }
+  Transaction local_transaction(INVALID_TXN_ID);
+  if (transaction == nullptr)
+    transaction = &local_transaction;
+  if (blink_)
+    return InsertBLink(key, value, transaction);
   return InsertIntoLeaf(key, value, transaction);
 }
 /*
- * Insert constant key & value pair into an empty tree
+ * Insert constant key & value pair into an empty tree, root_latch_ must be
+ * write latched
  * User needs to first ask for new page from buffer pool manager(NOTICE: throw
  * an "out of memory" exception if returned value is nullptr), then update b+
  * tree's root page id and insert entry directly into leaf page.
@@ -100,14 +188,15 @@ void BPLUSTREE_TYPE::StartNewTree(const KeyType &key, const ValueType &value)
   if (page == nullptr)
     throw std::bad_alloc();
 
-  root_page_id_ = page_id;
-  UpdateRootPageId();
-
-  B_PLUS_TREE_LEAF_PAGE_TYPE *root = reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(page);
+  B_PLUS_TREE_LEAF_PAGE_TYPE *root = reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(page->GetData());
 
-  root->Init(root_page_id_);
+  root->Init(page_id, INVALID_PAGE_ID, blink_);
   root->Insert(key, value, comparator_);
 
+  // published once filled in, for readers that do not take root_latch_
+  root_page_id_ = page_id;
+  UpdateRootPageId();
+
   buffer_pool_manager_->UnpinPage(page->GetPageId(), true);
 }
 
@@ -116,21 +205,34 @@ void BPLUSTREE_TYPE::StartNewTree(const KeyType &key, const ValueType &value)
  * User needs to first find the right leaf page as insertion target, then look
  * through leaf page to see whether insert key exist or not. If exist, return
  * immdiately, otherwise insert entry. Remember to deal with split if necessary.
+ * The tree is checked for emptiness under root_latch_, so that only one of
+ * several concurrent inserts starts a new tree.
  * @return: since we only support unique key, if user try to insert duplicate
- * keys return false, otherwise return true.
+ * keys return false, otherwise return true. false also if a page on the way
+ * failed its checksum.
  */
 INDEX_TEMPLATE_ARGUMENTS
 bool BPLUSTREE_TYPE::InsertIntoLeaf(const KeyType &key, const ValueType &value,
                                     Transaction *transaction)
 {
-  B_PLUS_TREE_LEAF_PAGE_TYPE *leaf_page = FindLeafPage(key, SearchType::Insert);
-  Page *page = reinterpret_cast<Page *>(leaf_page);
+  Page *page = FindLeafPage(key, SearchType::Insert, false, transaction);
+  if (page == nullptr)
+  {
+    // a page failed its checksum, the latches are already released
+    if (transaction->GetPageSet()->empty())
+      return false;
+    StartNewTree(key, value);
+    ReleaseLatches(transaction, true);
+    return true;
+  }
+  B_PLUS_TREE_LEAF_PAGE_TYPE *leaf_page;
+  leaf_page = reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(page->GetData());
 
   // Check if user insert duplicate keys
   ValueType val;
   if (leaf_page->Lookup(key, val, comparator_))
   {
-    buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
+    ReleaseLatches(transaction, false);
     return false;
   }
 
@@ -140,14 +242,15 @@ bool BPLUSTREE_TYPE::InsertIntoLeaf(const KeyType &key, const ValueType &value,
     int key_position = (leaf_page->GetMaxSize() + 1) / 2;
     InsertIntoParent(leaf_page,
                      leaf_page->KeyAt(key_position),
-                     Split(leaf_page));
+                     Split(leaf_page), transaction);
   }
-  buffer_pool_manager_->UnpinPage(page->GetPageId(), true);
+  ReleaseLatches(transaction, true);
   return true;
 }
 
 /*
- * Split input page and return newly created page.
+ * Split input page and return newly created page (pinned, not latched: it is
+ * only reachable through node and its parent, which are write latched).
  * Using template N to represent either internal page or leaf page.
  * User needs to first ask for new page from buffer pool manager(NOTICE: throw
  * an "out of memory" exception if returned value is nullptr), then move half
@@ -158,11 +261,11 @@ template <typename N>
 N *BPLUSTREE_TYPE::Split(N *node)
 {
   page_id_t new_page_id;
-  Page *new_page = buffer_pool_manager_->NewPage(new_page_id);
+  Page *new_page = buffer_pool_manager_->NewPage(new_page_id, node->GetPageId());
   assert(new_page != nullptr);
 
-  N *new_node = reinterpret_cast<N *>(new_page);
-  new_node->Init(new_page_id, node->GetParentPageId());
+  N *new_node = reinterpret_cast<N *>(new_page->GetData());
+  new_node->Init(new_page_id, node->GetParentPageId(), blink_);
   node->MoveHalfTo(new_node, buffer_pool_manager_);
 
   return new_node;
@@ -176,6 +279,8 @@ N *BPLUSTREE_TYPE::Split(N *node)
  * User needs to first find the parent page of old_node, parent node must be
  * adjusted to take info of new_node into account. Remember to deal with split
  * recursively if necessary.
+ * old_node and, as it was unsafe, its parent are latched in the page set;
+ * new_node is unpinned here.
  */
 INDEX_TEMPLATE_ARGUMENTS
 void BPLUSTREE_TYPE::InsertIntoParent(BPlusTreePage *old_node,
@@ -189,31 +294,27 @@ void BPLUSTREE_TYPE::InsertIntoParent(BPlusTreePage *old_node,
 
   if (old_node->IsRootPage())
   {
-    page = buffer_pool_manager_->NewPage(parent_id);
+    page = buffer_pool_manager_->NewPage(parent_id, old_node->GetPageId());
     assert(page != nullptr);
 
+    // Create new root, published once filled in for optimistic readers
+    parent = reinterpret_cast<B_PLUS_TREE_PARENT_PAGE_TYPE *>(page->GetData());
+    parent->Init(parent_id, INVALID_PAGE_ID, blink_);
+    parent->PopulateNewRoot(old_node->GetPageId(), key, new_node->GetPageId());
     root_page_id_ = parent_id;
     UpdateRootPageId();
-
-    // Create new root
-    parent = reinterpret_cast<B_PLUS_TREE_PARENT_PAGE_TYPE *>(page);
-    parent->Init(parent_id);
-    parent->PopulateNewRoot(old_node->GetPageId(), key, new_node->GetPageId());
     buffer_pool_manager_->UnpinPage(parent_id, true);
 
     // Link old_node and new_node to new root
-    page = reinterpret_cast<Page *>(new_node);
     new_node->SetParentPageId(parent_id);
-    buffer_pool_manager_->UnpinPage(page->GetPageId(), true);
-
-    page = reinterpret_cast<Page *>(old_node);
     old_node->SetParentPageId(parent_id);
-    buffer_pool_manager_->UnpinPage(page->GetPageId(), true);
   }
   else
   {
+    // latched in the page set, so resident
     page = buffer_pool_manager_->FetchPage(parent_id);
-    parent = reinterpret_cast<B_PLUS_TREE_PARENT_PAGE_TYPE *>(page);
+    assert(page != nullptr);
+    parent = reinterpret_cast<B_PLUS_TREE_PARENT_PAGE_TYPE *>(page->GetData());
     parent->InsertNodeAfter(old_node->GetPageId(), key, new_node->GetPageId());
 
     if (parent->GetSize() > parent->GetMaxSize())
@@ -221,17 +322,12 @@ void BPLUSTREE_TYPE::InsertIntoParent(BPlusTreePage *old_node,
       int key_position = (parent->GetMaxSize() + 1) / 2;
       InsertIntoParent(parent,
                        parent->KeyAt(key_position),
-                       Split(parent));
+                       Split(parent), transaction);
     }
 
     buffer_pool_manager_->UnpinPage(page->GetPageId(), true);
-
-    page = reinterpret_cast<Page *>(old_node);
-    buffer_pool_manager_->UnpinPage(page->GetPageId(), true);
-
-    page = reinterpret_cast<Page *>(new_node);
-    buffer_pool_manager_->UnpinPage(page->GetPageId(), true);
   }
+  buffer_pool_manager_->UnpinPage(new_node->GetPageId(), true);
 }
 
 /*****************************************************************************
@@ -243,27 +339,43 @@ void BPLUSTREE_TYPE::InsertIntoParent(BPlusTreePage *old_node,
  * If not, User needs to first find the right leaf page as deletion target, then
  * delete entry from leaf page. Remember to deal with redistribute or merge if
  * necessary.
+ * A page failing its checksum aborts the transaction; if it is a sibling the
+ * entry is still removed and the page is left underfull.
  */
 INDEX_TEMPLATE_ARGUMENTS
 void BPLUSTREE_TYPE::Remove(const KeyType &key, Transaction *transaction)
 {
-  if (IsEmpty())
+  Transaction local_transaction(INVALID_TXN_ID);
+  if (transaction == nullptr)
+    transaction = &local_transaction;
+  if (blink_)
+  {
+    RemoveBLink(key, transaction);
     return;
+  }
 
-  B_PLUS_TREE_LEAF_PAGE_TYPE *leaf_page = FindLeafPage(key, SearchType::Delete);
+  Page *page = FindLeafPage(key, SearchType::Delete, false, transaction);
+  if (page == nullptr)
+  {
+    ReleaseLatches(transaction, false);
+    return;
+  }
+  B_PLUS_TREE_LEAF_PAGE_TYPE *leaf_page;
+  leaf_page = reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(page->GetData());
   int new_size = leaf_page->RemoveAndDeleteRecord(key, comparator_);
 
   if (new_size < leaf_page->GetMinSize())
-    CoalesceOrRedistribute(leaf_page);
+    CoalesceOrRedistribute(leaf_page, transaction);
 
-  Page *page = reinterpret_cast<Page *>(leaf_page);
-  buffer_pool_manager_->UnpinPage(page->GetPageId(), true);
+  ReleaseLatches(transaction, true);
 }
 
 /*
  * User needs to first find the sibling of input page. If sibling's size + input
  * page's size > page's max size, then redistribute. Otherwise, merge.
  * Using template N to represent either internal page or leaf page.
+ * node and its parent are latched in the page set, the sibling is latched
+ * here. Pages removed from the tree go to the deleted page set.
  * @return: true means target leaf page should be deleted, false means no
  * deletion happens
  */
@@ -274,11 +386,13 @@ bool BPLUSTREE_TYPE::CoalesceOrRedistribute(N *node, Transaction *transaction)
   assert(node->GetSize() < node->GetMinSize());
 
   if (node->IsRootPage())
-    return AdjustRoot(node);
+    return AdjustRoot(node, transaction);
 
   B_PLUS_TREE_PARENT_PAGE_TYPE *parent;
+  // latched in the page set, so resident
   Page *parent_page = buffer_pool_manager_->FetchPage(node->GetParentPageId());
-  parent = reinterpret_cast<B_PLUS_TREE_PARENT_PAGE_TYPE *>(parent_page);
+  assert(parent_page != nullptr);
+  parent = reinterpret_cast<B_PLUS_TREE_PARENT_PAGE_TYPE *>(parent_page->GetData());
 
   assert(parent->GetSize() > 1);
 
@@ -289,37 +403,37 @@ bool BPLUSTREE_TYPE::CoalesceOrRedistribute(N *node, Transaction *transaction)
 
   Page *sibling_page = buffer_pool_manager_->FetchPage(
       parent->ValueAt(sibling_id_in_parent));
+  if (sibling_page == nullptr)
+  {
+    transaction->SetState(TransactionState::ABORTED);
+    buffer_pool_manager_->UnpinPage(parent_page->GetPageId(), false);
+    return false;
+  }
 
-  assert(sibling_page != nullptr);
-
-  N *sibling = reinterpret_cast<N *>(sibling_page);
+  sibling_page->WLatch();
+  N *sibling = reinterpret_cast<N *>(sibling_page->GetData());
 
+  bool node_deleted = false;
   if (sibling->GetSize() + node->GetSize() > node->GetMaxSize())
   {
     if (sibling_id_in_parent > node_id_in_parent)
       Redistribute(sibling, node, 0);
     else
       Redistribute(sibling, node, 1);
-
-    buffer_pool_manager_->UnpinPage(parent_page->GetPageId(), true);
-    buffer_pool_manager_->UnpinPage(sibling_page->GetPageId(), true);
-    Page *page = reinterpret_cast<Page *>(node);
-    buffer_pool_manager_->UnpinPage(page->GetPageId(), true);
-
-    return false;
   }
-  if (sibling_id_in_parent < node_id_in_parent)
+  else if (sibling_id_in_parent < node_id_in_parent)
   {
-    Coalesce(sibling, node, parent, INVALID_TXN_ID);
-    return true;
+    Coalesce(sibling, node, parent, node_id_in_parent, transaction);
+    node_deleted = true;
   }
   else
-  {
-    Coalesce(node, sibling, parent, INVALID_TXN_ID);
-    return false;
-  }
+    Coalesce(node, sibling, parent, sibling_id_in_parent, transaction);
 
-} // namespace cmudb
+  sibling_page->WUnlatch();
+  buffer_pool_manager_->UnpinPage(sibling_page->GetPageId(), true);
+  buffer_pool_manager_->UnpinPage(parent_page->GetPageId(), true);
+  return node_deleted;
+}
 
 /*
  * Move all the key & value pairs from one page to its sibling page, and notify
@@ -330,6 +444,7 @@ bool BPLUSTREE_TYPE::CoalesceOrRedistribute(N *node, Transaction *transaction)
  * @param   neighbor_node      sibling page of input "node" (in the left of node)
  * @param   node               input from method coalesceOrRedistribute()
  * @param   parent             parent page of input "node"
+ * @param   index              index of "node" in parent
  * @return  true means parent node should be deleted, false means no deletion
  * happend
  */
@@ -340,23 +455,13 @@ bool BPLUSTREE_TYPE::Coalesce(
     B_PLUS_TREE_PARENT_PAGE_TYPE *&parent,
     int index, Transaction *transaction)
 {
-  node->MoveAllTo(neighbor_node, parent->ValueIndex(node->GetPageId()), buffer_pool_manager_);
-  // Delete node
-  Page *page = reinterpret_cast<Page *>(node);
-  buffer_pool_manager_->UnpinPage(page->GetPageId(), true);
-  buffer_pool_manager_->DeletePage(node->GetPageId());
-
-  page = reinterpret_cast<Page *>(neighbor_node);
-  buffer_pool_manager_->UnpinPage(page->GetPageId(), true);
+  node->MoveAllTo(neighbor_node, index, buffer_pool_manager_);
+  // node is deleted once every latch is released
+  transaction->AddIntoDeletedPageSet(node->GetPageId());
 
   if (parent->GetSize() < parent->GetMinSize())
-    return CoalesceOrRedistribute(parent);
-  else
-  {
-    page = reinterpret_cast<Page *>(parent);
-    buffer_pool_manager_->UnpinPage(page->GetPageId(), true);
-    return false;
-  }
+    return CoalesceOrRedistribute(parent, transaction);
+  return false;
 }
 
 /*
@@ -388,31 +493,31 @@ void BPLUSTREE_TYPE::Redistribute(N *neighbor_node, N *node, int index)
  * happend
  */
 INDEX_TEMPLATE_ARGUMENTS
-bool BPLUSTREE_TYPE::AdjustRoot(BPlusTreePage *old_root_node)
+bool BPLUSTREE_TYPE::AdjustRoot(BPlusTreePage *old_root_node,
+                                Transaction *transaction)
 {
   if (old_root_node->GetSize() == 1)
   {
     if (old_root_node->IsLeafPage())
+      return false;
+    page_id_t new_root_id = reinterpret_cast<B_PLUS_TREE_PARENT_PAGE_TYPE *>(old_root_node)->ValueAt(0);
+    // the old root stays, with a single child, if the new one is corrupt
+    Page *page = buffer_pool_manager_->FetchPage(new_root_id);
+    if (page == nullptr)
     {
-      Page *page = reinterpret_cast<Page *>(old_root_node);
-      buffer_pool_manager_->UnpinPage(page->GetPageId(), true);
-
+      transaction->SetState(TransactionState::ABORTED);
       return false;
     }
-    page_id_t new_root_id = reinterpret_cast<B_PLUS_TREE_PARENT_PAGE_TYPE *>(old_root_node)->ValueAt(0);
     root_page_id_ = new_root_id;
     UpdateRootPageId();
 
     // Update new root
-    Page *page = buffer_pool_manager_->FetchPage(new_root_id);
-    BPlusTreePage *new_root_node = reinterpret_cast<BPlusTreePage *>(page);
+    BPlusTreePage *new_root_node = reinterpret_cast<BPlusTreePage *>(page->GetData());
     new_root_node->SetParentPageId(INVALID_PAGE_ID);
     buffer_pool_manager_->UnpinPage(page->GetPageId(), true);
 
     // Delete old root
-    page = reinterpret_cast<Page *>(old_root_node);
-    buffer_pool_manager_->UnpinPage(page->GetPageId(), true);
-    buffer_pool_manager_->DeletePage(old_root_node->GetPageId());
+    transaction->AddIntoDeletedPageSet(old_root_node->GetPageId());
     return true;
   }
   else if (old_root_node->GetSize() == 0)
@@ -421,19 +526,10 @@ bool BPLUSTREE_TYPE::AdjustRoot(BPlusTreePage *old_root_node)
     UpdateRootPageId();
 
     // Delete old root
-    Page *page;
-    page = reinterpret_cast<Page *>(old_root_node);
-    buffer_pool_manager_->UnpinPage(page->GetPageId(), true);
-    buffer_pool_manager_->DeletePage(page->GetPageId());
-
+    transaction->AddIntoDeletedPageSet(old_root_node->GetPageId());
     return true;
   }
-  else
-  {
-    Page *page = reinterpret_cast<Page *>(old_root_node);
-    buffer_pool_manager_->UnpinPage(page->GetPageId(), true);
-    return false;
-  }
+  return false;
 }
 
 /*****************************************************************************
@@ -447,8 +543,8 @@ bool BPLUSTREE_TYPE::AdjustRoot(BPlusTreePage *old_root_node)
 INDEX_TEMPLATE_ARGUMENTS
 INDEXITERATOR_TYPE BPLUSTREE_TYPE::Begin()
 {
-  B_PLUS_TREE_LEAF_PAGE_TYPE *leaf_page = FindLeafPage(KeyType(), SearchType::Find, true);
-  return INDEXITERATOR_TYPE(buffer_pool_manager_, leaf_page, 0);
+  Page *page = FindLeafPage(KeyType(), SearchType::Find, true);
+  return INDEXITERATOR_TYPE(buffer_pool_manager_, page, 0);
 }
 
 /*
@@ -459,8 +555,306 @@ INDEXITERATOR_TYPE BPLUSTREE_TYPE::Begin()
 INDEX_TEMPLATE_ARGUMENTS
 INDEXITERATOR_TYPE BPLUSTREE_TYPE::Begin(const KeyType &key)
 {
-  B_PLUS_TREE_LEAF_PAGE_TYPE *leaf_page = FindLeafPage(key, SearchType::Find);
-  return INDEXITERATOR_TYPE(buffer_pool_manager_, leaf_page, leaf_page->KeyIndex(key, comparator_));
+  Page *page = FindLeafPage(key, SearchType::Find);
+  if (page == nullptr)
+    return INDEXITERATOR_TYPE(buffer_pool_manager_, page, 0);
+  B_PLUS_TREE_LEAF_PAGE_TYPE *leaf_page;
+  leaf_page = reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(page->GetData());
+  // B-link leaves can be empty, KeyIndex is then -1
+  int offset = leaf_page->GetSize() == 0 ? 0 : leaf_page->KeyIndex(key, comparator_);
+  return INDEXITERATOR_TYPE(buffer_pool_manager_, page, offset);
+}
+
+/*****************************************************************************
+ * B-LINK
+ *****************************************************************************/
+/*
+ * Find the leaf page covering key (or the left most one), holding one latch
+ * at a time: the parent is released before the child is latched, the child
+ * may split meanwhile and the search then moves right. The leaf is returned
+ * pinned and latched (write latched if exclusive), nullptr if the tree is
+ * empty or, with no latch held and the transaction aborted, if a page failed
+ * its checksum.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+Page *BPLUSTREE_TYPE::FindLeafPageBLink(const KeyType &key, bool leftMost,
+                                        bool exclusive,
+                                        Transaction *transaction,
+                                        std::vector<page_id_t> *path)
+{
+  page_id_t page_id = root_page_id_;
+  if (page_id == INVALID_PAGE_ID)
+    return nullptr;
+  // pages are never deleted, an old root is still a page of its level
+  Page *page = buffer_pool_manager_->FetchPage(page_id);
+  if (page == nullptr)
+  {
+    if (transaction != nullptr)
+      transaction->SetState(TransactionState::ABORTED);
+    return nullptr;
+  }
+  page->RLatch();
+  while (true)
+  {
+    bool is_leaf = reinterpret_cast<BPlusTreePage *>(page->GetData())->IsLeafPage();
+    if (is_leaf && exclusive)
+    {
+      page->RUnlatch();
+      page->WLatch();
+    }
+    if (!leftMost)
+      page = MoveRight(page, key, is_leaf && exclusive);
+    if (page == nullptr)
+    {
+      if (transaction != nullptr)
+        transaction->SetState(TransactionState::ABORTED);
+      return nullptr;
+    }
+    if (is_leaf)
+      return page;
+
+    if (path != nullptr)
+      path->push_back(page->GetPageId());
+    B_PLUS_TREE_PARENT_PAGE_TYPE *node;
+    node = reinterpret_cast<B_PLUS_TREE_PARENT_PAGE_TYPE *>(page->GetData());
+    page_id_t next_id = leftMost ? node->ValueAt(0) : node->Lookup(key, comparator_);
+    page->RUnlatch();
+    buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
+
+    page = buffer_pool_manager_->FetchPage(next_id);
+    if (page == nullptr)
+    {
+      if (transaction != nullptr)
+        transaction->SetState(TransactionState::ABORTED);
+      return nullptr;
+    }
+    page->RLatch();
+  }
+}
+
+/*
+ * Follow the right links from a latched page to the page covering key,
+ * releasing each page before latching the next one. nullptr, with no latch
+ * held, if a page failed its checksum.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+Page *BPLUSTREE_TYPE::MoveRight(Page *page, const KeyType &key, bool exclusive)
+{
+  page_id_t next_id;
+  while (IsBeyondHighKey(reinterpret_cast<BPlusTreePage *>(page->GetData()),
+                         key, next_id))
+  {
+    if (exclusive)
+      page->WUnlatch();
+    else
+      page->RUnlatch();
+    buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
+
+    page = buffer_pool_manager_->FetchPage(next_id);
+    if (page == nullptr)
+      return nullptr;
+    if (exclusive)
+      page->WLatch();
+    else
+      page->RLatch();
+  }
+  return page;
+}
+
+/*
+ * Helper to tell whether key belongs to a page right of node, whose id is
+ * then returned in next_page_id
+ */
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_TYPE::IsBeyondHighKey(BPlusTreePage *node, const KeyType &key,
+                                     page_id_t &next_page_id)
+{
+  KeyType high_key;
+  if (node->IsLeafPage())
+  {
+    auto leaf = reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(node);
+    next_page_id = leaf->GetNextPageId();
+    high_key = leaf->GetHighKey();
+  }
+  else
+  {
+    auto internal = reinterpret_cast<B_PLUS_TREE_PARENT_PAGE_TYPE *>(node);
+    next_page_id = internal->GetNextPageId();
+    high_key = internal->GetHighKey();
+  }
+  return next_page_id != INVALID_PAGE_ID && comparator_(key, high_key) >= 0;
+}
+
+/*
+ * Insert into the leaf covering key, then add the pages split on the way up
+ * to their parents, see InsertIntoParentBLink. false if the key exists or a
+ * page on the way to the leaf failed its checksum.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_TYPE::InsertBLink(const KeyType &key, const ValueType &value,
+                                 Transaction *transaction)
+{
+  std::vector<page_id_t> path;
+  Page *page = FindLeafPageBLink(key, false, true, transaction, &path);
+  if (page == nullptr)
+  {
+    if (transaction->GetState() == TransactionState::ABORTED)
+      return false;
+    root_latch_.WLock();
+    bool is_empty = IsEmpty();
+    if (is_empty)
+      StartNewTree(key, value);
+    root_latch_.WUnlock();
+    // another insert started the tree first
+    return is_empty ? true : InsertBLink(key, value, transaction);
+  }
+
+  B_PLUS_TREE_LEAF_PAGE_TYPE *leaf_page;
+  leaf_page = reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(page->GetData());
+  ValueType val;
+  if (leaf_page->Lookup(key, val, comparator_))
+  {
+    page->WUnlatch();
+    buffer_pool_manager_->UnpinPage(page->GetPageId(), false);
+    return false;
+  }
+
+  int new_size = leaf_page->Insert(key, value, comparator_);
+  if (new_size <= leaf_page->GetMaxSize())
+  {
+    page->WUnlatch();
+    buffer_pool_manager_->UnpinPage(page->GetPageId(), true);
+    return true;
+  }
+  KeyType separator;
+  page_id_t new_page_id = SplitBLink(leaf_page, separator);
+  page_id_t page_id = page->GetPageId();
+  page->WUnlatch();
+  buffer_pool_manager_->UnpinPage(page_id, true);
+  InsertIntoParentBLink(page_id, separator, new_page_id, path);
+  return true;
+}
+
+/*
+ * Add new_page_id, split off old_page_id at key, to the parent of
+ * old_page_id, splitting the parents in turn as needed. No latch is held on
+ * entry. The parent is the last page of path, or the page right of it that
+ * covers key. An empty path means old_page_id was the root when the search
+ * passed it: a new root is grown, unless the tree grew meanwhile, in which
+ * case the path is searched again (until the root split by another writer
+ * is published, if old_page_id is the right half of that split). A parent
+ * failing its checksum ends the insert there: the new page stays reachable
+ * through the right link of old_page_id, as between a split and the insert
+ * into the parent.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::InsertIntoParentBLink(page_id_t old_page_id, KeyType key,
+                                           page_id_t new_page_id,
+                                           std::vector<page_id_t> &path)
+{
+  // level of old_page_id, leaves are level 0
+  size_t level = 0;
+  while (true)
+  {
+    if (path.empty())
+    {
+      root_latch_.WLock();
+      if (root_page_id_ == old_page_id)
+      {
+        page_id_t root_page_id;
+        Page *page = buffer_pool_manager_->NewPage(root_page_id, old_page_id);
+        assert(page != nullptr);
+        B_PLUS_TREE_PARENT_PAGE_TYPE *root;
+        root = reinterpret_cast<B_PLUS_TREE_PARENT_PAGE_TYPE *>(page->GetData());
+        root->Init(root_page_id, INVALID_PAGE_ID, blink_);
+        root->PopulateNewRoot(old_page_id, key, new_page_id);
+        root_page_id_ = root_page_id;
+        UpdateRootPageId();
+        root_latch_.WUnlock();
+        buffer_pool_manager_->UnpinPage(root_page_id, true);
+        return;
+      }
+      root_latch_.WUnlock();
+      Page *leaf = FindLeafPageBLink(key, false, false, nullptr, &path);
+      if (leaf == nullptr)
+        return;
+      leaf->RUnlatch();
+      buffer_pool_manager_->UnpinPage(leaf->GetPageId(), false);
+      // old_page_id is the right half of a root split whose new root is not
+      // published yet, so the path does not reach above its level
+      if (path.size() <= level)
+      {
+        path.clear();
+        std::this_thread::yield();
+        continue;
+      }
+      path.resize(path.size() - level);
+    }
+
+    Page *page = buffer_pool_manager_->FetchPage(path.back());
+    if (page == nullptr)
+      return;
+    path.pop_back();
+    page->WLatch();
+    page = MoveRight(page, key, true);
+    if (page == nullptr)
+      return;
+    B_PLUS_TREE_PARENT_PAGE_TYPE *parent;
+    parent = reinterpret_cast<B_PLUS_TREE_PARENT_PAGE_TYPE *>(page->GetData());
+    parent->InsertNode(key, new_page_id, comparator_);
+    if (parent->GetSize() <= parent->GetMaxSize())
+    {
+      page->WUnlatch();
+      buffer_pool_manager_->UnpinPage(page->GetPageId(), true);
+      return;
+    }
+    new_page_id = SplitBLink(parent, key);
+    old_page_id = page->GetPageId();
+    page->WUnlatch();
+    buffer_pool_manager_->UnpinPage(old_page_id, true);
+    level++;
+  }
+}
+
+/*
+ * Split a write latched page: the upper half goes to a new page linked in
+ * right of it, which takes over its right link and high key, while the page
+ * gets the separator (the first key of the new page) as high key.
+ * @return: id of the new page, already unpinned
+ */
+INDEX_TEMPLATE_ARGUMENTS
+template <typename N>
+page_id_t BPLUSTREE_TYPE::SplitBLink(N *node, KeyType &separator)
+{
+  page_id_t next_page_id = node->GetNextPageId();
+  KeyType high_key = node->GetHighKey();
+  separator = node->KeyAt((node->GetMaxSize() + 1) / 2);
+
+  N *new_node = Split(node);
+  new_node->SetNextPageId(next_page_id);
+  new_node->SetHighKey(high_key);
+  node->SetNextPageId(new_node->GetPageId());
+  node->SetHighKey(separator);
+
+  page_id_t new_page_id = new_node->GetPageId();
+  buffer_pool_manager_->UnpinPage(new_page_id, true);
+  return new_page_id;
+}
+
+/*
+ * Remove key from the leaf covering it, pages are never merged
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::RemoveBLink(const KeyType &key, Transaction *transaction)
+{
+  Page *page = FindLeafPageBLink(key, false, true, transaction);
+  if (page == nullptr)
+    return;
+  B_PLUS_TREE_LEAF_PAGE_TYPE *leaf_page;
+  leaf_page = reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(page->GetData());
+  leaf_page->RemoveAndDeleteRecord(key, comparator_);
+  page->WUnlatch();
+  buffer_pool_manager_->UnpinPage(page->GetPageId(), true);
 }
 
 /*****************************************************************************
@@ -469,44 +863,182 @@ INDEXITERATOR_TYPE BPLUSTREE_TYPE::Begin(const KeyType &key)
 
 /*
  * Find leaf page containing particular key, if leftMost flag == true, find
- * the left most leaf page, if wLatchAll == true, acquire WLatch on every page
- * in the path from root to that leaf, 
- * If release == true, release all WLatch from root to that node and return nullptr.
+ * the left most leaf page.
+ * Find crabs down with read latches: the child is latched before the parent
+ * is released. Insert and Delete write latch the path and add it to the page
+ * set of the transaction (root_latch_ first, as nullptr); whenever a child is
+ * safe, the latches above it are released. If the tree is empty, nullptr is
+ * returned and a writer keeps root_latch_. If a page fails its checksum,
+ * every latch is released, the transaction (if any) is aborted and nullptr
+ * is returned.
+ * B-link trees only use it for Find, see FindLeafPageBLink.
  */
 INDEX_TEMPLATE_ARGUMENTS
-B_PLUS_TREE_LEAF_PAGE_TYPE *BPLUSTREE_TYPE::FindLeafPage(const KeyType &key,
-                                                         SearchType option,
-                                                         bool leftMost)
+Page *BPLUSTREE_TYPE::FindLeafPage(const KeyType &key, SearchType option,
+                                   bool leftMost, Transaction *transaction)
 {
+  if (blink_)
+    return FindLeafPageBLink(key, leftMost, false, transaction);
+  bool exclusive = option != SearchType::Find;
+  if (exclusive)
+  {
+    root_latch_.WLock();
+    transaction->AddIntoPageSet(nullptr);
+  }
+  else
+    root_latch_.RLock();
+
+  if (root_page_id_ == INVALID_PAGE_ID)
+  {
+    if (!exclusive)
+      root_latch_.RUnlock();
+    return nullptr;
+  }
+
   Page *current_page = buffer_pool_manager_->FetchPage(root_page_id_);
-  BPlusTreePage *current_node = reinterpret_cast<BPlusTreePage *>(current_page);
+  if (current_page == nullptr)
+  {
+    if (exclusive)
+      ReleaseLatches(transaction, false);
+    else
+      root_latch_.RUnlock();
+    if (transaction != nullptr)
+      transaction->SetState(TransactionState::ABORTED);
+    return nullptr;
+  }
+  BPlusTreePage *current_node = reinterpret_cast<BPlusTreePage *>(current_page->GetData());
+  if (exclusive)
+  {
+    current_page->WLatch();
+    if (IsSafe(current_node, option))
+      ReleaseLatches(transaction, false);
+    transaction->AddIntoPageSet(current_page);
+  }
+  else
+  {
+    current_page->RLatch();
+    root_latch_.RUnlock();
+  }
 
   while (!current_node->IsLeafPage())
   {
     page_id_t next_id;
     B_PLUS_TREE_PARENT_PAGE_TYPE *node;
-    node = reinterpret_cast<B_PLUS_TREE_PARENT_PAGE_TYPE *>(current_page);
+    node = reinterpret_cast<B_PLUS_TREE_PARENT_PAGE_TYPE *>(current_page->GetData());
 
     if (leftMost)
       next_id = node->ValueAt(0);
     else
       next_id = node->Lookup(key, comparator_);
 
-    buffer_pool_manager_->UnpinPage(current_page->GetPageId(), false);
+    Page *next_page = buffer_pool_manager_->FetchPage(next_id);
+    if (next_page == nullptr)
+    {
+      if (exclusive)
+        ReleaseLatches(transaction, false);
+      else
+      {
+        current_page->RUnlatch();
+        buffer_pool_manager_->UnpinPage(current_page->GetPageId(), false);
+      }
+      if (transaction != nullptr)
+        transaction->SetState(TransactionState::ABORTED);
+      return nullptr;
+    }
+    BPlusTreePage *next_node = reinterpret_cast<BPlusTreePage *>(next_page->GetData());
+    if (exclusive)
+    {
+      next_page->WLatch();
+      if (IsSafe(next_node, option))
+        ReleaseLatches(transaction, false);
+      transaction->AddIntoPageSet(next_page);
+    }
+    else
+    {
+      next_page->RLatch();
+      current_page->RUnlatch();
+      buffer_pool_manager_->UnpinPage(current_page->GetPageId(), false);
+    }
 
-    current_page = buffer_pool_manager_->FetchPage(next_id);
-    current_node = reinterpret_cast<BPlusTreePage *>(current_page);
+    current_page = next_page;
+    current_node = next_node;
   }
 
-  B_PLUS_TREE_LEAF_PAGE_TYPE *node;
-  node = reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(current_page);
-  return node;
+  return current_page;
+}
+
+/*
+ * A node is safe if inserting into it cannot split it, or removing from it
+ * cannot make it coalesce, redistribute or change the root.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+bool BPLUSTREE_TYPE::IsSafe(BPlusTreePage *node, SearchType option)
+{
+  if (option == SearchType::Insert)
+    return node->GetSize() < node->GetMaxSize();
+  if (node->IsRootPage())
+    return node->GetSize() > 2;
+  return node->GetSize() > node->GetMinSize();
+}
+
+/*
+ * Release the latches and pins of the page set, top down, then delete the
+ * pages removed from the tree (nobody can reach them anymore, see
+ * DeletePages).
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::ReleaseLatches(Transaction *transaction, bool is_dirty)
+{
+  auto page_set = transaction->GetPageSet();
+  for (Page *page : *page_set)
+  {
+    if (page == nullptr)
+    {
+      root_latch_.WUnlock();
+      continue;
+    }
+    page->WUnlatch();
+    buffer_pool_manager_->UnpinPage(page->GetPageId(), is_dirty);
+  }
+  page_set->clear();
+  DeletePages(transaction);
+}
+
+/*
+ * Delete the pages of the deleted page set. A page can still be pinned by a
+ * thread that reached it before it was removed: a reader between releasing
+ * its latch and unpinning it, or an iterator that pinned it as the next
+ * leaf. DeletePage then fails, so the page is kept aside and deleted again
+ * by a later writer, once unpinned, rather than left allocated on disk.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void BPLUSTREE_TYPE::DeletePages(Transaction *transaction)
+{
+  std::vector<page_id_t> pinned;
+  auto deleted_page_set = transaction->GetDeletedPageSet();
+  for (page_id_t page_id : *deleted_page_set)
+  {
+    if (!buffer_pool_manager_->DeletePage(page_id))
+      pinned.push_back(page_id);
+  }
+  deleted_page_set->clear();
+  if (pinned.empty() && num_deferred_deletes_ == 0)
+    return;
+
+  std::lock_guard<std::mutex> lock(deferred_latch_);
+  auto end = std::remove_if(
+      deferred_deletes_.begin(), deferred_deletes_.end(),
+      [this](page_id_t page_id) { return buffer_pool_manager_->DeletePage(page_id); });
+  deferred_deletes_.erase(end, deferred_deletes_.end());
+  deferred_deletes_.insert(deferred_deletes_.end(), pinned.begin(), pinned.end());
+  num_deferred_deletes_ = deferred_deletes_.size();
 }
 
 /*
  * Update/Insert root page id in header page(where page_id = 0, header_page is
  * defined under include/page/header_page.h)
  * Call this method everytime root page id is changed.
+ * The header page is latched, as it is shared by every index.
  * @parameter: insert_record      defualt value is false. When set to true,
  * insert a record <index_name, root_page_id> into header page instead of
  * updating it.
@@ -514,14 +1046,16 @@ B_PLUS_TREE_LEAF_PAGE_TYPE *BPLUSTREE_TYPE::FindLeafPage(const KeyType &key,
 INDEX_TEMPLATE_ARGUMENTS
 void BPLUSTREE_TYPE::UpdateRootPageId(int insert_record)
 {
-  HeaderPage *header_page = static_cast<HeaderPage *>(
-      buffer_pool_manager_->FetchPage(HEADER_PAGE_ID));
+  Page *page = buffer_pool_manager_->FetchPage(HEADER_PAGE_ID);
+  HeaderPage *header_page = static_cast<HeaderPage *>(page);
+  page->WLatch();
   if (insert_record)
     // create a new record<index_name + root_page_id> in header_page
     header_page->InsertRecord(index_name_, root_page_id_);
   else
     // update root_page_id in header_page
     header_page->UpdateRecord(index_name_, root_page_id_);
+  page->WUnlatch();
   buffer_pool_manager_->UnpinPage(HEADER_PAGE_ID, true);
 }
 
@@ -13,27 +13,39 @@ namespace cmudb
  * set your own input parameters
  */
 INDEX_TEMPLATE_ARGUMENTS
-INDEXITERATOR_TYPE::IndexIterator() {}
+INDEXITERATOR_TYPE::IndexIterator()
+    : buffer_pool_manager_(nullptr), page_(nullptr), leaf_page_(nullptr),
+      offset_(0)
+{
+}
 
 INDEX_TEMPLATE_ARGUMENTS
 INDEXITERATOR_TYPE::IndexIterator(
-    BufferPoolManager *buffer_pool_manager,
-    B_PLUS_TREE_LEAF_PAGE_TYPE *leaf_page,
-    int offset)
-    : buffer_pool_manager_(buffer_pool_manager), leaf_page_(leaf_page), offset_(offset)
+    BufferPoolManager *buffer_pool_manager, Page *page, int offset)
+    : buffer_pool_manager_(buffer_pool_manager), page_(page),
+      leaf_page_(page == nullptr
+                     ? nullptr
+                     : reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(page->GetData())),
+      offset_(offset), read_ahead_(buffer_pool_manager)
 {
+    if (page_ != nullptr)
+        SkipExhaustedLeaves();
 }
 
 INDEX_TEMPLATE_ARGUMENTS
 INDEXITERATOR_TYPE::~IndexIterator()
 {
-    Page *current_page = reinterpret_cast<Page *>(leaf_page_);
-    buffer_pool_manager_->UnpinPage(current_page->GetPageId(), false);
+    if (page_ == nullptr)
+        return;
+    page_->RUnlatch();
+    buffer_pool_manager_->UnpinPage(page_->GetPageId(), false);
 }
 
 INDEX_TEMPLATE_ARGUMENTS
 bool INDEXITERATOR_TYPE::isEnd()
 {
+    if (leaf_page_ == nullptr)
+        return true;
     if (leaf_page_->GetNextPageId() == INVALID_PAGE_ID)
     {
         if (offset_ >= leaf_page_->GetSize())
@@ -52,19 +64,41 @@ INDEX_TEMPLATE_ARGUMENTS
 INDEXITERATOR_TYPE &INDEXITERATOR_TYPE::operator++()
 {
     offset_++;
-    if (isEnd())
-        return *this;
-    if (offset_ == leaf_page_->GetSize())
+    SkipExhaustedLeaves();
+    return *this;
+}
+
+/*
+ * Move to the next leaf as long as offset_ is past the end of the current
+ * one. Leaves may be empty: emptied by a merge (which keeps the next page
+ * id) or, in a B-link tree, by removes. A next leaf that fails its checksum
+ * ends the scan.
+ */
+INDEX_TEMPLATE_ARGUMENTS
+void INDEXITERATOR_TYPE::SkipExhaustedLeaves()
+{
+    while (offset_ >= leaf_page_->GetSize() &&
+           leaf_page_->GetNextPageId() != INVALID_PAGE_ID)
     {
-        Page *current_page = reinterpret_cast<Page *>(leaf_page_);
+        // pinned while the current leaf is latched, but a merge can still
+        // move its entries into the current leaf once that is released:
+        // they are then skipped (see index_iterator.h)
         Page *next_page = buffer_pool_manager_->FetchPage(leaf_page_->GetNextPageId());
 
         offset_ = 0;
-        buffer_pool_manager_->UnpinPage(current_page->GetPageId(), false);
-        leaf_page_ = reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(next_page);
-        return *this;
+        page_->RUnlatch();
+        buffer_pool_manager_->UnpinPage(page_->GetPageId(), false);
+        if (next_page == nullptr)
+        {
+            page_ = nullptr;
+            leaf_page_ = nullptr;
+            return;
+        }
+        next_page->RLatch();
+        page_ = next_page;
+        leaf_page_ = reinterpret_cast<B_PLUS_TREE_LEAF_PAGE_TYPE *>(next_page->GetData());
+        read_ahead_.Advance(leaf_page_->GetPageId(), leaf_page_->GetNextPageId());
     }
-    return *this;
 }
 
 template class IndexIterator<GenericKey<4>, RID, GenericComparator<4>>;
@@ -15,19 +15,62 @@ namespace cmudb
 /*
  * Init method after creating a new internal page
  * Including set page type, set current size, set page id, set parent id and set
- * max page size
+ * max page size (leaving room for the B-link trailer of a B-link tree)
  */
 INDEX_TEMPLATE_ARGUMENTS
 void B_PLUS_TREE_INTERNAL_PAGE_TYPE::Init(page_id_t page_id,
-                                          page_id_t parent_id)
+                                          page_id_t parent_id, bool blink)
 {
   SetPageType(IndexPageType::INTERNAL_PAGE);
   SetSize(0);
-  int max_size = (PAGE_SIZE - sizeof(BPlusTreeInternalPage)) / sizeof(MappingType) - 1;
+  int space = PAGE_DATA_SIZE - sizeof(BPlusTreeInternalPage);
+  if (blink)
+    space -= sizeof(BLinkTrailer);
+  int max_size = space / sizeof(MappingType) - 1;
   SetMaxSize(max_size);
 
   SetParentPageId(parent_id);
   SetPageId(page_id);
+  if (blink)
+    SetNextPageId(INVALID_PAGE_ID);
+}
+
+/*
+ * Helper methods to get/set the right sibling and the high key, at the end
+ * of the page
+ */
+INDEX_TEMPLATE_ARGUMENTS
+typename B_PLUS_TREE_INTERNAL_PAGE_TYPE::BLinkTrailer *
+B_PLUS_TREE_INTERNAL_PAGE_TYPE::Trailer() const
+{
+  char *page =
+      reinterpret_cast<char *>(const_cast<BPlusTreeInternalPage *>(this));
+  return reinterpret_cast<BLinkTrailer *>(page + PAGE_DATA_SIZE -
+                                          sizeof(BLinkTrailer));
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+page_id_t B_PLUS_TREE_INTERNAL_PAGE_TYPE::GetNextPageId() const
+{
+  return Trailer()->next_page_id;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_INTERNAL_PAGE_TYPE::SetNextPageId(page_id_t next_page_id)
+{
+  Trailer()->next_page_id = next_page_id;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+KeyType B_PLUS_TREE_INTERNAL_PAGE_TYPE::GetHighKey() const
+{
+  return Trailer()->high_key;
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_INTERNAL_PAGE_TYPE::SetHighKey(const KeyType &key)
+{
+  Trailer()->high_key = key;
 }
 /*
  * Helper method to get/set the key associated with input "index"(a.k.a
@@ -147,6 +190,25 @@ int B_PLUS_TREE_INTERNAL_PAGE_TYPE::InsertNodeAfter(
   return GetSize();
 }
 
+/*
+ * Insert new_key & new_value pair in key order, for B-link trees where the
+ * child that split may not have been added to this page yet
+ * @return:  new size after insertion
+ */
+INDEX_TEMPLATE_ARGUMENTS
+int B_PLUS_TREE_INTERNAL_PAGE_TYPE::InsertNode(const KeyType &new_key,
+                                               const ValueType &new_value,
+                                               const KeyComparator &comparator)
+{
+  // the first key is invalid, new_key always goes after it
+  int i = GetSize();
+  for (; i > 1 && comparator(array[i - 1].first, new_key) > 0; --i)
+    array[i] = array[i - 1];
+  array[i] = MappingType(new_key, new_value);
+  IncreaseSize(1);
+  return GetSize();
+}
+
 /*****************************************************************************
  * SPLIT
  *****************************************************************************/
@@ -175,7 +237,7 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::CopyHalfFrom(
     page_id_t page_id = array[i].second;
 
     Page *page = buffer_pool_manager->FetchPage(page_id);
-    BPlusTreePage *node = reinterpret_cast<BPlusTreePage *>(page);
+    BPlusTreePage *node = reinterpret_cast<BPlusTreePage *>(page->GetData());
 
     node->SetParentPageId(GetPageId());
     buffer_pool_manager->UnpinPage(page_id, true);
@@ -229,7 +291,7 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::MoveAllTo(
   BPlusTreeInternalPage *parent;
   page_id_t parent_id = GetParentPageId();
   Page *page = buffer_pool_manager->FetchPage(parent_id);
-  parent = reinterpret_cast<BPlusTreeInternalPage *>(page);
+  parent = reinterpret_cast<BPlusTreeInternalPage *>(page->GetData());
 
   parent->Remove(index_in_parent);
   buffer_pool_manager->UnpinPage(parent_id, true);
@@ -245,7 +307,7 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::CopyAllFrom(
     array[GetSize() - 1] = items[i];
     page_id_t page_id = items[i].second;
     Page *page = buffer_pool_manager->FetchPage(page_id);
-    BPlusTreePage *node = reinterpret_cast<BPlusTreePage *>(page);
+    BPlusTreePage *node = reinterpret_cast<BPlusTreePage *>(page->GetData());
 
     node->SetParentPageId(GetPageId());
     buffer_pool_manager->UnpinPage(page->GetPageId(), true);
@@ -272,7 +334,7 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::MoveFirstToEndOf(
   page_id_t parent_id = GetParentPageId();
   Page *page = buffer_pool_manager->FetchPage(parent_id);
 
-  parent = reinterpret_cast<BPlusTreeInternalPage *>(page);
+  parent = reinterpret_cast<BPlusTreeInternalPage *>(page->GetData());
   int index_in_parent = parent->ValueIndex(GetPageId());
   parent->SetKeyAt(index_in_parent, array[0].first);
   buffer_pool_manager->UnpinPage(parent_id, true);
@@ -286,7 +348,7 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::CopyLastFrom(
   array[GetSize() - 1] = pair;
   page_id_t page_id = pair.second;
   Page *page = buffer_pool_manager->FetchPage(page_id);
-  BPlusTreePage *node = reinterpret_cast<BPlusTreePage *>(page);
+  BPlusTreePage *node = reinterpret_cast<BPlusTreePage *>(page->GetData());
 
   node->SetParentPageId(GetPageId());
   buffer_pool_manager->UnpinPage(page_id, true);
@@ -309,7 +371,7 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::MoveLastToFrontOf(
   page_id_t parent_id = GetParentPageId();
   Page *page = buffer_pool_manager->FetchPage(parent_id);
 
-  parent = reinterpret_cast<BPlusTreeInternalPage *>(page);
+  parent = reinterpret_cast<BPlusTreeInternalPage *>(page->GetData());
   int index_in_parent = parent->ValueIndex(recipient->GetPageId());
   parent->SetKeyAt(index_in_parent, recipient->array[0].first);
   buffer_pool_manager->UnpinPage(parent_id, true);
@@ -327,7 +389,7 @@ void B_PLUS_TREE_INTERNAL_PAGE_TYPE::CopyFirstFrom(
 
   page_id_t page_id = pair.second;
   Page *page = buffer_pool_manager->FetchPage(page_id);
-  BPlusTreePage *node = reinterpret_cast<BPlusTreePage *>(page);
+  BPlusTreePage *node = reinterpret_cast<BPlusTreePage *>(page->GetData());
 
   node->SetParentPageId(GetPageId());
   buffer_pool_manager->UnpinPage(page_id, true);
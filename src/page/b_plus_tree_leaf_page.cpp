@@ -19,14 +19,19 @@ namespace cmudb
 /**
  * Init method after creating a new leaf page
  * Including set page type, set current size to zero, set page id/parent id, set
- * next page id and set max size
+ * next page id and set max size (leaving room for the high key of a B-link
+ * tree)
  */
 INDEX_TEMPLATE_ARGUMENTS
-void B_PLUS_TREE_LEAF_PAGE_TYPE::Init(page_id_t page_id, page_id_t parent_id)
+void B_PLUS_TREE_LEAF_PAGE_TYPE::Init(page_id_t page_id, page_id_t parent_id,
+                                      bool blink)
 {
   SetPageType(IndexPageType::LEAF_PAGE);
   SetSize(0);
-  size_t max_size = (PAGE_SIZE - sizeof(BPlusTreeLeafPage)) / sizeof(MappingType) - 1;
+  size_t space = PAGE_DATA_SIZE - sizeof(BPlusTreeLeafPage);
+  if (blink)
+    space -= sizeof(KeyType);
+  size_t max_size = space / sizeof(MappingType) - 1;
   SetMaxSize(max_size);
 
   SetParentPageId(parent_id);
@@ -49,6 +54,25 @@ void B_PLUS_TREE_LEAF_PAGE_TYPE::SetNextPageId(page_id_t next_page_id)
   next_page_id_ = next_page_id;
 }
 
+/*
+ * Helper methods to get/set the high key, at the end of the page
+ */
+INDEX_TEMPLATE_ARGUMENTS
+KeyType *B_PLUS_TREE_LEAF_PAGE_TYPE::HighKeySlot() const
+{
+  char *page = reinterpret_cast<char *>(const_cast<BPlusTreeLeafPage *>(this));
+  return reinterpret_cast<KeyType *>(page + PAGE_DATA_SIZE - sizeof(KeyType));
+}
+
+INDEX_TEMPLATE_ARGUMENTS
+KeyType B_PLUS_TREE_LEAF_PAGE_TYPE::GetHighKey() const { return *HighKeySlot(); }
+
+INDEX_TEMPLATE_ARGUMENTS
+void B_PLUS_TREE_LEAF_PAGE_TYPE::SetHighKey(const KeyType &key)
+{
+  *HighKeySlot() = key;
+}
+
 /**
  * Helper method to find the first index i so that array[i].first >= key
  * NOTE: This method is only used when generating index iterator
@@ -231,7 +255,7 @@ void B_PLUS_TREE_LEAF_PAGE_TYPE::MoveAllTo(BPlusTreeLeafPage *recipient,
   BPlusTreeInternalPage<KeyType, page_id_t, KeyComparator> *parent_page;
   page_id_t parent_id = GetParentPageId();
   Page *page = buffer_pool_manager->FetchPage(parent_id);
-  parent_page = reinterpret_cast<BPlusTreeInternalPage<KeyType, page_id_t, KeyComparator> *>(page);
+  parent_page = reinterpret_cast<BPlusTreeInternalPage<KeyType, page_id_t, KeyComparator> *>(page->GetData());
 
   parent_page->Remove(index_in_parent);
   buffer_pool_manager->UnpinPage(parent_id, true);
@@ -269,7 +293,7 @@ void B_PLUS_TREE_LEAF_PAGE_TYPE::MoveFirstToEndOf(
   page_id_t parent_id = GetParentPageId();
   Page *page = buffer_pool_manager->FetchPage(parent_id);
 
-  parent = reinterpret_cast<BPlusTreeInternalPage<KeyType, page_id_t, KeyComparator> *>(page);
+  parent = reinterpret_cast<BPlusTreeInternalPage<KeyType, page_id_t, KeyComparator> *>(page->GetData());
   int index_in_parent = parent->ValueIndex(GetPageId());
   assert(index_in_parent != -1);
   parent->SetKeyAt(index_in_parent, array[0].first);
@@ -296,7 +320,7 @@ void B_PLUS_TREE_LEAF_PAGE_TYPE::MoveLastToFrontOf(
   page_id_t parent_id = GetParentPageId();
   Page *page = buffer_pool_manager->FetchPage(parent_id);
 
-  parent_page = reinterpret_cast<BPlusTreeInternalPage<KeyType, page_id_t, KeyComparator> *>(page);
+  parent_page = reinterpret_cast<BPlusTreeInternalPage<KeyType, page_id_t, KeyComparator> *>(page->GetData());
   int index_in_parent = parent_page->ValueIndex(recipient->GetPageId());
 
   recipient->IncreaseSize(1);
@@ -20,8 +20,8 @@ bool HeaderPage::InsertRecord(const std::string &name,
 
   int record_num = GetRecordCount();
   int offset = 4 + record_num * 36;
-  // check for duplicate name
-  if (FindRecord(name) != -1)
+  // check for duplicate name and for space
+  if (FindRecord(name) != -1 || offset + 36 > PAGE_DATA_SIZE)
     return false;
   // copy record content
   memcpy(GetData() + offset, name.c_str(), (name.length() + 1));
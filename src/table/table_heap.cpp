@@ -23,22 +23,23 @@ TableHeap::TableHeap(BufferPoolManager *buffer_pool_manager,
     first_page->WLatch();
     LOG_DEBUG("new table page created %d", first_page_id_);
 
-    first_page->Init(first_page_id_, PAGE_SIZE);
+    first_page->Init(first_page_id_, PAGE_DATA_SIZE);
     first_page->WUnlatch();
     buffer_pool_manager_->UnpinPage(first_page_id_, true);
   }
 }
 
-bool TableHeap::InsertTuple(const Tuple &tuple, RID &rid, Transaction *txn)
+bool TableHeap::InsertTuple(const Tuple &tuple, RID &rid, Transaction *txn,
+                            BufferAccessStrategy *strategy)
 {
-  if (tuple.size_ + 28 > PAGE_SIZE)
+  if (tuple.size_ + 28 > PAGE_DATA_SIZE)
   { // larger than one page size
     txn->SetState(TransactionState::ABORTED);
     return false;
   }
 
-  auto cur_page =
-      static_cast<TablePage *>(buffer_pool_manager_->FetchPage(first_page_id_));
+  auto cur_page = static_cast<TablePage *>(
+      buffer_pool_manager_->FetchPage(first_page_id_, strategy));
   if (cur_page == nullptr)
   {
     txn->SetState(TransactionState::ABORTED);
@@ -56,13 +57,18 @@ bool TableHeap::InsertTuple(const Tuple &tuple, RID &rid, Transaction *txn)
       cur_page->WUnlatch();
       buffer_pool_manager_->UnpinPage(cur_page->GetPageId(), false);
       cur_page = static_cast<TablePage *>(
-          buffer_pool_manager_->FetchPage(next_page_id));
+          buffer_pool_manager_->FetchPage(next_page_id, strategy));
+      if (cur_page == nullptr)
+      {
+        txn->SetState(TransactionState::ABORTED);
+        return false;
+      }
       cur_page->WLatch();
     }
     else
     { // create new page
-      auto new_page =
-          static_cast<TablePage *>(buffer_pool_manager_->NewPage(next_page_id));
+      auto new_page = static_cast<TablePage *>(buffer_pool_manager_->NewPage(
+          next_page_id, cur_page->GetPageId(), strategy));
       if (new_page == nullptr)
       {
         cur_page->WUnlatch();
@@ -74,7 +80,7 @@ bool TableHeap::InsertTuple(const Tuple &tuple, RID &rid, Transaction *txn)
       // std::cout << "new table page " << next_page_id << " created" <<
       // std::endl;
       cur_page->SetNextPageId(next_page_id);
-      new_page->Init(next_page_id, PAGE_SIZE, cur_page->GetPageId(),
+      new_page->Init(next_page_id, PAGE_DATA_SIZE, cur_page->GetPageId(),
                      INVALID_PAGE_ID);
       cur_page->WUnlatch();
       buffer_pool_manager_->UnpinPage(cur_page->GetPageId(), true);
@@ -150,10 +156,11 @@ void TableHeap::RollbackDelete(const RID &rid, Transaction *txn)
 }
 
 // called by tuple iterator
-bool TableHeap::GetTuple(const RID &rid, Tuple &tuple, Transaction *txn)
+bool TableHeap::GetTuple(const RID &rid, Tuple &tuple, Transaction *txn,
+                         BufferAccessStrategy *strategy)
 {
   auto page = static_cast<TablePage *>(
-      buffer_pool_manager_->FetchPage(rid.GetPageId()));
+      buffer_pool_manager_->FetchPage(rid.GetPageId(), strategy));
   if (page == nullptr)
   {
     txn->SetState(TransactionState::ABORTED);
@@ -174,8 +181,15 @@ bool TableHeap::DeleteTableHeap()
 
 TableIterator TableHeap::begin(Transaction *txn)
 {
-  auto page =
-      static_cast<TablePage *>(buffer_pool_manager_->FetchPage(first_page_id_));
+  auto strategy = std::make_shared<BufferAccessStrategy>();
+  auto page = static_cast<TablePage *>(
+      buffer_pool_manager_->FetchPage(first_page_id_, strategy.get()));
+  if (page == nullptr)
+  {
+    if (txn != nullptr)
+      txn->SetState(TransactionState::ABORTED);
+    return end();
+  }
   page->RLatch();
   RID rid;
   // if failed (no tuple), rid will be the result of default
@@ -183,7 +197,7 @@ TableIterator TableHeap::begin(Transaction *txn)
   page->GetFirstTupleRid(rid);
   page->RUnlatch();
   buffer_pool_manager_->UnpinPage(first_page_id_, false);
-  return TableIterator(this, rid, txn);
+  return TableIterator(this, rid, txn, strategy);
 }
 
 TableIterator TableHeap::end()
@@ -9,12 +9,15 @@
 namespace cmudb
 {
 
-TableIterator::TableIterator(TableHeap *table_heap, RID rid, Transaction *txn)
-    : table_heap_(table_heap), tuple_(new Tuple(rid)), txn_(txn)
+TableIterator::TableIterator(TableHeap *table_heap, RID rid, Transaction *txn,
+                             std::shared_ptr<BufferAccessStrategy> strategy)
+    : table_heap_(table_heap), tuple_(new Tuple(rid)), txn_(txn),
+      strategy_(strategy),
+      read_ahead_(table_heap->buffer_pool_manager_, strategy.get())
 {
   if (rid.GetPageId() != INVALID_PAGE_ID)
   {
-    table_heap_->GetTuple(tuple_->rid_, *tuple_, txn_);
+    table_heap_->GetTuple(tuple_->rid_, *tuple_, txn_, strategy_.get());
   }
 };
 
@@ -33,10 +36,17 @@ Tuple *TableIterator::operator->()
 TableIterator &TableIterator::operator++()
 {
   BufferPoolManager *buffer_pool_manager = table_heap_->buffer_pool_manager_;
-  auto cur_page = static_cast<TablePage *>(
-      buffer_pool_manager->FetchPage(tuple_->rid_.GetPageId()));
+  auto cur_page = static_cast<TablePage *>(buffer_pool_manager->FetchPage(
+      tuple_->rid_.GetPageId(), strategy_.get()));
+  // a page failing its checksum ends the scan, like GetTuple aborts
+  if (cur_page == nullptr)
+  {
+    if (txn_ != nullptr)
+      txn_->SetState(TransactionState::ABORTED);
+    tuple_->rid_ = RID(INVALID_PAGE_ID, -1);
+    return *this;
+  }
   cur_page->RLatch();
-  assert(cur_page != nullptr); // all pages are pinned
 
   RID next_tuple_rid;
   if (!cur_page->GetNextTupleRid(tuple_->rid_,
@@ -44,12 +54,19 @@ TableIterator &TableIterator::operator++()
   { // end of this page
     while (cur_page->GetNextPageId() != INVALID_PAGE_ID)
     {
-      auto next_page = static_cast<TablePage *>(
-          buffer_pool_manager->FetchPage(cur_page->GetNextPageId()));
+      auto next_page = static_cast<TablePage *>(buffer_pool_manager->FetchPage(
+          cur_page->GetNextPageId(), strategy_.get()));
+      if (next_page == nullptr)
+      {
+        if (txn_ != nullptr)
+          txn_->SetState(TransactionState::ABORTED);
+        break;
+      }
       cur_page->RUnlatch();
       buffer_pool_manager->UnpinPage(cur_page->GetPageId(), false);
       cur_page = next_page;
       cur_page->RLatch();
+      read_ahead_.Advance(cur_page->GetPageId(), cur_page->GetNextPageId());
       if (cur_page->GetFirstTupleRid(next_tuple_rid))
         break;
     }
@@ -58,7 +75,7 @@ TableIterator &TableIterator::operator++()
 
   if (*this != table_heap_->end())
   {
-    table_heap_->GetTuple(tuple_->rid_, *tuple_, txn_);
+    table_heap_->GetTuple(tuple_->rid_, *tuple_, txn_, strategy_.get());
   }
   // release until copy the tuple
   cur_page->RUnlatch();
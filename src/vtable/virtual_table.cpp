@@ -2,6 +2,7 @@
  * virtual_table.cpp
  */
 #include <algorithm>
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
 #include <sys/stat.h>
@@ -337,6 +338,8 @@ int VtabCommit(sqlite3_vtab *pVTab)
   auto transaction_manager = global_parameters->transaction_manager_;
   // invoke transaction manager to delete
   transaction_manager->Commit(transaction);
+  // make it durable according to the durability level
+  global_parameters->buffer_pool_manager_->SyncDirtyPages();
   // when commit, delete transaction pointer and set to null
   delete transaction;
   global_parameters->transaction_ = nullptr;
@@ -344,6 +347,52 @@ int VtabCommit(sqlite3_vtab *pVTab)
   return SQLITE_OK;
 }
 
+/* SQL functions */
+// SELECT vtable_pool_resize(n): resize the buffer pool to n frames, returns
+// the pool size reached (pinned pages may keep it larger)
+void PoolResizeFunction(sqlite3_context *ctx, int argc, sqlite3_value **argv)
+{
+  BufferPoolManager *buffer_pool_manager =
+      global_parameters->buffer_pool_manager_;
+  sqlite3_int64 pool_size = sqlite3_value_int64(argv[0]);
+  if (pool_size < static_cast<sqlite3_int64>(
+                      buffer_pool_manager->GetNumShards()) ||
+      pool_size > static_cast<sqlite3_int64>(
+                      buffer_pool_manager->GetMaxPoolSize()))
+  {
+    std::string message =
+        "pool size must be between " +
+        std::to_string(buffer_pool_manager->GetNumShards()) + " and " +
+        std::to_string(buffer_pool_manager->GetMaxPoolSize()) +
+        " frames (the memory budget)";
+    sqlite3_result_error(ctx, message.c_str(), -1);
+    return;
+  }
+  buffer_pool_manager->Resize(static_cast<size_t>(pool_size));
+  sqlite3_result_int64(ctx, buffer_pool_manager->GetPoolSize());
+}
+
+// SELECT vtable_pool_size(): frames in the buffer pool
+void PoolSizeFunction(sqlite3_context *ctx, int argc, sqlite3_value **argv)
+{
+  sqlite3_result_int64(ctx,
+                       global_parameters->buffer_pool_manager_->GetPoolSize());
+}
+
+// SELECT vtable_pool_memory(), vtable_pool_budget(): bytes of page frames
+// in use, and at most
+void PoolMemoryFunction(sqlite3_context *ctx, int argc, sqlite3_value **argv)
+{
+  sqlite3_result_int64(
+      ctx, global_parameters->buffer_pool_manager_->GetMemoryUsage());
+}
+
+void PoolBudgetFunction(sqlite3_context *ctx, int argc, sqlite3_value **argv)
+{
+  sqlite3_result_int64(
+      ctx, global_parameters->buffer_pool_manager_->GetMemoryBudget());
+}
+
 sqlite3_module VtableModule = {
     0,              /* iVersion */
     VtabCreate,     /* xCreate */
@@ -380,9 +429,13 @@ __declspec(dllexport)
   // to check whether file exist or not
   struct stat buffer;
   bool is_file_exist = (stat(file_name.c_str(), &buffer) == 0);
-  // BufferPoolManager is a global object share by all the virtual tables
-  BufferPoolManager *buffer_pool_manager =
-      new BufferPoolManager(100, file_name);
+  // BufferPoolManager is a global object share by all the virtual tables,
+  // sized from the environment, it can grow up to the memory budget
+  size_t pool_size = GetEnvSize("CMUDB_POOL_SIZE", VTABLE_POOL_SIZE);
+  size_t budget_mb = GetEnvSize("CMUDB_POOL_BUDGET_MB", VTABLE_POOL_BUDGET_MB);
+  BufferPoolManager *buffer_pool_manager = new BufferPoolManager(
+      pool_size, file_name, false, 0, ReplacerType::LRU,
+      (budget_mb << 20) / PAGE_SIZE);
   SQLITE_EXTENSION_INIT2(pApi);
   // create header page from BufferPoolManager if necessary
   page_id_t header_page_id;
@@ -406,6 +459,21 @@ __declspec(dllexport)
   global_parameters->transaction_ = nullptr;
 
   int rc = sqlite3_create_module(db, "vtable", &VtableModule, nullptr);
+  if (rc == SQLITE_OK)
+    rc = sqlite3_create_function(db, "vtable_pool_resize", 1, SQLITE_UTF8,
+                                 nullptr, PoolResizeFunction, nullptr,
+                                 nullptr);
+  if (rc == SQLITE_OK)
+    rc = sqlite3_create_function(db, "vtable_pool_size", 0, SQLITE_UTF8,
+                                 nullptr, PoolSizeFunction, nullptr, nullptr);
+  if (rc == SQLITE_OK)
+    rc = sqlite3_create_function(db, "vtable_pool_memory", 0, SQLITE_UTF8,
+                                 nullptr, PoolMemoryFunction, nullptr,
+                                 nullptr);
+  if (rc == SQLITE_OK)
+    rc = sqlite3_create_function(db, "vtable_pool_budget", 0, SQLITE_UTF8,
+                                 nullptr, PoolBudgetFunction, nullptr,
+                                 nullptr);
   return rc;
 }
 
@@ -604,4 +672,17 @@ Index *ConstructIndex(IndexMetadata *metadata,
 
 Transaction *GetTransaction() { return global_parameters->transaction_; }
 
+// a positive number from the environment, default_value if unset or invalid
+size_t GetEnvSize(const char *name, size_t default_value)
+{
+  const char *value = std::getenv(name);
+  if (value == nullptr)
+    return default_value;
+  char *end = nullptr;
+  unsigned long long size = std::strtoull(value, &end, 10);
+  if (end == value || *end != '\0' || size == 0)
+    return default_value;
+  return static_cast<size_t>(size);
+}
+
 } // namespace cmudb
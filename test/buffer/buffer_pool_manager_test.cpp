@@ -2,9 +2,19 @@
  * buffer_pool_manager_test.cpp
  */
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include "buffer/buffer_pool_manager.h"
+#include "buffer/read_ahead.h"
 #include "gtest/gtest.h"
 
 namespace cmudb
@@ -13,6 +23,7 @@ namespace cmudb
 TEST(BufferPoolManagerTest, SampleTest)
 {
   page_id_t temp_page_id;
+  remove("test.db");
   BufferPoolManager bpm(10, "test.db");
 
   auto page_zero = bpm.NewPage(temp_page_id);
@@ -52,4 +63,801 @@ TEST(BufferPoolManagerTest, SampleTest)
   remove("test.db");
 }
 
+TEST(BufferPoolManagerTest, DirectIOTest)
+{
+  page_id_t temp_page_id;
+  remove("test.db");
+  {
+    BufferPoolManager bpm(5, "test.db", true);
+    // far more pages than frames, so most of them go through disk
+    for (int i = 0; i < 20; ++i)
+    {
+      Page *page = bpm.NewPage(temp_page_id);
+      ASSERT_NE(nullptr, page);
+      EXPECT_EQ(i, temp_page_id);
+      EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(page->GetData()) % PAGE_SIZE);
+      strcpy(page->GetData(), ("page " + std::to_string(i)).c_str());
+      EXPECT_EQ(true, bpm.UnpinPage(temp_page_id, true));
+    }
+    for (int i = 0; i < 20; ++i)
+    {
+      Page *page = bpm.FetchPage(i);
+      ASSERT_NE(nullptr, page);
+      EXPECT_EQ("page " + std::to_string(i), std::string(page->GetData()));
+      EXPECT_EQ(true, bpm.UnpinPage(i, false));
+    }
+  }
+  // the destructor flushed everything, reopen in buffered mode
+  BufferPoolManager bpm(5, "test.db");
+  Page *page = bpm.FetchPage(19);
+  ASSERT_NE(nullptr, page);
+  EXPECT_EQ("page 19", std::string(page->GetData()));
+  bpm.UnpinPage(19, false);
+
+  remove("test.db");
+}
+
+// pages spread over the shards, and a shard running out of frames does not
+// leak the page id it was asked for
+TEST(BufferPoolManagerTest, ShardTest)
+{
+  page_id_t temp_page_id;
+  remove("test.db");
+  BufferPoolManager bpm(4 * MIN_SHARD_FRAMES, "test.db");
+  EXPECT_EQ(4u, bpm.GetNumShards());
+  for (int i = 0; i < 4 * MIN_SHARD_FRAMES; ++i)
+  {
+    ASSERT_NE(nullptr, bpm.NewPage(temp_page_id));
+    EXPECT_EQ(i, temp_page_id);
+  }
+  EXPECT_EQ(nullptr, bpm.NewPage(temp_page_id));
+  EXPECT_EQ(true, bpm.UnpinPage(2, true));
+  // page 2 of shard 2 is the only victim: the new page skips the ids of the
+  // full shards 0 and 1, which are given back
+  ASSERT_NE(nullptr, bpm.NewPage(temp_page_id));
+  EXPECT_EQ(4 * MIN_SHARD_FRAMES + 2, temp_page_id);
+  EXPECT_EQ(nullptr, bpm.NewPage(temp_page_id));
+  EXPECT_EQ(true, bpm.UnpinPage(temp_page_id, false));
+  ASSERT_NE(nullptr, bpm.NewPage(temp_page_id));
+  EXPECT_EQ(4 * MIN_SHARD_FRAMES + 6, temp_page_id);
+  remove("test.db");
+}
+
+// every replacement policy evicts unpinned pages only and reads them back
+TEST(BufferPoolManagerTest, ReplacerTypeTest)
+{
+  for (ReplacerType replacer_type : {ReplacerType::LRU, ReplacerType::CLOCK,
+                                     ReplacerType::CLOCK_PRO,
+                                     ReplacerType::TWO_QUEUE})
+  {
+    page_id_t temp_page_id;
+    remove("test.db");
+    BufferPoolManager bpm(10, "test.db", false, 0, replacer_type);
+    for (int i = 0; i < 30; ++i)
+    {
+      Page *page = bpm.NewPage(temp_page_id);
+      ASSERT_NE(nullptr, page);
+      snprintf(page->GetData(), PAGE_SIZE, "page %d", temp_page_id);
+      // the first 5 pages stay pinned
+      if (i >= 5)
+      {
+        EXPECT_EQ(true, bpm.UnpinPage(temp_page_id, true));
+      }
+    }
+    for (page_id_t page_id = 0; page_id < 30; ++page_id)
+    {
+      Page *page = bpm.FetchPage(page_id);
+      ASSERT_NE(nullptr, page);
+      EXPECT_EQ("page " + std::to_string(page_id),
+                std::string(page->GetData()));
+      EXPECT_EQ(true, bpm.UnpinPage(page_id, false));
+    }
+  }
+  remove("test.db");
+}
+
+// once their rings are filled, a scan and a bulk insert only recycle their
+// own frames and leave the other pages of the pool in place
+TEST(BufferPoolManagerTest, AccessStrategyTest)
+{
+  const int pool_size = 64;
+  const int num_hot = 32;
+  const int num_pages = 200;
+  page_id_t temp_page_id;
+  remove("test.db");
+  BufferPoolManager bpm(pool_size, "test.db");
+  for (int i = 0; i < num_pages; ++i)
+  {
+    Page *page = bpm.NewPage(temp_page_id);
+    ASSERT_NE(nullptr, page);
+    snprintf(page->GetData(), PAGE_SIZE, "page %d", temp_page_id);
+    bpm.UnpinPage(temp_page_id, true);
+  }
+
+  BufferAccessStrategy scan_strategy;
+  BufferAccessStrategy bulk_insert_strategy;
+  page_id_t next_page_id = num_pages;
+  for (int round = 0; round < 3; ++round)
+  {
+    uint64_t num_misses = bpm.GetNumMisses();
+    for (page_id_t page_id = 0; page_id < num_hot; ++page_id)
+    {
+      ASSERT_NE(nullptr, bpm.FetchPage(page_id));
+      bpm.UnpinPage(page_id, false);
+    }
+    // the hot pages stayed in the pool during the previous round, except the
+    // first one in which the rings took their frames
+    if (round > 1)
+    {
+      EXPECT_EQ(num_misses, bpm.GetNumMisses());
+    }
+
+    for (page_id_t page_id = num_hot; page_id < next_page_id; ++page_id)
+    {
+      Page *page = bpm.FetchPage(page_id, &scan_strategy);
+      ASSERT_NE(nullptr, page);
+      EXPECT_EQ("page " + std::to_string(page_id),
+                std::string(page->GetData()));
+      bpm.UnpinPage(page_id, false);
+    }
+    // dirty pages of a bulk insert are written back as the ring wraps
+    for (int i = 0; i < num_pages; ++i)
+    {
+      Page *page = bpm.NewPage(temp_page_id, INVALID_PAGE_ID,
+                               &bulk_insert_strategy);
+      ASSERT_NE(nullptr, page);
+      EXPECT_EQ(next_page_id++, temp_page_id);
+      snprintf(page->GetData(), PAGE_SIZE, "page %d", temp_page_id);
+      bpm.UnpinPage(temp_page_id, true);
+    }
+  }
+  remove("test.db");
+}
+
+// the ring of a scan still recycles its frames when the number of shards
+// does not divide the ring size
+TEST(BufferPoolManagerTest, AccessStrategyShardsTest)
+{
+  const int pool_size = 192;
+  const int num_hot = 96;
+  const int num_pages = 600;
+  page_id_t temp_page_id;
+  remove("test.db");
+  BufferPoolManager bpm(pool_size, "test.db");
+  ASSERT_EQ(3u, bpm.GetNumShards());
+  for (int i = 0; i < num_pages; ++i)
+  {
+    Page *page = bpm.NewPage(temp_page_id);
+    ASSERT_NE(nullptr, page);
+    snprintf(page->GetData(), PAGE_SIZE, "page %d", temp_page_id);
+    bpm.UnpinPage(temp_page_id, true);
+  }
+
+  BufferAccessStrategy scan_strategy;
+  for (page_id_t page_id = 0; page_id < num_hot; ++page_id)
+  {
+    ASSERT_NE(nullptr, bpm.FetchPage(page_id));
+    bpm.UnpinPage(page_id, false);
+  }
+  for (page_id_t page_id = num_hot; page_id < num_pages; ++page_id)
+  {
+    Page *page = bpm.FetchPage(page_id, &scan_strategy);
+    ASSERT_NE(nullptr, page);
+    EXPECT_EQ("page " + std::to_string(page_id), std::string(page->GetData()));
+    bpm.UnpinPage(page_id, false);
+  }
+  uint64_t num_misses = bpm.GetNumMisses();
+  for (page_id_t page_id = 0; page_id < num_hot; ++page_id)
+  {
+    ASSERT_NE(nullptr, bpm.FetchPage(page_id));
+    bpm.UnpinPage(page_id, false);
+  }
+  EXPECT_EQ(num_misses, bpm.GetNumMisses());
+  remove("test.db");
+}
+
+// prefetched pages are there when fetched, unallocated pages are skipped
+TEST(BufferPoolManagerTest, PrefetchTest)
+{
+  const int pool_size = 64;
+  const int num_pages = 200;
+  page_id_t temp_page_id;
+  remove("test.db");
+  BufferPoolManager bpm(pool_size, "test.db");
+  for (int i = 0; i < num_pages; ++i)
+  {
+    Page *page = bpm.NewPage(temp_page_id);
+    ASSERT_NE(nullptr, page);
+    snprintf(page->GetData(), PAGE_SIZE, "page %d", temp_page_id);
+    bpm.UnpinPage(temp_page_id, true);
+  }
+
+  for (page_id_t page_id = 0; page_id < 16; ++page_id)
+    bpm.PrefetchPage(page_id);
+  bpm.PrefetchPage(num_pages);
+  uint64_t num_misses = bpm.GetNumMisses();
+  for (page_id_t page_id = 0; page_id < 16; ++page_id)
+  {
+    Page *page = bpm.FetchPage(page_id);
+    ASSERT_NE(nullptr, page);
+    EXPECT_EQ("page " + std::to_string(page_id), std::string(page->GetData()));
+    bpm.UnpinPage(page_id, false);
+  }
+  EXPECT_EQ(num_misses, bpm.GetNumMisses());
+
+  // a new page is not shadowed by a stale prefetched copy
+  Page *page = bpm.NewPage(temp_page_id);
+  ASSERT_NE(nullptr, page);
+  EXPECT_EQ(num_pages, temp_page_id);
+  bpm.UnpinPage(temp_page_id, false);
+  remove("test.db");
+}
+
+// cold scan of a chain of consecutive pages with direct I/O, without and
+// with read ahead
+TEST(BufferPoolManagerTest, ReadAheadBenchmark)
+{
+  const int pool_size = 128;
+  const int num_pages = 4096;
+  page_id_t temp_page_id;
+  remove("test.db");
+  for (bool read_ahead_on : {false, true})
+  {
+    BufferPoolManager bpm(pool_size, "test.db", true);
+    if (!read_ahead_on)
+    {
+      for (int i = 0; i < num_pages; ++i)
+      {
+        ASSERT_NE(nullptr, bpm.NewPage(temp_page_id));
+        bpm.UnpinPage(temp_page_id, true);
+      }
+      bpm.FlushAllPages();
+      // start cold
+      for (int i = 0; i < pool_size; ++i)
+      {
+        ASSERT_NE(nullptr, bpm.NewPage(temp_page_id));
+        bpm.UnpinPage(temp_page_id, false);
+      }
+    }
+    ReadAhead read_ahead(read_ahead_on ? &bpm : nullptr);
+    auto start = std::chrono::steady_clock::now();
+    for (page_id_t page_id = 0; page_id < num_pages; ++page_id)
+    {
+      ASSERT_NE(nullptr, bpm.FetchPage(page_id));
+      read_ahead.Advance(page_id, page_id + 1 < num_pages ? page_id + 1
+                                                          : INVALID_PAGE_ID);
+      bpm.UnpinPage(page_id, false);
+    }
+    double ms = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+    std::cout << "read ahead " << (read_ahead_on ? "on" : "off") << ": "
+              << num_pages * PAGE_SIZE / 1024.0 / ms << " MB/s" << std::endl;
+  }
+  remove("test.db");
+}
+
+// point lookups (an index path: one of a few internal pages, then one of
+// the leaves) interleaved with a sequential scan of a large heap, hit ratio
+// of the lookups and overall for each replacement policy
+TEST(BufferPoolManagerTest, ScanResistanceBenchmark)
+{
+  const int pool_size = 100;
+  const int num_internal = 10;
+  const int num_leaves = 60;
+  const int num_heap_pages = 2000;
+  const int num_steps = 6000;
+  const char *names[] = {"LRU", "CLOCK", "CLOCK-Pro", "2Q"};
+  int name_index = 0;
+  for (ReplacerType replacer_type : {ReplacerType::LRU, ReplacerType::CLOCK,
+                                     ReplacerType::CLOCK_PRO,
+                                     ReplacerType::TWO_QUEUE})
+  {
+    page_id_t temp_page_id;
+    remove("test.db");
+    BufferPoolManager bpm(pool_size, "test.db", false, 0, replacer_type);
+    for (int i = 0; i < num_internal + num_leaves + num_heap_pages; ++i)
+    {
+      ASSERT_NE(nullptr, bpm.NewPage(temp_page_id));
+      bpm.UnpinPage(temp_page_id, true);
+    }
+
+    unsigned int seed = 1;
+    uint64_t lookups = 0, lookup_misses = 0;
+    uint64_t start_hits = bpm.GetNumHits();
+    uint64_t start_misses = bpm.GetNumMisses();
+    for (int step = 0; step < num_steps; ++step)
+    {
+      page_id_t heap_page_id =
+          num_internal + num_leaves + step % num_heap_pages;
+      ASSERT_NE(nullptr, bpm.FetchPage(heap_page_id));
+      bpm.UnpinPage(heap_page_id, false);
+      for (int lookup = 0; lookup < 2; ++lookup)
+      {
+        uint64_t misses = bpm.GetNumMisses();
+        page_id_t internal_page_id = rand_r(&seed) % num_internal;
+        page_id_t leaf_page_id = num_internal + rand_r(&seed) % num_leaves;
+        ASSERT_NE(nullptr, bpm.FetchPage(internal_page_id));
+        ASSERT_NE(nullptr, bpm.FetchPage(leaf_page_id));
+        bpm.UnpinPage(leaf_page_id, false);
+        bpm.UnpinPage(internal_page_id, false);
+        lookups += 2;
+        lookup_misses += bpm.GetNumMisses() - misses;
+      }
+    }
+    uint64_t hits = bpm.GetNumHits() - start_hits;
+    uint64_t misses = bpm.GetNumMisses() - start_misses;
+    std::cout << names[name_index++] << ": lookup hit ratio "
+              << 1.0 - double(lookup_misses) / lookups
+              << ", overall hit ratio " << double(hits) / (hits + misses)
+              << std::endl;
+  }
+  remove("test.db");
+}
+
+// threads fetching and unpinning random pages, with a single latch for the
+// whole pool and with the default shards
+TEST(BufferPoolManagerTest, ConcurrentFetchBenchmark)
+{
+  const int pool_size = 1024;
+  const int num_pages = 2048;
+  const int num_ops = 20000;
+  for (size_t num_shards : {size_t(1), size_t(0)})
+  {
+    remove("test.db");
+    BufferPoolManager bpm(pool_size, "test.db", false, num_shards);
+    page_id_t temp_page_id;
+    for (int i = 0; i < num_pages; ++i)
+    {
+      ASSERT_NE(nullptr, bpm.NewPage(temp_page_id));
+      bpm.UnpinPage(temp_page_id, true);
+    }
+    for (int num_threads = 1; num_threads <= 8; num_threads *= 2)
+    {
+      std::vector<std::thread> threads;
+      auto start = std::chrono::steady_clock::now();
+      for (int tid = 0; tid < num_threads; tid++)
+      {
+        threads.push_back(std::thread([&bpm, tid]() {
+          unsigned int seed = tid;
+          for (int i = 0; i < num_ops; i++)
+          {
+            // 3 out of 4 accesses go to the hottest quarter of the pages
+            page_id_t page_id = rand_r(&seed) % (num_pages / 4);
+            if (i % 4 == 0)
+              page_id = rand_r(&seed) % num_pages;
+            Page *page = bpm.FetchPage(page_id);
+            if (page != nullptr)
+              bpm.UnpinPage(page_id, false);
+          }
+        }));
+      }
+      for (auto &t : threads)
+        t.join();
+      auto end = std::chrono::steady_clock::now();
+      double ms = std::chrono::duration<double, std::milli>(end - start).count();
+      std::cout << bpm.GetNumShards() << " shards, " << num_threads
+                << " threads: " << num_threads * num_ops / ms << " ops/ms"
+                << std::endl;
+    }
+  }
+  remove("test.db");
+}
+
+// threads missing on the same pages get a single copy of each, and dirty
+// victims written back with the latch released are read back intact
+TEST(BufferPoolManagerTest, ConcurrentMissTest)
+{
+  const int pool_size = 16;
+  const int num_pages = 64;
+  const int num_threads = 8;
+  remove("test.db");
+  BufferPoolManager bpm(pool_size, "test.db");
+  page_id_t temp_page_id;
+  for (int i = 0; i < num_pages; ++i)
+  {
+    Page *page = bpm.NewPage(temp_page_id);
+    ASSERT_NE(nullptr, page);
+    *reinterpret_cast<int *>(page->GetData()) = 0;
+    bpm.UnpinPage(temp_page_id, true);
+  }
+
+  // every thread fetches all the pages in the same order, so the misses on
+  // a page overlap; each adds one to a counter on the page
+  std::vector<std::thread> threads;
+  for (int tid = 0; tid < num_threads; tid++)
+  {
+    threads.push_back(std::thread([&bpm]() {
+      for (page_id_t page_id = 0; page_id < num_pages; ++page_id)
+      {
+        Page *page = bpm.FetchPage(page_id);
+        EXPECT_NE(nullptr, page);
+        if (page == nullptr)
+          continue;
+        EXPECT_EQ(page_id, page->GetPageId());
+        page->WLatch();
+        (*reinterpret_cast<int *>(page->GetData()))++;
+        page->WUnlatch();
+        bpm.UnpinPage(page_id, true);
+      }
+    }));
+  }
+  for (auto &t : threads)
+    t.join();
+
+  for (page_id_t page_id = 0; page_id < num_pages; ++page_id)
+  {
+    Page *page = bpm.FetchPage(page_id);
+    ASSERT_NE(nullptr, page);
+    EXPECT_EQ(num_threads, *reinterpret_cast<int *>(page->GetData()));
+    bpm.UnpinPage(page_id, false);
+  }
+  remove("test.db");
+}
+
+// latency of hits on a resident page, alone and while another thread keeps
+// missing (direct I/O, so every miss goes to the device)
+TEST(BufferPoolManagerTest, HitLatencyBenchmark)
+{
+  const int pool_size = 64;
+  const int num_pages = 1024;
+  const int num_hits = 20000;
+  remove("test.db");
+  BufferPoolManager bpm(pool_size, "test.db", true, 1);
+  page_id_t temp_page_id;
+  for (int i = 0; i < num_pages; ++i)
+  {
+    ASSERT_NE(nullptr, bpm.NewPage(temp_page_id));
+    bpm.UnpinPage(temp_page_id, true);
+  }
+  bpm.FlushAllPages();
+  Page *hot_page = bpm.FetchPage(0);
+  ASSERT_NE(nullptr, hot_page);
+
+  for (bool with_misses : {false, true})
+  {
+    std::atomic<bool> stop(false);
+    std::thread miss_thread;
+    if (with_misses)
+    {
+      miss_thread = std::thread([&bpm, &stop]() {
+        unsigned int seed = 1;
+        while (!stop)
+        {
+          page_id_t page_id = 1 + rand_r(&seed) % (num_pages - 1);
+          if (bpm.FetchPage(page_id) != nullptr)
+            bpm.UnpinPage(page_id, true);
+        }
+      });
+    }
+    double total_us = 0, max_us = 0;
+    for (int i = 0; i < num_hits; i++)
+    {
+      auto start = std::chrono::steady_clock::now();
+      EXPECT_EQ(hot_page, bpm.FetchPage(0));
+      bpm.UnpinPage(0, false);
+      double us = std::chrono::duration<double, std::micro>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+      total_us += us;
+      max_us = std::max(max_us, us);
+    }
+    stop = true;
+    if (with_misses)
+      miss_thread.join();
+    std::cout << (with_misses ? "with" : "without")
+              << " concurrent misses: hit avg " << total_us / num_hits
+              << " us, max " << max_us << " us" << std::endl;
+  }
+  bpm.UnpinPage(0, false);
+  remove("test.db");
+}
+
+// hits on random pages of a large pool, each reading the cache lines a
+// binary search of the page would (as a B+ tree traversal does), with the
+// frames and their metadata on 4 KiB and on huge pages. Rounds alternate
+// between the two pools, the best round of each counts.
+TEST(BufferPoolManagerTest, HugePageBenchmark)
+{
+  const int pool_size = 32768;
+  const int num_rounds = 5;
+  const int num_hits = 400000;
+  remove("test.db");
+  remove("test2.db");
+  BufferPoolManager small_pages(pool_size, "test.db", false, 0,
+                                ReplacerType::CLOCK, 0, HugePages::NONE);
+  BufferPoolManager huge_pages(pool_size, "test2.db", false, 0,
+                               ReplacerType::CLOCK, 0, HugePages::TRANSPARENT);
+  BufferPoolManager *pools[] = {&small_pages, &huge_pages};
+  double best_ns[] = {1e9, 1e9};
+  for (BufferPoolManager *bpm : pools)
+  {
+    page_id_t temp_page_id;
+    for (int i = 0; i < pool_size; ++i)
+    {
+      ASSERT_NE(nullptr, bpm->NewPage(temp_page_id));
+      bpm->UnpinPage(temp_page_id, false);
+    }
+  }
+
+  uint64_t sum = 0;
+  for (int round = 0; round < num_rounds; round++)
+  {
+    for (int p = 0; p < 2; p++)
+    {
+      BufferPoolManager *bpm = pools[p];
+      unsigned int seed = round + 1;
+      auto start = std::chrono::steady_clock::now();
+      for (int i = 0; i < num_hits; i++)
+      {
+        page_id_t page_id = rand_r(&seed) % pool_size;
+        Page *page = bpm->FetchPage(page_id);
+        for (int offset = PAGE_SIZE / 2; offset >= 64; offset /= 2)
+          sum += page->GetData()[offset + (i & 63)];
+        bpm->UnpinPage(page_id, false);
+      }
+      double ns = std::chrono::duration<double, std::nano>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+      best_ns[p] = std::min(best_ns[p], ns / num_hits);
+    }
+  }
+  EXPECT_EQ(0u, sum);
+  EXPECT_EQ(0u, small_pages.GetNumMisses() + huge_pages.GetNumMisses());
+  std::cout << "hit avg: 4 KiB pages " << best_ns[0] << " ns, "
+            << (huge_pages.GetHugePages() == HugePages::NONE
+                    ? "huge pages (unavailable) "
+                    : "huge pages ")
+            << best_ns[1] << " ns" << std::endl;
+  remove("test.db");
+  remove("test2.db");
+}
+
+// checkpoints of a large pool with few dirty pages, as commits taken often
+// see it: the cost is the sweep over the frame descriptors
+TEST(BufferPoolManagerTest, DirtyPageSweepBenchmark)
+{
+  const int pool_size = 65536;
+  const int num_checkpoints = 200;
+  remove("test.db");
+  BufferPoolManager bpm(pool_size, "test.db", false, 0, ReplacerType::CLOCK);
+  page_id_t temp_page_id;
+  for (int i = 0; i < pool_size; ++i)
+  {
+    ASSERT_NE(nullptr, bpm.NewPage(temp_page_id));
+    bpm.UnpinPage(temp_page_id, false);
+  }
+  bpm.FlushAllPages();
+
+  unsigned int seed = 1;
+  double total_us = 0;
+  for (int i = 0; i < num_checkpoints; i++)
+  {
+    for (int j = 0; j < 4; j++)
+    {
+      page_id_t page_id = rand_r(&seed) % pool_size;
+      ASSERT_NE(nullptr, bpm.FetchPage(page_id));
+      bpm.UnpinPage(page_id, true);
+    }
+    auto start = std::chrono::steady_clock::now();
+    bpm.Checkpoint();
+    total_us += std::chrono::duration<double, std::micro>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+  }
+  EXPECT_EQ(0u, bpm.GetNumMisses());
+  std::cout << "frame descriptor " << sizeof(Page) << " bytes, checkpoint avg "
+            << total_us / num_checkpoints << " us" << std::endl;
+  remove("test.db");
+}
+
+// the background writer cleans the next victims, so the misses that follow
+// do not write back, and the pages it wrote read back intact
+TEST(BufferPoolManagerTest, BackgroundWriterTest)
+{
+  const int pool_size = 64;
+  remove("test.db");
+  BufferPoolManager bpm(pool_size, "test.db", false, 1);
+  page_id_t temp_page_id;
+  for (int i = 0; i < pool_size; ++i)
+  {
+    Page *page = bpm.NewPage(temp_page_id);
+    ASSERT_NE(nullptr, page);
+    *reinterpret_cast<int *>(page->GetData()) = i;
+    bpm.UnpinPage(temp_page_id, true);
+  }
+  bpm.StartBackgroundWriter(std::chrono::milliseconds(1), pool_size,
+                            std::chrono::milliseconds(0));
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  bpm.StopBackgroundWriter();
+
+  for (int i = 0; i < pool_size; ++i)
+  {
+    ASSERT_NE(nullptr, bpm.NewPage(temp_page_id));
+    bpm.UnpinPage(temp_page_id, false);
+  }
+  EXPECT_EQ(0u, bpm.GetNumDirtyEvictions());
+  for (page_id_t page_id = 0; page_id < pool_size; ++page_id)
+  {
+    Page *page = bpm.FetchPage(page_id);
+    ASSERT_NE(nullptr, page);
+    EXPECT_EQ(page_id, *reinterpret_cast<int *>(page->GetData()));
+    bpm.UnpinPage(page_id, false);
+  }
+  remove("test.db");
+}
+
+// a checkpoint writes the unpinned dirty pages, a pinned one is left dirty
+TEST(BufferPoolManagerTest, CheckpointTest)
+{
+  const int pool_size = 64;
+  remove("test.db");
+  BufferPoolManager bpm(pool_size, "test.db", false, 4);
+  page_id_t temp_page_id;
+  for (int i = 0; i < pool_size; ++i)
+  {
+    Page *page = bpm.NewPage(temp_page_id);
+    ASSERT_NE(nullptr, page);
+    *reinterpret_cast<int *>(page->GetData()) = i;
+    bpm.UnpinPage(temp_page_id, true);
+  }
+  Page *pinned_page = bpm.FetchPage(0);
+  ASSERT_NE(nullptr, pinned_page);
+  bpm.Checkpoint();
+  bpm.UnpinPage(0, true);
+
+  for (int i = 0; i < pool_size; ++i)
+  {
+    ASSERT_NE(nullptr, bpm.NewPage(temp_page_id));
+    bpm.UnpinPage(temp_page_id, false);
+  }
+  EXPECT_EQ(1u, bpm.GetNumDirtyEvictions());
+  for (page_id_t page_id = 0; page_id < pool_size; ++page_id)
+  {
+    Page *page = bpm.FetchPage(page_id);
+    ASSERT_NE(nullptr, page);
+    EXPECT_EQ(page_id, *reinterpret_cast<int *>(page->GetData()));
+    bpm.UnpinPage(page_id, false);
+  }
+  remove("test.db");
+}
+
+// the pool grows without evicting, shrinks by writing back unpinned pages
+// and never below its pinned pages
+TEST(BufferPoolManagerTest, ResizeTest)
+{
+  const int pool_size = 64;
+  const int max_pool_size = 256;
+  remove("test.db");
+  BufferPoolManager bpm(pool_size, "test.db", false, 4, ReplacerType::LRU,
+                        max_pool_size);
+  EXPECT_EQ(static_cast<size_t>(pool_size) * PAGE_SIZE, bpm.GetMemoryUsage());
+  EXPECT_EQ(static_cast<size_t>(max_pool_size) * PAGE_SIZE,
+            bpm.GetMemoryBudget());
+  EXPECT_EQ(false, bpm.Resize(max_pool_size + 1));
+  EXPECT_EQ(false, bpm.Resize(2));
+
+  page_id_t temp_page_id;
+  for (int i = 0; i < pool_size; ++i)
+  {
+    Page *page = bpm.NewPage(temp_page_id);
+    ASSERT_NE(nullptr, page);
+    *reinterpret_cast<int *>(page->GetData()) = i;
+    bpm.UnpinPage(temp_page_id, true);
+  }
+  EXPECT_EQ(true, bpm.Resize(max_pool_size));
+  EXPECT_EQ(static_cast<size_t>(max_pool_size), bpm.GetPoolSize());
+  for (int i = pool_size; i < max_pool_size; ++i)
+  {
+    Page *page = bpm.NewPage(temp_page_id);
+    ASSERT_NE(nullptr, page);
+    *reinterpret_cast<int *>(page->GetData()) = i;
+    bpm.UnpinPage(temp_page_id, true);
+  }
+  EXPECT_EQ(0u, bpm.GetNumDirtyEvictions());
+
+  // a pinned page stays put while the pool shrinks around it
+  Page *pinned_page = bpm.FetchPage(0);
+  ASSERT_NE(nullptr, pinned_page);
+  EXPECT_EQ(true, bpm.Resize(32));
+  EXPECT_EQ(32u, bpm.GetPoolSize());
+  EXPECT_EQ(32u * PAGE_SIZE, bpm.GetMemoryUsage());
+  EXPECT_EQ(pinned_page, bpm.FetchPage(0));
+  bpm.UnpinPage(0, false);
+  bpm.UnpinPage(0, false);
+
+  // every frame pinned: the pool cannot shrink
+  for (page_id_t page_id = 0; page_id < 32; ++page_id)
+    ASSERT_NE(nullptr, bpm.FetchPage(page_id));
+  EXPECT_EQ(nullptr, bpm.FetchPage(32));
+  EXPECT_EQ(false, bpm.Resize(16));
+  EXPECT_EQ(32u, bpm.GetPoolSize());
+  for (page_id_t page_id = 0; page_id < 32; ++page_id)
+    bpm.UnpinPage(page_id, false);
+
+  // fetches go on while the pool is resized
+  std::atomic<bool> stop(false);
+  std::atomic<int> errors(0);
+  std::thread reader([&]() {
+    unsigned int seed = 1;
+    while (!stop)
+    {
+      page_id_t page_id = rand_r(&seed) % max_pool_size;
+      Page *page = bpm.FetchPage(page_id);
+      if (page == nullptr)
+        continue;
+      if (*reinterpret_cast<int *>(page->GetData()) != page_id)
+        errors++;
+      bpm.UnpinPage(page_id, false);
+    }
+  });
+  for (int i = 0; i < 50; ++i)
+    bpm.Resize(i % 2 == 0 ? 16 : max_pool_size);
+  stop = true;
+  reader.join();
+  EXPECT_EQ(0, errors);
+
+  EXPECT_EQ(true, bpm.Resize(16));
+  for (page_id_t page_id = 0; page_id < max_pool_size; ++page_id)
+  {
+    Page *page = bpm.FetchPage(page_id);
+    ASSERT_NE(nullptr, page);
+    EXPECT_EQ(page_id, *reinterpret_cast<int *>(page->GetData()));
+    bpm.UnpinPage(page_id, false);
+  }
+  remove("test.db");
+}
+
+// updates of random pages (direct I/O): share of the misses that had to
+// write back a dirty victim, and fetch latency, without and with the
+// background writer
+TEST(BufferPoolManagerTest, BackgroundWriterBenchmark)
+{
+  const int pool_size = 256;
+  const int num_pages = 1024;
+  const int num_updates = 20000;
+  for (bool background : {false, true})
+  {
+    remove("test.db");
+    BufferPoolManager bpm(pool_size, "test.db", true);
+    page_id_t temp_page_id;
+    for (int i = 0; i < num_pages; ++i)
+    {
+      ASSERT_NE(nullptr, bpm.NewPage(temp_page_id));
+      bpm.UnpinPage(temp_page_id, true);
+    }
+    bpm.FlushAllPages();
+    if (background)
+      bpm.StartBackgroundWriter();
+    uint64_t misses = bpm.GetNumMisses();
+    uint64_t dirty_evictions = bpm.GetNumDirtyEvictions();
+
+    unsigned int seed = 1;
+    double total_us = 0;
+    for (int i = 0; i < num_updates; i++)
+    {
+      page_id_t page_id = rand_r(&seed) % num_pages;
+      auto start = std::chrono::steady_clock::now();
+      Page *page = bpm.FetchPage(page_id);
+      total_us += std::chrono::duration<double, std::micro>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+      ASSERT_NE(nullptr, page);
+      (*reinterpret_cast<int *>(page->GetData()))++;
+      bpm.UnpinPage(page_id, true);
+    }
+    misses = bpm.GetNumMisses() - misses;
+    dirty_evictions = bpm.GetNumDirtyEvictions() - dirty_evictions;
+    std::cout << (background ? "with" : "without")
+              << " background writer: " << dirty_evictions << " of " << misses
+              << " misses wrote back, fetch avg " << total_us / num_updates
+              << " us" << std::endl;
+    if (background)
+    {
+      EXPECT_LT(dirty_evictions, misses / 2);
+    }
+  }
+  remove("test.db");
+}
+
 } // namespace cmudb
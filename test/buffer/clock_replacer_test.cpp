@@ -0,0 +1,156 @@
+/**
+ * clock_replacer_test.cpp
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "buffer/clock_pro_replacer.h"
+#include "buffer/clock_replacer.h"
+#include "buffer/lru_replacer.h"
+#include "gtest/gtest.h"
+
+namespace cmudb
+{
+
+TEST(ClockReplacerTest, SampleTest)
+{
+  ClockReplacer<int> clock_replacer(0, 6);
+
+  for (int i = 0; i < 6; ++i)
+    clock_replacer.Insert(i);
+  EXPECT_EQ(6, clock_replacer.Size());
+
+  // the first sweep clears every reference bit
+  int value;
+  EXPECT_EQ(true, clock_replacer.Victim(value));
+  EXPECT_EQ(0, value);
+  EXPECT_EQ(true, clock_replacer.Victim(value));
+  EXPECT_EQ(1, value);
+  // second chance for 2
+  clock_replacer.Insert(2);
+  EXPECT_EQ(true, clock_replacer.Victim(value));
+  EXPECT_EQ(3, value);
+
+  EXPECT_EQ(true, clock_replacer.Erase(4));
+  EXPECT_EQ(false, clock_replacer.Erase(4));
+  EXPECT_EQ(2, clock_replacer.Size());
+
+  EXPECT_EQ(true, clock_replacer.Victim(value));
+  EXPECT_EQ(5, value);
+  EXPECT_EQ(true, clock_replacer.Victim(value));
+  EXPECT_EQ(2, value);
+  EXPECT_EQ(false, clock_replacer.Victim(value));
+}
+
+TEST(ClockProReplacerTest, SampleTest)
+{
+  // values are their own key: a value evicted and inserted again is a page
+  // coming back
+  ClockProReplacer<int> clock_pro_replacer(0, 4);
+  for (int i = 0; i < 4; ++i)
+    clock_pro_replacer.Insert(i);
+  EXPECT_EQ(4, clock_pro_replacer.Size());
+  EXPECT_EQ(2, clock_pro_replacer.GetColdTarget());
+
+  int value;
+  EXPECT_EQ(true, clock_pro_replacer.Victim(value));
+  EXPECT_EQ(0, value);
+  // 0 comes back in its test period: hot at once, and more cold pages wanted
+  clock_pro_replacer.Insert(0);
+  EXPECT_EQ(3, clock_pro_replacer.GetColdTarget());
+  // 1 is referenced in its test period: hot
+  clock_pro_replacer.Insert(1);
+  EXPECT_EQ(true, clock_pro_replacer.Victim(value));
+  EXPECT_EQ(2, value);
+  EXPECT_EQ(true, clock_pro_replacer.Victim(value));
+  EXPECT_EQ(3, value);
+
+  // only hot pages left, beyond the hot target: demoted, then evicted
+  EXPECT_EQ(true, clock_pro_replacer.Erase(1));
+  EXPECT_EQ(false, clock_pro_replacer.Erase(1));
+  EXPECT_EQ(1, clock_pro_replacer.Size());
+  EXPECT_EQ(true, clock_pro_replacer.Victim(value));
+  EXPECT_EQ(0, value);
+  EXPECT_EQ(false, clock_pro_replacer.Victim(value));
+}
+
+// the next victims announced are the ones taken, and peeking changes nothing
+TEST(ClockReplacerTest, PeekVictimsTest)
+{
+  ClockReplacer<int> clock_replacer(0, 6);
+  LRUReplacer<int> lru_replacer;
+  for (int i = 0; i < 6; ++i)
+  {
+    clock_replacer.Insert(i);
+    lru_replacer.Insert(i);
+  }
+  int value;
+  EXPECT_EQ(true, clock_replacer.Victim(value));
+  // 1 and 3 referenced again, 4 pinned
+  for (int i : {1, 3})
+  {
+    clock_replacer.Insert(i);
+    lru_replacer.Insert(i);
+  }
+  clock_replacer.Erase(4);
+  lru_replacer.Erase(4);
+
+  for (Replacer<int> *replacer :
+       std::vector<Replacer<int> *>{&clock_replacer, &lru_replacer})
+  {
+    std::vector<int> peeked;
+    replacer->PeekVictims(peeked, 3);
+    EXPECT_EQ(3u, peeked.size());
+    replacer->PeekVictims(peeked, 10);
+    for (size_t i = 0; i < 3; ++i)
+      EXPECT_EQ(peeked[i], peeked[3 + i]);
+    for (size_t i = 3; i < peeked.size(); ++i)
+    {
+      EXPECT_EQ(true, replacer->Victim(value));
+      EXPECT_EQ(peeked[i], value);
+    }
+    EXPECT_EQ(false, replacer->Victim(value));
+  }
+}
+
+// pin/unpin (Erase/Insert) of random frames with a victim now and then
+TEST(ClockReplacerTest, ReplacerBenchmark)
+{
+  const int num_frames = 4096;
+  const int num_ops = 1000000;
+  LRUReplacer<int> lru_replacer;
+  ClockReplacer<int> clock_replacer(0, num_frames);
+  ClockProReplacer<int> clock_pro_replacer(0, num_frames);
+  Replacer<int> *replacers[] = {&lru_replacer, &clock_replacer,
+                                &clock_pro_replacer};
+  const char *names[] = {"LRU", "CLOCK", "CLOCK-Pro"};
+
+  for (int r = 0; r < 3; ++r)
+  {
+    Replacer<int> *replacer = replacers[r];
+    for (int i = 0; i < num_frames; ++i)
+      replacer->Insert(i);
+    unsigned int seed = 1;
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < num_ops; ++i)
+    {
+      int value = rand_r(&seed) % num_frames;
+      if (i % 8 == 0)
+        EXPECT_EQ(true, replacer->Victim(value));
+      else
+        replacer->Erase(value);
+      replacer->Insert(value);
+    }
+    auto end = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(end - start).count();
+    EXPECT_EQ(num_frames, replacer->Size());
+    std::cout << names[r] << ": " << ns / num_ops << " ns per pin/unpin"
+              << std::endl;
+  }
+}
+
+} // namespace cmudb
@@ -0,0 +1,72 @@
+/**
+ * frame_memory_test.cpp
+ */
+
+#include <cstdint>
+#include <cstdio>
+
+#include "buffer/buffer_pool_manager.h"
+#include "buffer/frame_memory.h"
+#include "gtest/gtest.h"
+
+namespace cmudb
+{
+
+// frames are zeroed and huge page aligned whatever pages back them
+TEST(FrameMemoryTest, MapTest)
+{
+  const size_t length = 3 * HUGE_PAGE_SIZE + PAGE_SIZE;
+  for (HugePages huge_pages :
+       {HugePages::NONE, HugePages::TRANSPARENT, HugePages::EXPLICIT})
+  {
+    HugePages used = huge_pages;
+    char *frames = MapFrames(length, used);
+    // explicit huge pages fall back to transparent ones, never the reverse
+    if (huge_pages != HugePages::EXPLICIT)
+    {
+      EXPECT_TRUE(used == huge_pages || used == HugePages::NONE);
+    }
+    EXPECT_EQ(0u, reinterpret_cast<uintptr_t>(frames) % HUGE_PAGE_SIZE);
+    for (size_t i = 0; i < length; i += PAGE_SIZE)
+    {
+      EXPECT_EQ(0, frames[i]);
+      frames[i] = 1;
+    }
+    DiscardFrames(frames, PAGE_SIZE, used);
+    if (used != HugePages::EXPLICIT)
+    {
+      EXPECT_EQ(0, frames[0]);
+    }
+    UnmapFrames(frames, length);
+  }
+  EXPECT_FALSE(GetNumaNodes().empty());
+}
+
+// shards bound to NUMA nodes keep working, on a single node too
+TEST(FrameMemoryTest, NumaLocalPoolTest)
+{
+  const int pool_size = 256;
+  remove("test.db");
+  BufferPoolManager bpm(pool_size, "test.db", false, 4, ReplacerType::LRU,
+                        2 * pool_size, HugePages::EXPLICIT, true);
+  page_id_t temp_page_id;
+  for (int i = 0; i < pool_size; ++i)
+  {
+    Page *page = bpm.NewPage(temp_page_id);
+    ASSERT_NE(nullptr, page);
+    *reinterpret_cast<int *>(page->GetData()) = i;
+    bpm.UnpinPage(temp_page_id, true);
+  }
+  EXPECT_EQ(true, bpm.Resize(2 * pool_size));
+  EXPECT_EQ(true, bpm.Resize(pool_size / 2));
+  for (page_id_t page_id = 0; page_id < pool_size; ++page_id)
+  {
+    Page *page = bpm.FetchPage(page_id);
+    ASSERT_NE(nullptr, page);
+    EXPECT_EQ(page_id, *reinterpret_cast<int *>(page->GetData()));
+    bpm.UnpinPage(page_id, false);
+  }
+  remove("test.db");
+}
+
+} // namespace cmudb
@@ -0,0 +1,113 @@
+/**
+ * page_table_test.cpp
+ */
+
+#include <atomic>
+#include <cstdlib>
+#include <map>
+#include <thread>
+#include <vector>
+
+#include "buffer/page_table.h"
+#include "gtest/gtest.h"
+
+namespace cmudb
+{
+
+// random inserts and removes checked against a std::map, so entries moved
+// back by a removal are still found
+TEST(PageTableTest, SampleTest)
+{
+  const size_t num_frames = 64;
+  Page *frames = new Page[num_frames];
+  PageTable page_table(frames, num_frames);
+  std::map<page_id_t, Page *> expected;
+  unsigned int seed = 1;
+  for (int i = 0; i < 100000; i++)
+  {
+    // keys of one shard out of 16, as the buffer pool hands them out
+    page_id_t page_id = (rand_r(&seed) % 512) * 16 + 3;
+    auto it = expected.find(page_id);
+    if (it != expected.end())
+    {
+      EXPECT_EQ(true, page_table.Remove(page_id));
+      expected.erase(it);
+    }
+    else if (expected.size() < 2 * num_frames)
+    {
+      Page *frame = &frames[rand_r(&seed) % num_frames];
+      page_table.Insert(page_id, frame);
+      expected[page_id] = frame;
+    }
+    if (i % 1000 == 0)
+    {
+      for (page_id_t key = 3; key < 512 * 16; key += 16)
+      {
+        Page *frame = nullptr;
+        bool found = page_table.Find(key, frame);
+        EXPECT_EQ(expected.count(key) == 1, found);
+        if (found)
+        {
+          EXPECT_EQ(expected[key], frame);
+        }
+      }
+    }
+  }
+  EXPECT_EQ(false, page_table.Remove(-1));
+  delete[] frames;
+}
+
+// readers never miss a page mapped all along, while a writer keeps inserting
+// and removing others around it
+TEST(PageTableTest, ConcurrentFindTest)
+{
+  const size_t num_frames = 64;
+  const page_id_t num_stable = 32;
+  Page *frames = new Page[num_frames];
+  PageTable page_table(frames, num_frames);
+  for (page_id_t page_id = 0; page_id < num_stable; page_id++)
+    page_table.Insert(page_id, &frames[page_id]);
+
+  std::atomic<bool> stop(false);
+  std::thread writer([&]() {
+    unsigned int seed = 2;
+    std::vector<page_id_t> mapped;
+    while (!stop)
+    {
+      if (mapped.size() < num_frames)
+      {
+        page_id_t page_id = num_stable + rand_r(&seed) % 10000;
+        page_table.Insert(page_id, &frames[num_stable]);
+        mapped.push_back(page_id);
+      }
+      else
+      {
+        for (page_id_t page_id : mapped)
+          page_table.Remove(page_id);
+        mapped.clear();
+      }
+    }
+  });
+  std::vector<std::thread> readers;
+  std::atomic<int> misses(0);
+  for (int tid = 0; tid < 2; tid++)
+  {
+    readers.push_back(std::thread([&]() {
+      for (int i = 0; i < 200000; i++)
+      {
+        page_id_t page_id = i % num_stable;
+        Page *frame = nullptr;
+        if (!page_table.Find(page_id, frame) || frame != &frames[page_id])
+          misses++;
+      }
+    }));
+  }
+  for (auto &t : readers)
+    t.join();
+  stop = true;
+  writer.join();
+  EXPECT_EQ(0, misses);
+  delete[] frames;
+}
+
+} // namespace cmudb
@@ -0,0 +1,54 @@
+/**
+ * two_queue_replacer_test.cpp
+ */
+
+#include <cstdio>
+
+#include "buffer/two_queue_replacer.h"
+#include "gtest/gtest.h"
+
+namespace cmudb
+{
+
+TEST(TwoQueueReplacerTest, SampleTest)
+{
+  // values are their own key: a value evicted and inserted again is a page
+  // coming back. A1in aims at 1 page, A1out remembers 2
+  TwoQueueReplacer<int> two_queue_replacer(0, 4);
+  for (int i = 0; i < 4; ++i)
+    two_queue_replacer.Insert(i);
+  EXPECT_EQ(4, two_queue_replacer.Size());
+
+  int value;
+  EXPECT_EQ(true, two_queue_replacer.Victim(value));
+  EXPECT_EQ(0, value);
+  // 0 comes back while remembered in A1out: goes to Am
+  two_queue_replacer.Insert(0);
+  // touching 1 again keeps it in A1in
+  two_queue_replacer.Insert(1);
+  EXPECT_EQ(true, two_queue_replacer.Victim(value));
+  EXPECT_EQ(2, value);
+  EXPECT_EQ(true, two_queue_replacer.Victim(value));
+  EXPECT_EQ(3, value);
+  // A1in is down to its target, Am is used
+  EXPECT_EQ(true, two_queue_replacer.Victim(value));
+  EXPECT_EQ(0, value);
+
+  // 2 and 3 come back from A1out, 0 was evicted from Am so it is new again
+  two_queue_replacer.Insert(2);
+  two_queue_replacer.Insert(3);
+  two_queue_replacer.Insert(0);
+  EXPECT_EQ(4, two_queue_replacer.Size());
+  EXPECT_EQ(true, two_queue_replacer.Erase(1));
+  EXPECT_EQ(false, two_queue_replacer.Erase(1));
+  // A1in (1 pinned, 0) is over its target
+  EXPECT_EQ(true, two_queue_replacer.Victim(value));
+  EXPECT_EQ(0, value);
+  EXPECT_EQ(true, two_queue_replacer.Victim(value));
+  EXPECT_EQ(2, value);
+  EXPECT_EQ(true, two_queue_replacer.Victim(value));
+  EXPECT_EQ(3, value);
+  EXPECT_EQ(false, two_queue_replacer.Victim(value));
+}
+
+} // namespace cmudb
@@ -0,0 +1,56 @@
+/**
+ * crc32c_test.cpp
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "common/crc32c.h"
+#include "gtest/gtest.h"
+
+namespace cmudb
+{
+
+TEST(Crc32cTest, KnownValueTest)
+{
+  // check values from RFC 3720
+  EXPECT_EQ(0xe3069283u, Crc32c("123456789", 9));
+  char zeros[32];
+  memset(zeros, 0, sizeof(zeros));
+  EXPECT_EQ(0x8a9136aau, Crc32c(zeros, sizeof(zeros)));
+  char ones[32];
+  memset(ones, 0xff, sizeof(ones));
+  EXPECT_EQ(0x62a8ab43u, Crc32c(ones, sizeof(ones)));
+}
+
+TEST(Crc32cTest, IncrementalTest)
+{
+  std::string data = "The quick brown fox jumps over the lazy dog";
+  uint32_t whole = Crc32c(data.c_str(), data.size());
+  // any split point, including ones not on a word boundary
+  for (size_t split = 0; split <= data.size(); split++)
+  {
+    uint32_t crc = Crc32c(data.c_str(), split);
+    crc = Crc32c(data.c_str() + split, data.size() - split, crc);
+    EXPECT_EQ(whole, crc);
+  }
+}
+
+// large buffers take the interleaved path, byte by byte must agree with it
+TEST(Crc32cTest, LargeBufferTest)
+{
+  std::string data(3 * 4096 + 13, 0);
+  unsigned int seed = 42;
+  for (auto &c : data)
+    c = static_cast<char>(rand_r(&seed));
+  for (size_t len : {size_t(768), size_t(3072), size_t(4092), data.size()})
+  {
+    uint32_t crc = 0;
+    for (size_t i = 0; i < len; i++)
+      crc = Crc32c(&data[i], 1, crc);
+    EXPECT_EQ(crc, Crc32c(data.c_str(), len));
+  }
+}
+
+} // namespace cmudb
@@ -0,0 +1,82 @@
+/**
+ * lz_codec_test.cpp
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "common/lz_codec.h"
+#include "gtest/gtest.h"
+
+namespace cmudb
+{
+
+static void RoundTrip(const std::string &data, bool expect_smaller)
+{
+  std::vector<char> compressed(data.size() + data.size() / 255 + 16);
+  size_t length =
+      LzCompress(data.data(), data.size(), compressed.data(), compressed.size());
+  ASSERT_GT(length, 0u);
+  if (expect_smaller)
+  {
+    EXPECT_LT(length, data.size() / 2);
+  }
+  std::string out(data.size(), 'x');
+  EXPECT_TRUE(LzDecompress(compressed.data(), length, &out[0], out.size()));
+  EXPECT_EQ(data, out);
+}
+
+TEST(LzCodecTest, RoundTripTest)
+{
+  RoundTrip("", false);
+  RoundTrip("abc", false);
+  RoundTrip(std::string(4096, 0), true);
+  // fixed width integers and repeated strings, like a table page
+  std::string rows;
+  for (int i = 0; rows.size() < 4096; i++)
+  {
+    rows.append(reinterpret_cast<const char *>(&i), sizeof(i));
+    rows.append(i % 3 == 0 ? "pending" : "shipped");
+  }
+  RoundTrip(rows, true);
+  // incompressible
+  std::string noise(4096, 0);
+  unsigned int seed = 7;
+  for (auto &c : noise)
+    c = static_cast<char>(rand_r(&seed));
+  RoundTrip(noise, false);
+}
+
+TEST(LzCodecTest, CapacityTest)
+{
+  std::string noise(1000, 0);
+  unsigned int seed = 9;
+  for (auto &c : noise)
+    c = static_cast<char>(rand_r(&seed));
+  char compressed[500];
+  EXPECT_EQ(0u, LzCompress(noise.data(), noise.size(), compressed,
+                           sizeof(compressed)));
+}
+
+// damaged input must fail cleanly, never read or write out of bounds
+TEST(LzCodecTest, MalformedInputTest)
+{
+  std::string data(4096, 'a');
+  char compressed[4096];
+  size_t length = LzCompress(data.data(), data.size(), compressed, 4096);
+  ASSERT_GT(length, 0u);
+  std::string out(data.size(), 0);
+  EXPECT_FALSE(LzDecompress(compressed, length - 1, &out[0], out.size()));
+  EXPECT_FALSE(LzDecompress(compressed, length, &out[0], out.size() - 1));
+  unsigned int seed = 11;
+  for (int i = 0; i < 1000; i++)
+  {
+    std::string damaged(compressed, length);
+    damaged[rand_r(&seed) % length] = static_cast<char>(rand_r(&seed));
+    LzDecompress(damaged.data(), damaged.size(), &out[0], out.size());
+  }
+}
+
+} // namespace cmudb
@@ -2,7 +2,9 @@
  * rwmutex_test.cpp
  */
 
+#include <atomic>
 #include <thread>
+#include <vector>
 
 #include "common/rwmutex.h"
 #include "gtest/gtest.h"
@@ -61,4 +63,71 @@ TEST(RWMutexTest, BasicTest)
   }
   EXPECT_EQ(counter.Read(), 55);
 }
+
+// readers never see a writer inside, writers never see anyone else inside,
+// and no thread sleeps through the unlock it waits for
+TEST(RWMutexTest, FutexTest)
+{
+  FutexRWMutex mutex;
+  EXPECT_EQ(4u, sizeof(mutex));
+  std::atomic<int> readers(0);
+  std::atomic<int> writers(0);
+  std::atomic<int> errors(0);
+  int count = 0;
+  std::vector<std::thread> threads;
+  for (int tid = 0; tid < 8; tid++)
+  {
+    threads.push_back(std::thread([&, tid]() {
+      for (int i = 0; i < 20000; i++)
+      {
+        if ((i + tid) % 4 == 0)
+        {
+          mutex.WLock();
+          if (writers.fetch_add(1) != 0 || readers != 0)
+            errors++;
+          count++;
+          writers--;
+          mutex.WUnlock();
+        }
+        else
+        {
+          mutex.RLock();
+          readers++;
+          if (writers != 0)
+            errors++;
+          readers--;
+          mutex.RUnlock();
+        }
+      }
+    }));
+  }
+  for (auto &t : threads)
+    t.join();
+  EXPECT_EQ(0, errors);
+  EXPECT_EQ(8 * 20000 / 4, count);
+}
+
+// a version read before a write unlock or a bump no longer validates
+TEST(RWMutexTest, VersionTest)
+{
+  FutexRWMutex mutex;
+  uint32_t version;
+  EXPECT_EQ(true, mutex.ReadVersion(version));
+  mutex.RLock();
+  EXPECT_EQ(true, mutex.ValidateVersion(version));
+  mutex.RUnlock();
+  mutex.WLock();
+  EXPECT_EQ(false, mutex.ValidateVersion(version));
+  uint32_t locked_version;
+  EXPECT_EQ(false, mutex.ReadVersion(locked_version));
+  mutex.WUnlock();
+  EXPECT_EQ(false, mutex.ValidateVersion(version));
+
+  EXPECT_EQ(true, mutex.ReadVersion(version));
+  mutex.BumpVersion();
+  EXPECT_EQ(false, mutex.ValidateVersion(version));
+  EXPECT_EQ(true, mutex.ReadVersion(version));
+  EXPECT_EQ(true, mutex.ValidateVersion(version));
+}
+
 } // namespace cmudb
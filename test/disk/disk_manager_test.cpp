@@ -0,0 +1,996 @@
+/**
+ * disk_manager_test.cpp
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "common/crc32c.h"
+#include "common/exception.h"
+#include "disk/disk_manager.h"
+#include "gtest/gtest.h"
+
+namespace cmudb
+{
+
+/*
+ * The previous fstream based page I/O, kept here as the baseline for the
+ * throughput benchmark. A single stream has one seek cursor, so every access
+ * has to be serialized.
+ */
+class StreamPageFile
+{
+public:
+  StreamPageFile(const std::string &db_file)
+  {
+    db_io_.open(db_file, std::ios::binary | std::ios::in | std::ios::out);
+  }
+
+  void WritePage(page_id_t page_id, const char *page_data)
+  {
+    std::lock_guard<std::mutex> lock(latch_);
+    db_io_.seekp(page_id * PAGE_SIZE);
+    db_io_.write(page_data, PAGE_SIZE);
+    db_io_.flush();
+  }
+
+  void ReadPage(page_id_t page_id, char *page_data)
+  {
+    std::lock_guard<std::mutex> lock(latch_);
+    db_io_.seekp(page_id * PAGE_SIZE);
+    db_io_.read(page_data, PAGE_SIZE);
+  }
+
+private:
+  std::fstream db_io_;
+  std::mutex latch_;
+};
+
+// every 8-byte word of a page (up to the checksum) carries its page id, so
+// torn or misplaced reads are easy to detect
+static void FillPage(char *data, page_id_t page_id)
+{
+  for (size_t i = 0; i < PAGE_DATA_SIZE / sizeof(int64_t); i++)
+    reinterpret_cast<int64_t *>(data)[i] = page_id;
+}
+
+static bool CheckPage(const char *data, page_id_t page_id)
+{
+  for (size_t i = 0; i < PAGE_DATA_SIZE / sizeof(int64_t); i++)
+    if (reinterpret_cast<const int64_t *>(data)[i] != page_id)
+      return false;
+  return true;
+}
+
+// run num_threads workers doing num_ops mixed reads/writes (1 write out of
+// 4) over num_pages pages, return the elapsed time in ms
+template <typename File>
+double RunWorkload(File &file, int num_threads, int num_ops, int num_pages,
+                   bool &all_valid)
+{
+  std::vector<std::thread> threads;
+  std::vector<char> valid(num_threads, 1);
+  auto start = std::chrono::steady_clock::now();
+  for (int tid = 0; tid < num_threads; tid++)
+  {
+    threads.push_back(std::thread([&, tid]() {
+      char data[PAGE_SIZE];
+      unsigned int seed = tid;
+      for (int i = 0; i < num_ops; i++)
+      {
+        page_id_t page_id = rand_r(&seed) % num_pages;
+        if (i % 4 == 0)
+        {
+          FillPage(data, page_id);
+          file.WritePage(page_id, data);
+        }
+        else
+        {
+          file.ReadPage(page_id, data);
+          if (!CheckPage(data, page_id))
+            valid[tid] = 0;
+        }
+      }
+    }));
+  }
+  for (auto &t : threads)
+    t.join();
+  auto end = std::chrono::steady_clock::now();
+  all_valid = true;
+  for (auto v : valid)
+    all_valid = all_valid && v;
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+TEST(DiskManagerTest, ReadWriteTest)
+{
+  char buf[PAGE_SIZE] = {0};
+  char data[PAGE_SIZE] = {0};
+  std::string db_file("test.db");
+  remove(db_file.c_str());
+  {
+    DiskManager dm(db_file);
+
+    // tolerate empty read, which yields zeros
+    memset(buf, 0x5a, sizeof(buf));
+    EXPECT_TRUE(dm.ReadPage(0, buf));
+    EXPECT_EQ(0, memcmp(buf, data, sizeof(buf)));
+    strcpy(data, "A test string.");
+
+    // the checksum trailer is only stamped on what is written, data is
+    // left alone
+    dm.WritePage(0, data);
+    dm.ReadPage(0, buf);
+    EXPECT_EQ(0, memcmp(buf, data, PAGE_DATA_SIZE));
+    EXPECT_EQ(0, data[PAGE_DATA_SIZE]);
+
+    memset(buf, 0, sizeof(buf));
+    dm.WritePage(5, data);
+    dm.ReadPage(5, buf);
+    EXPECT_EQ(0, memcmp(buf, data, PAGE_DATA_SIZE));
+  }
+  // content survives reopening the file
+  {
+    DiskManager dm(db_file);
+    memset(buf, 0, sizeof(buf));
+    dm.ReadPage(5, buf);
+    EXPECT_EQ(0, memcmp(buf, data, PAGE_DATA_SIZE));
+  }
+  remove(db_file.c_str());
+}
+
+TEST(DiskManagerTest, ConcurrentThroughputBenchmark)
+{
+  const int num_pages = 256;
+  const int num_ops = 4000;
+  std::string db_file("test.db");
+  std::string stream_file("stream.db");
+  remove(db_file.c_str());
+  remove(stream_file.c_str());
+
+  // the two lay out pages differently, give each its own file
+  DiskManager dm(db_file);
+  std::ofstream(stream_file).close();
+  StreamPageFile stream(stream_file);
+  char data[PAGE_SIZE];
+  for (page_id_t i = 0; i < num_pages; i++)
+  {
+    FillPage(data, i);
+    dm.WritePage(i, data);
+    stream.WritePage(i, data);
+  }
+
+  for (int num_threads : {1, 2, 4, 8})
+  {
+    bool valid_stream, valid_fd;
+    double stream_ms =
+        RunWorkload(stream, num_threads, num_ops, num_pages, valid_stream);
+    double fd_ms = RunWorkload(dm, num_threads, num_ops, num_pages, valid_fd);
+    EXPECT_TRUE(valid_stream);
+    EXPECT_TRUE(valid_fd);
+
+    double total = static_cast<double>(num_threads) * num_ops;
+    std::cout << num_threads << " threads: fstream " << total / stream_ms
+              << " ops/ms, pread/pwrite " << total / fd_ms << " ops/ms"
+              << std::endl;
+  }
+  remove(db_file.c_str());
+  remove(stream_file.c_str());
+}
+
+TEST(DiskManagerTest, AsyncReadWriteTest)
+{
+  const int num_pages = 200;
+  std::string db_file("test.db");
+  remove(db_file.c_str());
+  DiskManager dm(db_file);
+
+  // write all pages as one batch, far more than the queue depth
+  std::vector<std::vector<char>> pages(num_pages, std::vector<char>(PAGE_SIZE));
+  std::vector<PageWrite> batch;
+  for (page_id_t i = 0; i < num_pages; i++)
+  {
+    FillPage(pages[i].data(), i);
+    batch.push_back({i, pages[i].data()});
+  }
+  std::atomic<int> batch_done(0);
+  dm.WritePagesAsync(batch, [&](bool success) {
+    EXPECT_TRUE(success);
+    batch_done++;
+  });
+  dm.WaitForAsyncIO();
+  EXPECT_EQ(1, batch_done);
+
+  // read them back asynchronously, plus one page beyond the end of file
+  std::vector<std::vector<char>> bufs(num_pages + 1,
+                                      std::vector<char>(PAGE_SIZE, 'x'));
+  std::atomic<int> reads_done(0);
+  for (page_id_t i = 0; i <= num_pages; i++)
+  {
+    dm.ReadPageAsync(i, bufs[i].data(), [&](bool success) {
+      EXPECT_TRUE(success);
+      reads_done++;
+    });
+  }
+  dm.WaitForAsyncIO();
+  EXPECT_EQ(num_pages + 1, reads_done);
+  for (page_id_t i = 0; i < num_pages; i++)
+    EXPECT_TRUE(CheckPage(bufs[i].data(), i));
+  EXPECT_TRUE(CheckPage(bufs[num_pages].data(), 0));
+  remove(db_file.c_str());
+}
+
+TEST(DiskManagerTest, DirectIOTest)
+{
+  std::string db_file("test.db");
+  remove(db_file.c_str());
+  DiskManager dm(db_file, true);
+  if (!dm.IsDirectIO())
+    std::cout << "O_DIRECT not supported here, testing buffered I/O"
+              << std::endl;
+
+  char *aligned = AllocateAlignedPages(2);
+  EXPECT_TRUE(IsPageAligned(aligned));
+  // unaligned buffers are bounced through an aligned copy
+  char *unaligned = aligned + PAGE_SIZE / 2;
+  FillPage(unaligned, 3);
+  dm.WritePage(3, unaligned);
+  memset(aligned, 0, 2 * PAGE_SIZE);
+  dm.ReadPage(3, aligned);
+  EXPECT_TRUE(CheckPage(aligned, 3));
+  memset(aligned, 0, 2 * PAGE_SIZE);
+  dm.ReadPage(3, unaligned);
+  EXPECT_TRUE(CheckPage(unaligned, 3));
+
+  // aligned buffers go through the async engine as they are
+  FillPage(aligned, 4);
+  dm.WritePageAsync(4, aligned, nullptr);
+  dm.WaitForAsyncIO();
+  memset(aligned, 0, PAGE_SIZE);
+  std::atomic<int> done(0);
+  dm.ReadPageAsync(4, aligned, [&](bool success) { done += success; });
+  dm.WaitForAsyncIO();
+  EXPECT_EQ(1, done);
+  EXPECT_TRUE(CheckPage(aligned, 4));
+
+  free(aligned);
+  remove(db_file.c_str());
+}
+
+TEST(DiskManagerTest, AllocationTest)
+{
+  std::string db_file("test.db");
+  remove(db_file.c_str());
+  {
+    DiskManager dm(db_file);
+    for (page_id_t i = 0; i < 100; i++)
+      EXPECT_EQ(i, dm.AllocatePage());
+    for (page_id_t i = 10; i < 20; i++)
+      dm.DeallocatePage(i);
+    dm.DeallocatePage(60);
+    dm.DeallocatePage(60);
+
+    // lowest free page first
+    EXPECT_EQ(10, dm.AllocatePage());
+  }
+  // allocations and deallocations survive reopening the file
+  {
+    DiskManager dm(db_file);
+    for (page_id_t i = 11; i < 20; i++)
+      EXPECT_EQ(i, dm.AllocatePage());
+    EXPECT_EQ(60, dm.AllocatePage());
+    EXPECT_EQ(100, dm.AllocatePage());
+  }
+  // the file stops growing when pages are recycled
+  {
+    DiskManager dm(db_file);
+    char data[PAGE_SIZE];
+    for (page_id_t i = 0; i < 101; i++)
+    {
+      FillPage(data, i);
+      dm.WritePage(i, data);
+    }
+    struct stat before;
+    stat(db_file.c_str(), &before);
+    for (int round = 0; round < 50; round++)
+    {
+      dm.DeallocatePage(round);
+      page_id_t page_id = dm.AllocatePage();
+      EXPECT_EQ(round, page_id);
+      FillPage(data, page_id);
+      dm.WritePage(page_id, data);
+    }
+    struct stat after;
+    stat(db_file.c_str(), &after);
+    EXPECT_EQ(before.st_size, after.st_size);
+  }
+  remove(db_file.c_str());
+}
+
+TEST(DiskManagerTest, GrowthTest)
+{
+  std::string db_file("test.db");
+  remove(db_file.c_str());
+  char data[PAGE_SIZE];
+  struct stat stat_buf;
+  {
+    DiskManager dm(db_file);
+    dm.SetGrowthStep(64);
+    FillPage(data, 0);
+    dm.WritePage(0, data);
+
+    // blocks are reserved ahead, the visible size is what has been written
+    stat(db_file.c_str(), &stat_buf);
+    EXPECT_EQ(2 * PAGE_SIZE, stat_buf.st_size);
+    std::cout << "allocated " << stat_buf.st_blocks * 512 / PAGE_SIZE
+              << " pages for 2 written" << std::endl;
+
+    // reading past the logical end yields zeros, as the async path does
+    memset(data, 'x', PAGE_SIZE);
+    EXPECT_TRUE(dm.ReadPage(10, data));
+    EXPECT_EQ(0, data[0]);
+
+    FillPage(data, 10);
+    dm.WritePage(10, data);
+    memset(data, 0, PAGE_SIZE);
+    dm.ReadPage(10, data);
+    EXPECT_TRUE(CheckPage(data, 10));
+  }
+  // the logical size survives reopening the file
+  stat(db_file.c_str(), &stat_buf);
+  EXPECT_EQ(12 * PAGE_SIZE, stat_buf.st_size);
+  {
+    DiskManager dm(db_file);
+    memset(data, 0, PAGE_SIZE);
+    dm.ReadPage(10, data);
+    EXPECT_TRUE(CheckPage(data, 10));
+  }
+  remove(db_file.c_str());
+}
+
+// num_threads committers, each writing its own pages and syncing after
+// every write, return commits per ms
+static double RunCommits(DiskManager &dm, int num_threads, int num_commits)
+{
+  std::vector<std::thread> threads;
+  auto start = std::chrono::steady_clock::now();
+  for (int tid = 0; tid < num_threads; tid++)
+  {
+    threads.push_back(std::thread([&, tid]() {
+      char data[PAGE_SIZE];
+      for (int i = 0; i < num_commits; i++)
+      {
+        page_id_t page_id = tid * num_commits + i;
+        FillPage(data, page_id);
+        dm.WritePage(page_id, data);
+        dm.Sync();
+      }
+    }));
+  }
+  for (auto &t : threads)
+    t.join();
+  auto end = std::chrono::steady_clock::now();
+  return num_threads * num_commits /
+         std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+TEST(DiskManagerTest, DurabilityTest)
+{
+  const int num_threads = 8;
+  const int num_commits = 50;
+  std::string db_file("test.db");
+  remove(db_file.c_str());
+  DiskManager dm(db_file);
+
+  double rate = RunCommits(dm, num_threads, num_commits);
+  EXPECT_EQ(0u, dm.GetSyncCount());
+  std::cout << "none: " << rate << " commits/ms" << std::endl;
+
+  // concurrent committers share fdatasync calls
+  dm.SetDurability(DurabilityLevel::COMMIT);
+  rate = RunCommits(dm, num_threads, num_commits);
+  uint64_t syncs = dm.GetSyncCount();
+  EXPECT_GT(syncs, 0u);
+  EXPECT_LE(syncs, static_cast<uint64_t>(num_threads * num_commits));
+  std::cout << "commit: " << rate << " commits/ms, " << syncs
+            << " fdatasync for " << num_threads * num_commits << " commits"
+            << std::endl;
+
+  // one fdatasync per interval at most, unless the byte threshold is hit
+  dm.SetDurability(DurabilityLevel::GROUP_COMMIT,
+                   std::chrono::milliseconds(2), 1 << 30);
+  rate = RunCommits(dm, num_threads, num_commits);
+  uint64_t group_syncs = dm.GetSyncCount() - syncs;
+  EXPECT_GT(group_syncs, 0u);
+  EXPECT_LE(group_syncs, static_cast<uint64_t>(num_threads * num_commits));
+  std::cout << "group commit: " << rate << " commits/ms, " << group_syncs
+            << " fdatasync for " << num_threads * num_commits << " commits"
+            << std::endl;
+
+  // the byte threshold triggers a group commit long before the timer
+  dm.SetDurability(DurabilityLevel::GROUP_COMMIT,
+                   std::chrono::milliseconds(60000), PAGE_SIZE);
+  char data[PAGE_SIZE];
+  FillPage(data, 0);
+  dm.WritePage(0, data);
+  dm.Sync();
+  remove(db_file.c_str());
+}
+
+// two objects growing at the same time each get their own extents
+TEST(DiskManagerTest, ExtentTest)
+{
+  const int num_pages = 100;
+  std::string db_file("test.db");
+  remove(db_file.c_str());
+  std::vector<page_id_t> table, index;
+  {
+    DiskManager dm(db_file);
+    // first pages come from the mixed space
+    table.push_back(dm.AllocatePage());
+    index.push_back(dm.AllocatePage());
+    EXPECT_EQ(0, table[0]);
+    EXPECT_EQ(1, index[0]);
+    for (int i = 1; i < num_pages; i++)
+    {
+      table.push_back(dm.AllocatePage(table.back()));
+      index.push_back(dm.AllocatePage(index.back()));
+    }
+    // each chain is sequential within an extent and owns whole extents
+    int table_jumps = 0, index_jumps = 0;
+    for (int i = 2; i < num_pages; i++)
+    {
+      table_jumps += table[i] != table[i - 1] + 1;
+      index_jumps += index[i] != index[i - 1] + 1;
+    }
+    EXPECT_EQ(1, table_jumps);
+    EXPECT_EQ(1, index_jumps);
+    for (int i = 1; i < num_pages; i++)
+    {
+      EXPECT_EQ(table[1] / EXTENT_SIZE + (i - 1) / EXTENT_SIZE * 2,
+                table[i] / EXTENT_SIZE);
+      EXPECT_NE(table[i] / EXTENT_SIZE, index[i] / EXTENT_SIZE);
+    }
+
+    // the pages skipped to align the first extent serve the mixed space
+    EXPECT_EQ(2, dm.AllocatePage());
+
+    // a freed page of an extent is only reused by its owner
+    dm.DeallocatePage(table[10]);
+    EXPECT_EQ(3, dm.AllocatePage());
+    EXPECT_EQ(table[10], dm.AllocatePage(table[9]));
+  }
+  {
+    DiskManager dm(db_file);
+    // extent ownership survives reopening the file
+    EXPECT_EQ(table.back() + 1, dm.AllocatePage(table.back()));
+    page_id_t other = dm.AllocatePage();
+    EXPECT_EQ(4, other);
+
+    // an extent whose pages are all freed goes back to the pool
+    for (int i = 1; i <= EXTENT_SIZE; i++)
+      dm.DeallocatePage(table[i]);
+    EXPECT_EQ(table[1], dm.AllocatePage(other));
+  }
+  remove(db_file.c_str());
+}
+
+// page ids stay contiguous across the bitmap page of the second group
+TEST(DiskManagerTest, BitmapGroupTest)
+{
+  std::string db_file("test.db");
+  remove(db_file.c_str());
+  char data[PAGE_SIZE];
+  {
+    DiskManager dm(db_file);
+    for (page_id_t i = 0; i < PAGES_PER_BITMAP + 2; i++)
+      EXPECT_EQ(i, dm.AllocatePage());
+    for (page_id_t i = PAGES_PER_BITMAP - 2; i < PAGES_PER_BITMAP + 2; i++)
+    {
+      FillPage(data, i);
+      dm.WritePage(i, data);
+    }
+    dm.DeallocatePage(PAGES_PER_BITMAP + 1);
+  }
+  {
+    DiskManager dm(db_file);
+    for (page_id_t i = PAGES_PER_BITMAP - 2; i < PAGES_PER_BITMAP + 2; i++)
+    {
+      memset(data, 0, PAGE_SIZE);
+      dm.ReadPage(i, data);
+      EXPECT_TRUE(CheckPage(data, i));
+    }
+    EXPECT_EQ(PAGES_PER_BITMAP + 1, dm.AllocatePage());
+    EXPECT_EQ(PAGES_PER_BITMAP + 2, dm.AllocatePage());
+  }
+  remove(db_file.c_str());
+}
+
+// extents are striped over the data files, every file gets its share
+TEST(DiskManagerTest, StripingTest)
+{
+  const int num_files = 3;
+  const int num_pages = 2 * num_files * EXTENT_SIZE;
+  std::vector<std::string> db_files;
+  for (int i = 0; i < num_files; i++)
+  {
+    std::string dir = "stripe" + std::to_string(i);
+    mkdir(dir.c_str(), 0755);
+    db_files.push_back(dir + "/test.db");
+    remove(db_files.back().c_str());
+  }
+  char data[PAGE_SIZE];
+  {
+    DiskManager dm(db_files);
+    EXPECT_EQ(static_cast<size_t>(num_files), dm.GetNumFiles());
+    for (page_id_t i = 0; i < num_pages; i++)
+    {
+      EXPECT_EQ(i, dm.AllocatePage());
+      FillPage(data, i);
+      dm.WritePage(i, data);
+    }
+  }
+  for (auto &db_file : db_files)
+  {
+    struct stat stat_buf;
+    EXPECT_EQ(0, stat(db_file.c_str(), &stat_buf));
+    EXPECT_GE(stat_buf.st_size, 2 * EXTENT_SIZE * PAGE_SIZE);
+  }
+  {
+    DiskManager dm(db_files);
+    std::vector<std::vector<char>> pages(num_pages,
+                                         std::vector<char>(PAGE_SIZE));
+    std::atomic<int> valid(0);
+    for (page_id_t i = 0; i < num_pages; i++)
+    {
+      dm.ReadPageAsync(i, pages[i].data(), [&, i](bool success) {
+        valid += success && CheckPage(pages[i].data(), i);
+      });
+    }
+    dm.WaitForAsyncIO();
+    EXPECT_EQ(num_pages, valid);
+    EXPECT_EQ(num_pages, dm.AllocatePage());
+  }
+  // the page id to file mapping depends on the number of files
+  std::vector<std::string> fewer_files(db_files.begin(), db_files.end() - 1);
+  EXPECT_THROW(DiskManager dm(fewer_files), Exception);
+  for (int i = 0; i < num_files; i++)
+  {
+    remove(db_files[i].c_str());
+    rmdir(("stripe" + std::to_string(i)).c_str());
+  }
+}
+
+// a file of the original layout (a header page with one record at offset 0)
+// or of another format version is refused, not misread
+TEST(DiskManagerTest, FormatVersionTest)
+{
+  std::string db_file("test.db");
+  remove(db_file.c_str());
+  char page[PAGE_SIZE] = {0};
+  int fd = open(db_file.c_str(), O_RDWR | O_CREAT, 0644);
+  ASSERT_GE(fd, 0);
+  uint32_t record_count = 1;
+  memcpy(page, &record_count, sizeof(record_count));
+  EXPECT_EQ(PAGE_SIZE, pwrite(fd, page, PAGE_SIZE, 0));
+  EXPECT_EQ(PAGE_SIZE, pwrite(fd, page, PAGE_SIZE, PAGE_SIZE));
+  close(fd);
+  try
+  {
+    DiskManager dm(db_file);
+    ADD_FAILURE() << "original layout opened";
+  }
+  catch (Exception &e)
+  {
+    EXPECT_NE(std::string::npos,
+              std::string(e.what()).find("unsupported format"));
+  }
+
+  // a file of this format reopens, one with another version does not
+  remove(db_file.c_str());
+  {
+    DiskManager dm(db_file);
+    dm.AllocatePage();
+  }
+  {
+    DiskManager dm(db_file);
+    EXPECT_TRUE(dm.IsPageAllocated(0));
+  }
+  fd = open(db_file.c_str(), O_RDWR);
+  ASSERT_GE(fd, 0);
+  uint32_t version = 99;
+  EXPECT_EQ(4, pwrite(fd, &version, sizeof(version), 8));
+  close(fd);
+  EXPECT_THROW(DiskManager dm(db_file), Exception);
+  remove(db_file.c_str());
+}
+
+// overwrite a byte of a page in the db file behind the disk manager's back
+static void CorruptPage(const std::string &db_file, page_id_t page_id)
+{
+  off_t offset = static_cast<off_t>(page_id + page_id / PAGES_PER_BITMAP + 1) *
+                 PAGE_SIZE;
+  int fd = open(db_file.c_str(), O_RDWR);
+  ASSERT_GE(fd, 0);
+  char byte = 0x5a;
+  EXPECT_EQ(1, pwrite(fd, &byte, 1, offset + 10));
+  close(fd);
+}
+
+TEST(DiskManagerTest, ChecksumTest)
+{
+  std::string db_file("test.db");
+  remove(db_file.c_str());
+  remove((db_file + ".dblwr").c_str());
+  char data[PAGE_SIZE];
+  {
+    DiskManager dm(db_file);
+    dm.SetChecksumMode(ChecksumMode::VERIFY);
+    FillPage(data, 3);
+    dm.WritePage(3, data);
+    EXPECT_TRUE(dm.ReadPage(3, data));
+    EXPECT_TRUE(CheckPage(data, 3));
+    // a page never written has no checksum to check
+    EXPECT_TRUE(dm.ReadPage(2, data));
+    CorruptPage(db_file, 3);
+    EXPECT_FALSE(dm.ReadPage(3, data));
+
+    // the double write copy repairs the page, on disk too
+    dm.SetChecksumMode(ChecksumMode::REPAIR);
+    FillPage(data, 3);
+    dm.WritePage(3, data);
+    CorruptPage(db_file, 3);
+    memset(data, 0, PAGE_SIZE);
+    EXPECT_TRUE(dm.ReadPage(3, data));
+    EXPECT_TRUE(CheckPage(data, 3));
+    dm.SetChecksumMode(ChecksumMode::VERIFY);
+    EXPECT_TRUE(dm.ReadPage(3, data));
+
+    // batches larger than the double write file
+    dm.SetChecksumMode(ChecksumMode::REPAIR);
+    const int num_pages = 3 * DOUBLE_WRITE_SLOTS / 2;
+    std::vector<std::vector<char>> pages(num_pages,
+                                         std::vector<char>(PAGE_SIZE));
+    std::vector<PageWrite> batch;
+    for (page_id_t i = 0; i < num_pages; i++)
+    {
+      FillPage(pages[i].data(), i);
+      batch.push_back({i, pages[i].data()});
+    }
+    dm.WritePagesAsync(batch, [](bool success) { EXPECT_TRUE(success); });
+    dm.WaitForAsyncIO();
+    CorruptPage(db_file, num_pages - 1);
+    std::atomic<int> valid(0);
+    for (page_id_t i = 0; i < num_pages; i++)
+    {
+      dm.ReadPageAsync(i, pages[i].data(), [&, i](bool success) {
+        valid += success && CheckPage(pages[i].data(), i);
+      });
+    }
+    dm.WaitForAsyncIO();
+    EXPECT_EQ(num_pages, valid);
+  }
+  // a page torn by a crash is restored when the double write file is opened
+  // (the batch above wrapped around, only the last pages still have a copy)
+  page_id_t torn = 3 * DOUBLE_WRITE_SLOTS / 2 - 2;
+  CorruptPage(db_file, torn);
+  {
+    DiskManager dm(db_file);
+    dm.SetChecksumMode(ChecksumMode::REPAIR);
+    dm.SetChecksumMode(ChecksumMode::VERIFY);
+    EXPECT_TRUE(dm.ReadPage(torn, data));
+    EXPECT_TRUE(CheckPage(data, torn));
+  }
+  remove(db_file.c_str());
+  remove((db_file + ".dblwr").c_str());
+}
+
+TEST(DiskManagerTest, CompressionTest)
+{
+  const int num_pages = 2 * EXTENT_SIZE;
+  std::string db_file("test.db");
+  remove(db_file.c_str());
+  std::vector<std::vector<char>> pages(num_pages, std::vector<char>(PAGE_SIZE));
+  struct stat stat_buf;
+  {
+    DiskManager dm(db_file);
+    dm.SetChecksumMode(ChecksumMode::VERIFY);
+    dm.SetCompression(true);
+    dm.SetGrowthStep(0);
+    // half synchronously, half as a batch
+    std::vector<PageWrite> batch;
+    for (page_id_t i = 0; i < num_pages; i++)
+    {
+      FillPage(pages[i].data(), i);
+      if (i < num_pages / 2)
+        dm.WritePage(i, pages[i].data());
+      else
+        batch.push_back({i, pages[i].data()});
+    }
+    dm.WritePagesAsync(batch, nullptr);
+    dm.WaitForAsyncIO();
+    // a page that does not compress is stored as is
+    unsigned int seed = 3;
+    for (int i = 0; i < PAGE_SIZE; i++)
+      pages[0][i] = static_cast<char>(rand_r(&seed));
+    dm.WritePage(0, pages[0].data());
+    std::vector<char> noise(pages[0]);
+
+    std::atomic<int> valid(0);
+    for (page_id_t i = 1; i < num_pages; i++)
+    {
+      memset(pages[i].data(), 0, PAGE_SIZE);
+      dm.ReadPageAsync(i, pages[i].data(), [&, i](bool success) {
+        valid += success && CheckPage(pages[i].data(), i);
+      });
+    }
+    dm.WaitForAsyncIO();
+    EXPECT_EQ(num_pages - 1, valid);
+    EXPECT_TRUE(dm.ReadPage(0, pages[0].data()));
+    EXPECT_EQ(0, memcmp(noise.data(), pages[0].data(), PAGE_DATA_SIZE));
+
+    // a damaged compressed image fails the read like any corrupted page
+    CorruptPage(db_file, 5);
+    EXPECT_FALSE(dm.ReadPage(5, pages[5].data()));
+    dm.WritePage(5, pages[6].data());
+    stat(db_file.c_str(), &stat_buf);
+  }
+  // blocks are only saved when the file system block is smaller than a page
+  // (disk_manager_large_page_test runs this with larger pages), pages are
+  // written as is otherwise
+  std::cout << "compressed file uses " << stat_buf.st_blocks * 512 / PAGE_SIZE
+            << " page slots for " << num_pages << " pages" << std::endl;
+  if (stat_buf.st_blksize < PAGE_SIZE)
+  {
+    EXPECT_LT(stat_buf.st_blocks * 512, num_pages * PAGE_SIZE / 2);
+  }
+  else
+  {
+    EXPECT_GE(stat_buf.st_blocks * 512, num_pages * PAGE_SIZE);
+  }
+
+  // compressed pages are read back with compression off as well
+  {
+    DiskManager dm(db_file);
+    dm.SetChecksumMode(ChecksumMode::VERIFY);
+    std::vector<char> data(PAGE_SIZE);
+    for (page_id_t i = 1; i < num_pages; i++)
+    {
+      EXPECT_TRUE(dm.ReadPage(i, data.data()));
+      EXPECT_TRUE(CheckPage(data.data(), i == 5 ? 6 : i));
+    }
+  }
+  remove(db_file.c_str());
+}
+
+// time spent computing checksums compared to the page I/O they protect, with
+// direct I/O so that reads really reach the device
+TEST(DiskManagerTest, ChecksumOverheadBenchmark)
+{
+  const int num_pages = 2000;
+  std::string db_file("test.db");
+  remove(db_file.c_str());
+  DiskManager dm(db_file, true);
+  dm.SetChecksumMode(ChecksumMode::VERIFY);
+  char *data = AllocateAlignedPages(1);
+
+  auto start = std::chrono::steady_clock::now();
+  for (page_id_t i = 0; i < num_pages; i++)
+  {
+    FillPage(data, i);
+    dm.WritePage(i, data);
+  }
+  for (page_id_t i = 0; i < num_pages; i++)
+  {
+    EXPECT_TRUE(dm.ReadPage(i, data));
+    EXPECT_TRUE(CheckPage(data, i));
+  }
+  auto io_end = std::chrono::steady_clock::now();
+  // one checksum per write and one per read
+  uint32_t crc = 0;
+  for (int i = 0; i < 2 * num_pages; i++)
+    crc += Crc32c(data, PAGE_DATA_SIZE);
+  auto crc_end = std::chrono::steady_clock::now();
+
+  double io_ms = std::chrono::duration<double, std::milli>(io_end - start)
+                     .count();
+  double crc_ms = std::chrono::duration<double, std::milli>(crc_end - io_end)
+                      .count();
+  std::cout << "crc32c (" << (Crc32cIsHardware() ? "sse4.2" : "table")
+            << ", direct I/O " << dm.IsDirectIO() << "): " << crc_ms
+            << " ms of " << io_ms << " ms page I/O, "
+            << 100 * crc_ms / io_ms << "%, crc " << crc << std::endl;
+  free(data);
+  remove(db_file.c_str());
+}
+
+// a shuffled batch with gaps, over several files, written with adjacent pages
+// merged: every page lands in its place, also when the batch goes through
+// the double write file or some pages are compressed
+TEST(DiskManagerTest, WriteCoalescingTest)
+{
+  const int num_files = 2;
+  const int num_pages = 3 * num_files * EXTENT_SIZE;
+  std::vector<std::string> db_files;
+  for (int i = 0; i < num_files; i++)
+  {
+    std::string dir = "stripe" + std::to_string(i);
+    mkdir(dir.c_str(), 0755);
+    db_files.push_back(dir + "/test.db");
+  }
+  char *pages = AllocateAlignedPages(num_pages);
+  char *data = AllocateAlignedPages(1);
+  for (int mode = 0; mode < 3; mode++)
+  {
+    for (auto &db_file : db_files)
+      remove(db_file.c_str());
+    DiskManager dm(db_files, true);
+    if (mode == 1)
+      dm.SetChecksumMode(ChecksumMode::REPAIR);
+    if (mode == 2)
+      dm.SetCompression(true);
+    std::vector<PageWrite> batch;
+    for (page_id_t i = 0; i < num_pages; i++)
+    {
+      // compressed pages mixed in, zeros compress
+      if (mode == 2 && i % 5 == 0)
+        memset(pages + i * PAGE_SIZE, 0, PAGE_SIZE);
+      else
+        FillPage(pages + i * PAGE_SIZE, i);
+      if (i % 7 != 3)
+        batch.push_back({i, pages + i * PAGE_SIZE});
+    }
+    unsigned int seed = mode;
+    for (size_t i = batch.size() - 1; i > 0; i--)
+      std::swap(batch[i], batch[rand_r(&seed) % (i + 1)]);
+    std::atomic<int> done(0);
+    dm.WritePagesAsync(batch, [&](bool success) { done += success; });
+    dm.WaitForAsyncIO();
+    EXPECT_EQ(1, done);
+
+    for (page_id_t i = 0; i < num_pages; i++)
+    {
+      memset(data, 'x', PAGE_SIZE);
+      EXPECT_TRUE(dm.ReadPage(i, data));
+      if (i % 7 == 3)
+      {
+        EXPECT_EQ(0, data[0]);
+      }
+      else if (mode == 2 && i % 5 == 0)
+      {
+        EXPECT_EQ(0, data[PAGE_DATA_SIZE - 1]);
+      }
+      else
+      {
+        EXPECT_TRUE(CheckPage(data, i));
+      }
+    }
+  }
+  free(data);
+  free(pages);
+  for (int i = 0; i < num_files; i++)
+  {
+    remove(db_files[i].c_str());
+    remove((db_files[i] + ".dblwr").c_str());
+    rmdir(("stripe" + std::to_string(i)).c_str());
+  }
+}
+
+// a batch of pages in random order (direct I/O), each page written alone or
+// adjacent pages merged into vectored writes
+TEST(DiskManagerTest, WriteCoalescingBenchmark)
+{
+  const int num_pages = 4096;
+  std::string db_file("test.db");
+  char *pages = AllocateAlignedPages(num_pages);
+  std::vector<PageWrite> batch;
+  for (page_id_t i = 0; i < num_pages; i++)
+  {
+    FillPage(pages + i * PAGE_SIZE, i);
+    batch.push_back({i, pages + i * PAGE_SIZE});
+  }
+  unsigned int seed = 1;
+  for (size_t i = batch.size() - 1; i > 0; i--)
+    std::swap(batch[i], batch[rand_r(&seed) % (i + 1)]);
+  for (bool coalescing : {false, true})
+  {
+    remove(db_file.c_str());
+    DiskManager dm(db_file, true);
+    dm.SetWriteCoalescing(coalescing);
+    // preallocate the file, so both runs only overwrite
+    dm.WritePagesAsync(batch, nullptr);
+    dm.WaitForAsyncIO();
+    auto start = std::chrono::steady_clock::now();
+    for (int round = 0; round < 4; round++)
+    {
+      dm.WritePagesAsync(batch, nullptr);
+      dm.WaitForAsyncIO();
+    }
+    double ms = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+    std::cout << (coalescing ? "coalesced" : "page at a time")
+              << " batch writes: "
+              << 4.0 * num_pages * PAGE_SIZE / (1 << 20) / (ms / 1000)
+              << " MB/s" << std::endl;
+  }
+  free(pages);
+  remove(db_file.c_str());
+}
+
+// same as above against the thread pool engine, which is only used when the
+// kernel has no io_uring
+TEST(DiskManagerTest, ThreadPoolFallbackTest)
+{
+  const int num_pages = 100;
+  std::string db_file("test.db");
+  remove(db_file.c_str());
+  int fd = open(db_file.c_str(), O_RDWR | O_CREAT, 0644);
+  ASSERT_GE(fd, 0);
+  ThreadPoolIOEngine engine(8, 2);
+
+  std::vector<std::vector<char>> pages(num_pages, std::vector<char>(PAGE_SIZE));
+  std::vector<IORequest> requests(num_pages);
+  std::atomic<int> done(0);
+  for (int i = 0; i < num_pages; i++)
+  {
+    FillPage(pages[i].data(), i);
+    requests[i].fd = fd;
+    requests[i].is_write = true;
+    requests[i].offset = static_cast<off_t>(i) * PAGE_SIZE;
+    requests[i].buf = pages[i].data();
+    requests[i].len = PAGE_SIZE;
+    requests[i].callback = [&](bool success) { done += success; };
+  }
+  engine.Submit(requests);
+  engine.Drain();
+  EXPECT_EQ(num_pages, done);
+
+  done = 0;
+  for (int i = 0; i < num_pages; i++)
+  {
+    memset(pages[i].data(), 0, PAGE_SIZE);
+    requests[i].is_write = false;
+  }
+  engine.Submit(requests);
+  engine.Drain();
+  EXPECT_EQ(num_pages, done);
+  for (int i = 0; i < num_pages; i++)
+    EXPECT_TRUE(CheckPage(pages[i].data(), i));
+
+  // one vectored write of every page in reverse order
+  IORequest request;
+  request.fd = fd;
+  request.is_write = true;
+  request.offset = 0;
+  request.len = num_pages * PAGE_SIZE;
+  for (int i = num_pages - 1; i >= 0; i--)
+    request.iovecs.push_back({pages[i].data(), PAGE_SIZE});
+  request.callback = [&](bool success) { done += success; };
+  requests.assign(1, request);
+  done = 0;
+  engine.Submit(requests);
+  engine.Drain();
+  EXPECT_EQ(1, done);
+  char data[PAGE_SIZE];
+  for (int i = 0; i < num_pages; i++)
+  {
+    EXPECT_EQ(PAGE_SIZE, PositionalRead(fd, data, PAGE_SIZE, i * PAGE_SIZE));
+    EXPECT_TRUE(CheckPage(data, num_pages - 1 - i));
+  }
+  close(fd);
+  remove(db_file.c_str());
+}
+
+} // namespace cmudb
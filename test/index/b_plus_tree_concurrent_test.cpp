@@ -3,6 +3,7 @@
  */
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <cstdio>
 #include <functional>
@@ -354,4 +355,460 @@ TEST(BPlusTreeConcurrentTest, MixTest)
   remove("test.db");
 }
 
+// inserts, removes and lookups interleaved over keys large enough to split
+// and merge pages at every level, every thread owning the keys equal to its
+// number modulo the number of threads
+void MixHelper(BPlusTree<GenericKey<8>, RID, GenericComparator<8>> &tree,
+               int64_t num_keys, int total_threads, std::atomic<int> &errors,
+               uint64_t thread_itr)
+{
+  GenericKey<8> index_key;
+  RID rid;
+  std::vector<RID> rids;
+  Transaction transaction(0);
+  for (int64_t i = 0; i < num_keys; i++)
+  {
+    int64_t key = i * total_threads + thread_itr;
+    rid.Set(0, key);
+    index_key.SetFromInteger(key);
+    if (!tree.Insert(index_key, rid, &transaction))
+      errors++;
+    // keep odd i, remove even i once its successor is in
+    if (i % 2 == 1)
+    {
+      index_key.SetFromInteger(key - total_threads);
+      tree.Remove(index_key, &transaction);
+      rids.clear();
+      if (tree.GetValue(index_key, rids, &transaction))
+        errors++;
+      index_key.SetFromInteger(key);
+      if (!tree.GetValue(index_key, rids, &transaction) || rids[0].GetSlotNum() != key)
+        errors++;
+    }
+  }
+}
+
+TEST(BPlusTreeConcurrentTest, StressTest)
+{
+  Schema *key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema);
+  BufferPoolManager *bpm = new BufferPoolManager(256, "test.db");
+  BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm,
+                                                           comparator);
+  page_id_t page_id;
+  auto header_page = bpm->NewPage(page_id);
+  (void)header_page;
+
+  const int num_threads = 4;
+  const int64_t num_keys = 20000;
+  std::atomic<int> errors(0);
+  LaunchParallelTest(num_threads, MixHelper, std::ref(tree), num_keys,
+                     num_threads, std::ref(errors));
+  EXPECT_EQ(0, errors);
+
+  // odd i left, in order
+  int64_t count = 0;
+  int64_t previous = -1;
+  for (auto iterator = tree.Begin(); iterator.isEnd() == false; ++iterator)
+  {
+    int64_t key = (*iterator).second.GetSlotNum();
+    EXPECT_LT(previous, key);
+    EXPECT_EQ(1, key / num_threads % 2);
+    previous = key;
+    count++;
+  }
+  EXPECT_EQ(num_keys / 2 * num_threads, count);
+
+  // remove everything concurrently, merging down to an empty tree
+  std::vector<int64_t> remove_keys;
+  for (int64_t key = 0; key < num_keys * num_threads; key++)
+    remove_keys.push_back(key);
+  LaunchParallelTest(num_threads, DeleteHelperSplit, std::ref(tree),
+                     remove_keys, num_threads);
+  EXPECT_EQ(true, tree.IsEmpty());
+  EXPECT_EQ(true, tree.Begin().isEnd());
+
+  bpm->UnpinPage(HEADER_PAGE_ID, true);
+  delete key_schema;
+  delete bpm;
+  remove("test.db");
+}
+
+// lookups (80%), inserts and removes over a populated tree, for a growing
+// number of threads
+TEST(BPlusTreeConcurrentTest, ThroughputBenchmark)
+{
+  Schema *key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema);
+  BufferPoolManager *bpm = new BufferPoolManager(512, "test.db");
+  BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm,
+                                                           comparator);
+  page_id_t page_id;
+  auto header_page = bpm->NewPage(page_id);
+  (void)header_page;
+
+  const int64_t num_keys = 50000;
+  const int ops_per_thread = 50000;
+  std::vector<int64_t> keys;
+  for (int64_t key = 0; key < num_keys; key += 2)
+    keys.push_back(key);
+  InsertHelper(tree, keys);
+
+  for (int num_threads : {1, 2, 4, 8})
+  {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int tid = 0; tid < num_threads; tid++)
+    {
+      threads.push_back(std::thread([&tree, tid]() {
+        GenericKey<8> index_key;
+        RID rid;
+        std::vector<RID> rids;
+        Transaction transaction(0);
+        unsigned int seed = tid + 1;
+        for (int i = 0; i < ops_per_thread; i++)
+        {
+          int64_t key = rand_r(&seed) % num_keys;
+          index_key.SetFromInteger(key);
+          int op = rand_r(&seed) % 10;
+          if (op == 0)
+          {
+            rid.Set(0, key);
+            tree.Insert(index_key, rid, &transaction);
+          }
+          else if (op == 1)
+            tree.Remove(index_key, &transaction);
+          else
+          {
+            rids.clear();
+            tree.GetValue(index_key, rids, &transaction);
+          }
+        }
+      }));
+    }
+    for (auto &t : threads)
+      t.join();
+    double seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - start)
+                         .count();
+    std::cout << num_threads << " threads: "
+              << static_cast<int64_t>(num_threads * ops_per_thread / seconds)
+              << " ops/s" << std::endl;
+  }
+
+  bpm->UnpinPage(HEADER_PAGE_ID, true);
+  delete key_schema;
+  delete bpm;
+  remove("test.db");
+}
+
+// optimistic lookups of keys that stay in the tree never miss, while
+// writers split and merge the pages around them and the pool evicts pages
+TEST(BPlusTreeConcurrentTest, OptimisticLookupTest)
+{
+  Schema *key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema);
+  BufferPoolManager *bpm = new BufferPoolManager(64, "test.db");
+  BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree(
+      "foo_pk", bpm, comparator, INVALID_PAGE_ID, true);
+  page_id_t page_id;
+  auto header_page = bpm->NewPage(page_id);
+  (void)header_page;
+
+  const int64_t num_keys = 40000;
+  std::vector<int64_t> keys;
+  for (int64_t key = 0; key < num_keys; key += 2)
+    keys.push_back(key);
+  InsertHelper(tree, keys);
+
+  std::atomic<bool> stop(false);
+  std::atomic<int> errors(0);
+  std::vector<std::thread> writers;
+  for (int tid = 0; tid < 2; tid++)
+  {
+    writers.push_back(std::thread([&, tid]() {
+      GenericKey<8> index_key;
+      RID rid;
+      Transaction transaction(0);
+      while (!stop)
+      {
+        // odd keys of this writer, in then out
+        for (int pass = 0; pass < 2 && !stop; pass++)
+        {
+          for (int64_t key = 2 * tid + 1; key < num_keys; key += 4)
+          {
+            index_key.SetFromInteger(key);
+            if (pass == 0)
+            {
+              rid.Set(0, key);
+              tree.Insert(index_key, rid, &transaction);
+            }
+            else
+              tree.Remove(index_key, &transaction);
+          }
+        }
+      }
+    }));
+  }
+  std::vector<std::thread> readers;
+  for (int tid = 0; tid < 2; tid++)
+  {
+    readers.push_back(std::thread([&, tid]() {
+      GenericKey<8> index_key;
+      std::vector<RID> rids;
+      unsigned int seed = tid + 1;
+      for (int i = 0; i < 100000; i++)
+      {
+        int64_t key = rand_r(&seed) % (num_keys / 2) * 2;
+        index_key.SetFromInteger(key);
+        rids.clear();
+        if (!tree.GetValue(index_key, rids) || rids[0].GetSlotNum() != key)
+          errors++;
+      }
+    }));
+  }
+  for (auto &t : readers)
+    t.join();
+  stop = true;
+  for (auto &t : writers)
+    t.join();
+  EXPECT_EQ(0, errors);
+
+  bpm->UnpinPage(HEADER_PAGE_ID, true);
+  delete key_schema;
+  delete bpm;
+  remove("test.db");
+}
+
+// point lookups only, latch crabbing against optimistic lock coupling
+TEST(BPlusTreeConcurrentTest, LookupThroughputBenchmark)
+{
+  Schema *key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema);
+  const int64_t num_keys = 50000;
+  const int ops_per_thread = 50000;
+  for (bool optimistic : {false, true})
+  {
+    BufferPoolManager *bpm = new BufferPoolManager(512, "test.db");
+    BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree(
+        "foo_pk", bpm, comparator, INVALID_PAGE_ID, optimistic);
+    page_id_t page_id;
+    auto header_page = bpm->NewPage(page_id);
+    (void)header_page;
+    std::vector<int64_t> keys;
+    for (int64_t key = 0; key < num_keys; key++)
+      keys.push_back(key);
+    InsertHelper(tree, keys);
+
+    for (int num_threads : {1, 2, 4, 8})
+    {
+      std::atomic<int> misses(0);
+      auto start = std::chrono::steady_clock::now();
+      std::vector<std::thread> threads;
+      for (int tid = 0; tid < num_threads; tid++)
+      {
+        threads.push_back(std::thread([&tree, &misses, tid]() {
+          GenericKey<8> index_key;
+          std::vector<RID> rids;
+          unsigned int seed = tid + 1;
+          for (int i = 0; i < ops_per_thread; i++)
+          {
+            index_key.SetFromInteger(rand_r(&seed) % num_keys);
+            rids.clear();
+            if (!tree.GetValue(index_key, rids))
+              misses++;
+          }
+        }));
+      }
+      for (auto &t : threads)
+        t.join();
+      double seconds = std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+      EXPECT_EQ(0, misses);
+      std::cout << (optimistic ? "optimistic" : "crabbing") << ", "
+                << num_threads << " threads: "
+                << static_cast<int64_t>(num_threads * ops_per_thread / seconds)
+                << " lookups/s" << std::endl;
+    }
+
+    bpm->UnpinPage(HEADER_PAGE_ID, true);
+    delete bpm;
+    remove("test.db");
+  }
+  delete key_schema;
+}
+
+// MixHelper on a B-link tree, with pessimistic and optimistic lookups and a
+// pool small enough to evict pages under the readers
+TEST(BPlusTreeConcurrentTest, BLinkStressTest)
+{
+  Schema *key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema);
+  const int num_threads = 4;
+  const int64_t num_keys = 10000;
+  for (bool optimistic : {false, true})
+  {
+    BufferPoolManager *bpm = new BufferPoolManager(64, "test.db");
+    BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree(
+        "foo_pk", bpm, comparator, INVALID_PAGE_ID, optimistic, true);
+    page_id_t page_id;
+    auto header_page = bpm->NewPage(page_id);
+    (void)header_page;
+
+    std::atomic<int> errors(0);
+    LaunchParallelTest(num_threads, MixHelper, std::ref(tree), num_keys,
+                       num_threads, std::ref(errors));
+    EXPECT_EQ(0, errors);
+
+    // odd i left, in order
+    int64_t count = 0;
+    int64_t previous = -1;
+    for (auto iterator = tree.Begin(); iterator.isEnd() == false; ++iterator)
+    {
+      int64_t key = (*iterator).second.GetSlotNum();
+      EXPECT_LT(previous, key);
+      EXPECT_EQ(1, key / num_threads % 2);
+      previous = key;
+      count++;
+    }
+    EXPECT_EQ(num_keys / 2 * num_threads, count);
+
+    // pages are never merged, the leaves are left empty
+    std::vector<int64_t> remove_keys;
+    for (int64_t key = 0; key < num_keys * num_threads; key++)
+      remove_keys.push_back(key);
+    LaunchParallelTest(num_threads, DeleteHelperSplit, std::ref(tree),
+                       remove_keys, num_threads);
+    EXPECT_EQ(true, tree.Begin().isEnd());
+    GenericKey<8> index_key;
+    index_key.SetFromInteger(num_keys);
+    EXPECT_EQ(true, tree.Begin(index_key).isEnd());
+
+    bpm->UnpinPage(HEADER_PAGE_ID, true);
+    delete bpm;
+    remove("test.db");
+  }
+  delete key_schema;
+}
+
+// fresh B-link trees grown by several threads inserting increasing keys at
+// once, so that the new right half of a root split fills and splits again
+// before the new root is published. Wide keys keep the pages small enough
+// for the root to split every few dozen inserts, a small pool makes growing
+// a new root wait for evictions.
+TEST(BPlusTreeConcurrentTest, BLinkRootSplitTest)
+{
+  Schema *key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<64> comparator(key_schema);
+  const int num_threads = 8;
+  const int num_rounds = 100;
+  const int64_t num_keys = 4000;
+  for (int round = 0; round < num_rounds; round++)
+  {
+    BufferPoolManager *bpm = new BufferPoolManager(32, "test.db");
+    BPlusTree<GenericKey<64>, RID, GenericComparator<64>> tree(
+        "foo_pk", bpm, comparator, INVALID_PAGE_ID, false, true);
+    page_id_t page_id;
+    auto header_page = bpm->NewPage(page_id);
+    (void)header_page;
+
+    std::atomic<int64_t> next_key(0);
+    std::atomic<int> errors(0);
+    std::vector<std::thread> threads;
+    for (int tid = 0; tid < num_threads; tid++)
+    {
+      threads.push_back(std::thread([&]() {
+        GenericKey<64> index_key;
+        for (int64_t key = next_key++; key < num_keys; key = next_key++)
+        {
+          index_key.SetFromInteger(key);
+          if (!tree.Insert(index_key, RID(0, key)))
+            errors++;
+        }
+      }));
+    }
+    for (auto &t : threads)
+      t.join();
+    EXPECT_EQ(0, errors);
+
+    int64_t count = 0;
+    for (auto iterator = tree.Begin(); iterator.isEnd() == false; ++iterator)
+      EXPECT_EQ(count++, (*iterator).second.GetSlotNum());
+    EXPECT_EQ(num_keys, count);
+    std::vector<RID> rids;
+    for (int64_t key = 0; key < num_keys; key++)
+    {
+      GenericKey<64> index_key;
+      index_key.SetFromInteger(key);
+      tree.GetValue(index_key, rids);
+    }
+    EXPECT_EQ(num_keys, static_cast<int64_t>(rids.size()));
+
+    bpm->UnpinPage(HEADER_PAGE_ID, true);
+    delete bpm;
+    remove("test.db");
+  }
+  delete key_schema;
+}
+
+// every thread inserts increasing keys interleaved with the others', so all
+// inserts hit the rightmost leaf: latch crabbing against B-link
+TEST(BPlusTreeConcurrentTest, MonotonicInsertBenchmark)
+{
+  Schema *key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema);
+  const int64_t num_keys = 100000;
+  for (bool blink : {false, true})
+  {
+    for (int num_threads : {1, 2, 4, 8})
+    {
+      BufferPoolManager *bpm = new BufferPoolManager(512, "test.db");
+      BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree(
+          "foo_pk", bpm, comparator, INVALID_PAGE_ID, false, blink);
+      page_id_t page_id;
+      auto header_page = bpm->NewPage(page_id);
+      (void)header_page;
+
+      std::atomic<int64_t> next_key(0);
+      std::atomic<int> errors(0);
+      auto start = std::chrono::steady_clock::now();
+      std::vector<std::thread> threads;
+      for (int tid = 0; tid < num_threads; tid++)
+      {
+        threads.push_back(std::thread([&]() {
+          GenericKey<8> index_key;
+          RID rid;
+          Transaction transaction(0);
+          for (int64_t key = next_key++; key < num_keys; key = next_key++)
+          {
+            index_key.SetFromInteger(key);
+            rid.Set(0, key);
+            if (!tree.Insert(index_key, rid, &transaction))
+              errors++;
+          }
+        }));
+      }
+      for (auto &t : threads)
+        t.join();
+      double seconds = std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - start)
+                           .count();
+      EXPECT_EQ(0, errors);
+      int64_t count = 0;
+      for (auto iterator = tree.Begin(); iterator.isEnd() == false; ++iterator)
+        EXPECT_EQ(count++, (*iterator).second.GetSlotNum());
+      EXPECT_EQ(num_keys, count);
+      std::cout << (blink ? "B-link" : "crabbing") << ", " << num_threads
+                << " threads: " << static_cast<int64_t>(num_keys / seconds)
+                << " inserts/s" << std::endl;
+
+      bpm->UnpinPage(HEADER_PAGE_ID, true);
+      delete bpm;
+      remove("test.db");
+    }
+  }
+  delete key_schema;
+}
+
 } // namespace cmudb
@@ -4,12 +4,15 @@
 
 #include <algorithm>
 #include <cstdio>
+#include <fcntl.h>
 #include <iostream>
 #include <sstream>
+#include <unistd.h>
 
 #include "buffer/buffer_pool_manager.h"
 #include "common/logger.h"
 #include "index/b_plus_tree.h"
+#include "page/header_page.h"
 #include "vtable/virtual_table.h"
 #include "gtest/gtest.h"
 
@@ -400,4 +403,191 @@ TEST(BPlusTreeTests, ScaleTest)
   delete transaction;
   remove("test.db");
 }
+
+// a leaf merged away while another thread has it pinned is deleted by the
+// next writer once unpinned, rather than left allocated on disk
+TEST(BPlusTreeTests, DeferredDeleteTest)
+{
+  Schema *key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema);
+  BufferPoolManager *bpm = new BufferPoolManager(50, "test.db");
+  BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree("foo_pk", bpm,
+                                                           comparator);
+  GenericKey<8> index_key;
+  page_id_t page_id;
+  auto header_page = bpm->NewPage(page_id);
+  (void)header_page;
+
+  const int64_t scale = 1000;
+  for (int64_t key = 1; key <= scale; key++)
+  {
+    index_key.SetFromInteger(key);
+    tree.Insert(index_key, RID(0, key));
+  }
+  // merges move the right page into the left one, so the rightmost leaf goes
+  index_key.SetFromInteger(scale);
+  Page *leaf = tree.FindLeafPage(index_key);
+  page_id_t leaf_id = leaf->GetPageId();
+  leaf->RUnlatch();
+
+  for (int64_t key = 2; key <= scale; key++)
+  {
+    index_key.SetFromInteger(key);
+    tree.Remove(index_key);
+  }
+  DiskManager *disk_manager = bpm->GetDiskManager();
+  EXPECT_TRUE(disk_manager->IsPageAllocated(leaf_id));
+  bpm->UnpinPage(leaf_id, false);
+  index_key.SetFromInteger(2);
+  tree.Insert(index_key, RID(0, 2));
+  EXPECT_FALSE(disk_manager->IsPageAllocated(leaf_id));
+
+  bpm->UnpinPage(HEADER_PAGE_ID, true);
+  delete bpm;
+  delete key_schema;
+  remove("test.db");
+}
+
+// a leaf failing its checksum fails the operations that reach it, and ends
+// the scans that reach it, without taking the rest of the tree down
+TEST(BPlusTreeTests, CorruptPageTest)
+{
+  Schema *key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema);
+  GenericKey<8> index_key;
+  std::vector<RID> rids;
+  const int64_t scale = 2000;
+  for (bool blink : {false, true})
+  {
+    remove("test.db");
+    page_id_t leaf_id;
+    {
+      BufferPoolManager bpm(50, "test.db");
+      page_id_t header_page_id;
+      auto header_page = static_cast<HeaderPage *>(bpm.NewPage(header_page_id));
+      // updated by the tree whenever its root changes
+      header_page->InsertRecord("foo_pk", HEADER_PAGE_ID);
+      BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree(
+          "foo_pk", &bpm, comparator, INVALID_PAGE_ID, false, blink);
+      for (int64_t key = 1; key <= scale; key++)
+      {
+        index_key.SetFromInteger(key);
+        tree.Insert(index_key, RID(0, key));
+      }
+      index_key.SetFromInteger(scale / 2);
+      Page *leaf = tree.FindLeafPage(index_key);
+      leaf_id = leaf->GetPageId();
+      leaf->RUnlatch();
+      bpm.UnpinPage(leaf_id, false);
+      bpm.UnpinPage(HEADER_PAGE_ID, true);
+    }
+
+    // overwrite a byte of the leaf behind the buffer pool's back
+    int fd = open("test.db", O_RDWR);
+    ASSERT_GE(fd, 0);
+    char byte = 0x5a;
+    off_t offset = static_cast<off_t>(leaf_id + leaf_id / PAGES_PER_BITMAP + 1) *
+                   PAGE_SIZE;
+    EXPECT_EQ(1, pwrite(fd, &byte, 1, offset + 10));
+    close(fd);
+
+    BufferPoolManager bpm(50, "test.db");
+    bpm.GetDiskManager()->SetChecksumMode(ChecksumMode::VERIFY);
+    page_id_t root_page_id;
+    auto header_page = static_cast<HeaderPage *>(bpm.FetchPage(HEADER_PAGE_ID));
+    ASSERT_TRUE(header_page->GetRootId("foo_pk", root_page_id));
+    BPlusTree<GenericKey<8>, RID, GenericComparator<8>> tree(
+        "foo_pk", &bpm, comparator, root_page_id, false, blink);
+
+    Transaction lookup(0);
+    index_key.SetFromInteger(scale / 2);
+    EXPECT_FALSE(tree.GetValue(index_key, rids, &lookup));
+    EXPECT_EQ(TransactionState::ABORTED, lookup.GetState());
+    Transaction insert(1);
+    index_key.SetFromInteger(scale + 1);
+    EXPECT_TRUE(tree.Insert(index_key, RID(0, scale + 1), &insert));
+    index_key.SetFromInteger(scale / 2);
+    EXPECT_FALSE(tree.Insert(index_key, RID(0, scale / 2), &insert));
+    EXPECT_EQ(TransactionState::ABORTED, insert.GetState());
+    Transaction remove(2);
+    tree.Remove(index_key, &remove);
+    EXPECT_EQ(TransactionState::ABORTED, remove.GetState());
+
+    // the other leaves, and the latches released on failure, still work
+    rids.clear();
+    index_key.SetFromInteger(1);
+    EXPECT_TRUE(tree.GetValue(index_key, rids));
+    index_key.SetFromInteger(scale);
+    EXPECT_TRUE(tree.GetValue(index_key, rids));
+    EXPECT_EQ(2, rids.size());
+
+    int64_t scanned = 0;
+    for (auto iterator = tree.Begin(); !iterator.isEnd(); ++iterator)
+      scanned++;
+    EXPECT_LT(0, scanned);
+    EXPECT_GT(scale / 2, scanned);
+    bpm.UnpinPage(HEADER_PAGE_ID, false);
+  }
+  delete key_schema;
+  remove("test.db");
+}
+
+// only B-link pages give up room for the high key (and right link) at the
+// end of the page, which a full page never overlaps
+TEST(BPlusTreeTests, PageLayoutTest)
+{
+  Schema *key_schema = ParseCreateStatement("a bigint");
+  GenericComparator<8> comparator(key_schema);
+  char *page = new char[PAGE_SIZE];
+  GenericKey<8> key;
+  GenericKey<8> high_key;
+  high_key.SetFromInteger(-1);
+
+  auto leaf = reinterpret_cast<
+      BPlusTreeLeafPage<GenericKey<8>, RID, GenericComparator<8>> *>(page);
+  leaf->Init(1);
+  int leaf_max_size = leaf->GetMaxSize();
+  EXPECT_EQ(static_cast<int>((PAGE_DATA_SIZE - 24) /
+                             sizeof(std::pair<GenericKey<8>, RID>)) -
+                1,
+            leaf_max_size);
+  leaf->Init(1, INVALID_PAGE_ID, true);
+  EXPECT_GT(leaf_max_size, leaf->GetMaxSize());
+  leaf->SetHighKey(high_key);
+  for (int64_t i = 0; i <= leaf->GetMaxSize(); i++)
+  {
+    key.SetFromInteger(i);
+    leaf->Insert(key, RID(0, i), comparator);
+  }
+  EXPECT_EQ(0, comparator(high_key, leaf->GetHighKey()));
+  RID rid;
+  key.SetFromInteger(leaf->GetMaxSize());
+  EXPECT_TRUE(leaf->Lookup(key, rid, comparator));
+  EXPECT_EQ(leaf->GetMaxSize(), rid.GetSlotNum());
+
+  auto internal = reinterpret_cast<
+      BPlusTreeInternalPage<GenericKey<8>, page_id_t, GenericComparator<8>> *>(
+      page);
+  internal->Init(1);
+  int internal_max_size = internal->GetMaxSize();
+  internal->Init(1, INVALID_PAGE_ID, true);
+  EXPECT_GT(internal_max_size, internal->GetMaxSize());
+  EXPECT_EQ(INVALID_PAGE_ID, internal->GetNextPageId());
+  internal->SetHighKey(high_key);
+  key.SetFromInteger(1);
+  internal->PopulateNewRoot(0, key, 1);
+  for (int64_t i = 2; i <= internal->GetMaxSize(); i++)
+  {
+    key.SetFromInteger(i);
+    internal->InsertNode(key, i, comparator);
+  }
+  EXPECT_EQ(INVALID_PAGE_ID, internal->GetNextPageId());
+  EXPECT_EQ(0, comparator(high_key, internal->GetHighKey()));
+  EXPECT_EQ(internal->GetMaxSize() + 1, internal->GetSize());
+  key.SetFromInteger(internal->GetMaxSize());
+  EXPECT_EQ(internal->GetMaxSize(), internal->Lookup(key, comparator));
+
+  delete[] page;
+  delete key_schema;
+}
 } // namespace cmudb
@@ -1,6 +1,9 @@
 /**
  * virtual_table_test.cpp
  */
+#include <cstdlib>
+
+#include "common/config.h"
 #include "vtable/testing_vtable_util.h"
 
 namespace cmudb
@@ -46,4 +49,44 @@ TEST(VtableTest, CreateTest)
   remove("vtable.db");
   return;
 }
+
+// the buffer pool is sized from the environment and resized through SQL
+TEST(VtableTest, PoolResizeTest)
+{
+  std::string db_file = "sqlite.db";
+  remove(db_file.c_str());
+  remove("vtable.db");
+  setenv("CMUDB_POOL_SIZE", "128", 1);
+  setenv("CMUDB_POOL_BUDGET_MB", "4", 1);
+  sqlite3 *db;
+  EXPECT_EQ(SQLITE_OK, sqlite3_open(db_file.c_str(), &db));
+  EXPECT_EQ(SQLITE_OK, sqlite3_enable_load_extension(db, 1));
+  char *zErrMsg = 0;
+  EXPECT_EQ(SQLITE_OK, sqlite3_load_extension(db, "libvtable", 0, &zErrMsg));
+
+  auto query = [db](const std::string &sql) {
+    sqlite3_stmt *stmt;
+    sqlite3_int64 result = -1;
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) == SQLITE_OK &&
+        sqlite3_step(stmt) == SQLITE_ROW)
+      result = sqlite3_column_int64(stmt, 0);
+    sqlite3_finalize(stmt);
+    return result;
+  };
+  EXPECT_EQ(128, query("SELECT vtable_pool_size()"));
+  EXPECT_EQ(128 * PAGE_SIZE, query("SELECT vtable_pool_memory()"));
+  EXPECT_EQ(4 << 20, query("SELECT vtable_pool_budget()"));
+  EXPECT_EQ(1024, query("SELECT vtable_pool_resize(1024)"));
+  EXPECT_EQ(1024 * PAGE_SIZE, query("SELECT vtable_pool_memory()"));
+  EXPECT_EQ(64, query("SELECT vtable_pool_resize(64)"));
+  // beyond the memory budget
+  EXPECT_FALSE(ExecSQL(db, "SELECT vtable_pool_resize(2048)"));
+  EXPECT_EQ(64, query("SELECT vtable_pool_size()"));
+
+  EXPECT_EQ(SQLITE_OK, sqlite3_close(db));
+  unsetenv("CMUDB_POOL_SIZE");
+  unsetenv("CMUDB_POOL_BUDGET_MB");
+  remove(db_file.c_str());
+  remove("vtable.db");
+}
 } // namespace cmudb